@@ -0,0 +1,211 @@
+/*
+Copyright (C) 2014-2015 Eaton
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*! \file   asset_closure.cc
+    \brief  In-memory ancestor/descendant index of the asset tree
+*/
+
+#include "asset_closure.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include <tntdb/result.h>
+#include <tntdb/row.h>
+
+#include "log.h"
+#include "asset_generation.h"
+
+namespace persist {
+
+AssetClosure::AssetClosure (const Edges &edges, const Types &types)
+{
+    std::unordered_map<a_elmnt_id_t, std::vector<a_elmnt_id_t>> children;
+    std::vector<a_elmnt_id_t> ids;
+
+    _index.reserve (edges.size ());
+    ids.reserve (edges.size ());
+    for (const auto &edge : edges) {
+        auto type = types.find (edge.first);
+        _index[edge.first] = node_t {edge.second, 0, 0, type != types.end () ? type->second : (a_elmnt_tp_id_t) 0};
+        ids.push_back (edge.first);
+    }
+    // deterministic order of siblings, smallest id breaks a cycle
+    std::sort (ids.begin (), ids.end ());
+    for (const auto id : ids) {
+        auto &node = _index[id];
+        if (node.parent == 0 || node.parent == id || _index.count (node.parent) == 0)
+            node.parent = 0;
+        else
+            children[node.parent].push_back (id);
+    }
+
+    _preorder.reserve (ids.size ());
+    std::unordered_map<a_elmnt_id_t, bool> visited;
+    visited.reserve (ids.size ());
+
+    // roots first, then whatever was left unreachable by a cycle
+    for (int pass = 0; pass != 2; ++pass) {
+        for (const auto root : ids) {
+            if (visited[root] || (pass == 0 && _index[root].parent != 0))
+                continue;
+
+            // iterative DFS, stack keeps (id, index of next child)
+            std::vector<std::pair<a_elmnt_id_t, size_t>> stack;
+            stack.emplace_back (root, 0);
+            visited[root] = true;
+            _index[root].begin = _preorder.size ();
+            _preorder.push_back (root);
+
+            while (!stack.empty ()) {
+                auto &top = stack.back ();
+                auto it = children.find (top.first);
+                if (it == children.end () || top.second == it->second.size ()) {
+                    _index[top.first].end = _preorder.size ();
+                    stack.pop_back ();
+                    continue;
+                }
+                a_elmnt_id_t child = it->second[top.second++];
+                if (visited[child])
+                    continue;
+                visited[child] = true;
+                _index[child].begin = _preorder.size ();
+                _preorder.push_back (child);
+                stack.emplace_back (child, 0);
+            }
+        }
+    }
+}
+
+bool
+    AssetClosure::is_under (a_elmnt_id_t element, a_elmnt_id_t container) const
+{
+    auto e = _index.find (element);
+    auto c = _index.find (container);
+    if (e == _index.end () || c == _index.end ())
+        return false;
+    return c->second.begin < e->second.begin && e->second.begin < c->second.end;
+}
+
+std::vector<a_elmnt_id_t>
+    AssetClosure::descendants (a_elmnt_id_t container) const
+{
+    auto c = _index.find (container);
+    if (c == _index.end ())
+        return {};
+    return std::vector<a_elmnt_id_t> (
+            _preorder.begin () + c->second.begin + 1,
+            _preorder.begin () + c->second.end);
+}
+
+std::vector<a_elmnt_id_t>
+    AssetClosure::ancestors (a_elmnt_id_t element) const
+{
+    std::vector<a_elmnt_id_t> ret;
+    auto it = _index.find (element);
+    while (it != _index.end () && it->second.parent != 0) {
+        // a broken cycle leaves the parent pointer in place, stop there
+        auto parent = _index.find (it->second.parent);
+        if (parent == _index.end () || !(parent->second.begin < it->second.begin))
+            break;
+        ret.push_back (it->second.parent);
+        it = parent;
+    }
+    return ret;
+}
+
+a_elmnt_tp_id_t
+    AssetClosure::type (a_elmnt_id_t element) const
+{
+    auto it = _index.find (element);
+    return it != _index.end () ? it->second.type : 0;
+}
+
+static std::mutex s_closure_mux;
+static AssetClosurePtr s_closure;
+static uint64_t s_closure_period = 0;
+static uint64_t s_closure_generation = 0;
+
+AssetClosurePtr
+    asset_closure
+        (tntdb::Connection &conn)
+{
+    std::lock_guard<std::mutex> lock (s_closure_mux);
+
+    uint64_t generation = asset_generation ();
+    uint64_t period = asset_period ();
+    if (s_closure
+        && s_closure_generation == generation
+        && s_closure_period == period)
+        return s_closure;
+
+    tntdb::Statement st = conn.prepareCached (
+        " SELECT id_asset_element, id_parent, id_type FROM t_bios_asset_element "
+    );
+    tntdb::Result result = st.select ();
+
+    AssetClosure::Edges edges;
+    AssetClosure::Types types;
+    edges.reserve (result.size ());
+    types.reserve (result.size ());
+    for (const auto &row : result) {
+        a_elmnt_id_t id = 0, parent = 0;
+        a_elmnt_tp_id_t type = 0;
+        row[0].get (id);
+        row[1].get (parent);     // NULL for datacenters
+        row[2].get (type);
+        edges.emplace_back (id, parent);
+        types.emplace (id, type);
+    }
+
+    s_closure = std::make_shared<const AssetClosure> (edges, types);
+    s_closure_period = period;
+    s_closure_generation = generation;
+    log_debug ("asset closure loaded, %zu elements", s_closure->size ());
+    return s_closure;
+}
+
+void
+    invalidate_asset_closure (void)
+{
+    bump_asset_generation ();
+}
+
+void
+    for_each_id_chunk
+        (const std::vector<a_elmnt_id_t> &ids,
+         std::function<void(const std::string&)> cb,
+         size_t chunk)
+{
+    std::string list;
+    size_t n = 0;
+    for (const auto id : ids) {
+        if (n != 0)
+            list += ",";
+        list += std::to_string (id);
+        if (++n == chunk) {
+            cb (list);
+            list.clear ();
+            n = 0;
+        }
+    }
+    if (n != 0)
+        cb (list);
+}
+
+} // namespace persist
@@ -0,0 +1,120 @@
+/*
+Copyright (C) 2014-2015 Eaton
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*! \file   asset_closure.h
+    \brief  In-memory ancestor/descendant index of the asset tree
+*/
+
+#ifndef SRC_DB_ASSET_CLOSURE_H
+#define SRC_DB_ASSET_CLOSURE_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <tntdb/connect.h>
+
+#include "dbtypes.h"
+
+namespace persist {
+
+/**
+ * \brief Preorder (nested interval) encoding of the asset parent tree
+ *
+ * Every element gets a [begin, end) range in a preorder walk of the tree,
+ * so "is X under container C" is two integer comparisons and "all assets
+ * under C" is a contiguous slice of the preorder array. This replaces the
+ * ":id IN (v.id_parent1, ..., v.id_parent5)" filters on
+ * v_bios_asset_element_super_parent, which could not use an index.
+ *
+ * Elements whose parent is unknown are treated as roots, parent cycles
+ * are broken at the smallest id of the cycle.
+ */
+class AssetClosure {
+public:
+    /** \brief (id_asset_element, id_parent) pairs, id_parent is 0 for roots */
+    typedef std::vector<std::pair<a_elmnt_id_t, a_elmnt_id_t>> Edges;
+    /** \brief id_asset_element -> id_type */
+    typedef std::unordered_map<a_elmnt_id_t, a_elmnt_tp_id_t> Types;
+
+    explicit AssetClosure (const Edges &edges, const Types &types = Types ());
+
+    /** \brief true if element lies (strictly) below container */
+    bool is_under (a_elmnt_id_t element, a_elmnt_id_t container) const;
+
+    /** \brief all elements below container in preorder, container excluded */
+    std::vector<a_elmnt_id_t> descendants (a_elmnt_id_t container) const;
+
+    /** \brief parent chain of element, nearest parent first */
+    std::vector<a_elmnt_id_t> ancestors (a_elmnt_id_t element) const;
+
+    /** \brief type of element, 0 if unknown */
+    a_elmnt_tp_id_t type (a_elmnt_id_t element) const;
+
+    size_t size () const { return _preorder.size (); }
+
+private:
+    struct node_t {
+        a_elmnt_id_t parent;
+        uint32_t begin;
+        uint32_t end;
+        a_elmnt_tp_id_t type;
+    };
+
+    std::unordered_map<a_elmnt_id_t, node_t> _index;
+    std::vector<a_elmnt_id_t> _preorder;
+};
+
+typedef std::shared_ptr<const AssetClosure> AssetClosurePtr;
+
+/**
+ * \brief Returns the current closure, (re)loading it from t_bios_asset_element
+ *        if it was invalidated or loaded in an older asset_period ()
+ *
+ * Concurrent callers wait for a single load. Throws on database errors.
+ */
+AssetClosurePtr
+    asset_closure
+        (tntdb::Connection &conn);
+
+/**
+ * \brief Marks the closure stale, must be called after every committed
+ *        change of the asset tree (insert, delete, change of a parent)
+ *
+ * Same as bump_asset_generation (), see asset_generation.h.
+ */
+void
+    invalidate_asset_closure (void);
+
+/**
+ * \brief Selects ids in chunks small enough for an "IN (...)" list
+ *
+ * Calls cb with comma separated lists of at most chunk ids.
+ */
+void
+    for_each_id_chunk
+        (const std::vector<a_elmnt_id_t> &ids,
+         std::function<void(const std::string&)> cb,
+         size_t chunk = 1000);
+
+} // namespace persist
+
+#endif // SRC_DB_ASSET_CLOSURE_H
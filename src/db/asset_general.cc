@@ -17,9 +17,15 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "db/assets.h"
+#include "db/asset_closure.h"
+#include "db/asset_generation.h"
+#include "db/power_topology.h"
+#include "db/rack_capacity.h"
 
 #include <tntdb/transaction.h>
+#include <tntdb/result.h>
 #include <locale.h>
+#include <algorithm>
 
 #include "log.h"
 #include "asset_types.h"
@@ -104,6 +110,9 @@ int
     }
 
     trans.commit();
+    uint64_t generation = bump_asset_generation ();
+    rack_capacity_changed (conn, {element_id}, generation);
+    power_topology_changed (conn, {element_id}, generation);
     LOG_END;
     return 0;
 }
@@ -207,6 +216,9 @@ int
     }
 
     trans.commit();
+    uint64_t generation = bump_asset_generation ();
+    rack_capacity_changed (conn, {element_id}, generation);
+    power_topology_changed (conn, {element_id}, generation);
     LOG_END;
     return 0;
 }
@@ -299,6 +311,9 @@ db_reply_t
     }
 
     trans.commit();
+    uint64_t generation = bump_asset_generation ();
+    rack_capacity_changed (conn, {(a_elmnt_id_t) reply_insert1.rowid}, generation);
+    power_topology_changed (conn, {(a_elmnt_id_t) reply_insert1.rowid}, generation);
     LOG_END;
     return reply_insert1;
 }
@@ -419,6 +434,9 @@ db_reply_t
 
     }
     trans.commit();
+    uint64_t generation = bump_asset_generation ();
+    rack_capacity_changed (conn, {(a_elmnt_id_t) reply_insert1.rowid}, generation);
+    power_topology_changed (conn, {(a_elmnt_id_t) reply_insert1.rowid}, generation);
     LOG_END;
     return reply_insert1;
 }
@@ -473,6 +491,9 @@ db_reply_t
     }
 
     trans.commit();
+    uint64_t generation = bump_asset_generation ();
+    rack_capacity_changed (conn, {element_id}, generation);
+    power_topology_changed (conn, {element_id}, generation);
     LOG_END;
     return reply_delete4;
 }
@@ -503,6 +524,9 @@ db_reply_t
     }
 
     trans.commit();
+    uint64_t generation = bump_asset_generation ();
+    rack_capacity_changed (conn, {element_id}, generation);
+    power_topology_changed (conn, {element_id}, generation);
     LOG_END;
     return reply_delete3;
 }
@@ -550,8 +574,192 @@ db_reply_t
     }
 
     trans.commit();
+    uint64_t generation = bump_asset_generation ();
+    rack_capacity_changed (conn, {element_id}, generation);
+    power_topology_changed (conn, {element_id}, generation);
     LOG_END;
     return reply_delete6;
 }
 
+//=============================================================================
+db_reply_t
+    delete_assets
+        (tntdb::Connection &conn,
+         const std::set<a_elmnt_id_t> &ids,
+         std::vector<db_a_elmnt_t> &deleted,
+         std::map<a_elmnt_id_t, std::string> &blocked)
+{
+    LOG_START;
+    db_reply_t ret = db_reply_new();
+    deleted.clear ();
+    blocked.clear ();
+
+    if ( ids.empty () )
+    {
+        LOG_END;
+        return ret;
+    }
+    std::vector<a_elmnt_id_t> id_list (ids.begin (), ids.end ());
+
+    try {
+        tntdb::Transaction trans(conn);
+        // basic info of the whole set, needed for the notification anyway
+        std::map<a_elmnt_id_t, db_a_elmnt_t> elements;
+        for_each_id_chunk (id_list, [&conn, &elements](const std::string &list) {
+            tntdb::Result result = conn.prepare (
+                " SELECT id_asset_element, name, status, id_parent, priority, "
+                "        id_type, id_subtype, asset_tag "
+                " FROM t_bios_asset_element "
+                " WHERE id_asset_element IN (" + list + ")"
+            ).select ();
+            for ( const auto &row : result ) {
+                db_a_elmnt_t element;
+                row [0].get (element.id);
+                row [1].get (element.name);
+                row [2].get (element.status);
+                row [3].get (element.parent_id);
+                row [4].get (element.priority);
+                row [5].get (element.type_id);
+                row [6].get (element.subtype_id);
+                row [7].get (element.asset_tag);
+                elements.emplace (element.id, element);
+            }
+        });
+        if ( elements.size () != ids.size () )
+        {
+            for ( const auto id : ids ) {
+                if ( elements.count (id) == 0 ) {
+                    ret.status     = 0;
+                    ret.errtype    = DB_ERR;
+                    ret.errsubtype = DB_ERROR_NOTFOUND;
+                    ret.rowid      = id;
+                    ret.msg        = "element " + std::to_string (id) + " was not found";
+                    break;
+                }
+            }
+            trans.rollback ();
+            log_warning ("end: %s", ret.msg.c_str ());
+            return ret;
+        }
+
+        // blocking references: children left behind and power links
+        // from devices outside of the set; FOR UPDATE keeps new ones
+        // from appearing until the transaction is over
+        for_each_id_chunk (id_list, [&conn, &ids, &blocked](const std::string &list) {
+            tntdb::Result result = conn.prepare (
+                " SELECT id_parent, name, id_asset_element "
+                " FROM t_bios_asset_element "
+                " WHERE id_parent IN (" + list + ")"
+                " FOR UPDATE"
+            ).select ();
+            for ( const auto &row : result ) {
+                a_elmnt_id_t parent = 0, child = 0;
+                std::string name;
+                row [0].get (parent);
+                row [1].get (name);
+                row [2].get (child);
+                if ( ids.count (child) == 0 && blocked.count (parent) == 0 )
+                    blocked.emplace (parent, "Asset has elements inside, DELETE them first! (" + name + ")");
+            }
+
+            result = conn.prepare (
+                " SELECT l.id_asset_device_dest, e.name, l.id_asset_device_src "
+                " FROM t_bios_asset_link l "
+                "   INNER JOIN t_bios_asset_element e "
+                "   ON e.id_asset_element = l.id_asset_device_src "
+                " WHERE l.id_asset_device_dest IN (" + list + ")"
+                " FOR UPDATE"
+            ).select ();
+            for ( const auto &row : result ) {
+                a_elmnt_id_t dest = 0, src = 0;
+                std::string name;
+                row [0].get (dest);
+                row [1].get (name);
+                row [2].get (src);
+                if ( ids.count (src) == 0 && blocked.count (dest) == 0 )
+                    blocked.emplace (dest, "Asset is powered by " + name + ", DELETE it too or remove the link!");
+            }
+        });
+        if ( !blocked.empty () )
+        {
+            ret.status     = 0;
+            ret.errtype    = DB_ERR;
+            ret.errsubtype = DB_ERROR_DELETEFAIL;
+            ret.rowid      = blocked.begin ()->first;
+            ret.msg        = blocked.begin ()->second;
+            trans.rollback ();
+            log_info ("end: %zu assets can't be deleted, nothing was deleted", blocked.size ());
+            return ret;
+        }
+
+        // depth inside of the set, elements must go before their parents
+        std::map<a_elmnt_id_t, size_t> depth;
+        size_t max_depth = 0;
+        for ( const auto &it : elements ) {
+            size_t d = 0;
+            for ( auto p = elements.find (it.second.parent_id);
+                  p != elements.end () && d < elements.size ();
+                  p = elements.find (p->second.parent_id) )
+                ++d;
+            depth [it.first] = d;
+            max_depth = std::max (max_depth, d);
+        }
+
+        for_each_id_chunk (id_list, [&conn](const std::string &list) {
+            conn.prepare (
+                " DELETE FROM t_bios_asset_group_relation "
+                " WHERE id_asset_element IN (" + list + ") "
+                "    OR id_asset_group IN (" + list + ")"
+            ).execute ();
+            conn.prepare (
+                " DELETE FROM t_bios_asset_link "
+                " WHERE id_asset_device_src IN (" + list + ") "
+                "    OR id_asset_device_dest IN (" + list + ")"
+            ).execute ();
+            conn.prepare (
+                " DELETE FROM t_bios_asset_ext_attributes "
+                " WHERE id_asset_element IN (" + list + ")"
+            ).execute ();
+            conn.prepare (
+                " DELETE FROM t_bios_monitor_asset_relation "
+                " WHERE id_asset_element IN (" + list + ")"
+            ).execute ();
+        });
+        for ( size_t d = max_depth + 1; d-- > 0; ) {
+            std::vector<a_elmnt_id_t> level;
+            for ( const auto &it : depth ) {
+                if ( it.second == d ) {
+                    level.push_back (it.first);
+                    deleted.push_back (elements [it.first]);
+                }
+            }
+            for_each_id_chunk (level, [&conn, &ret](const std::string &list) {
+                ret.affected_rows += conn.prepare (
+                    " DELETE FROM t_bios_asset_element "
+                    " WHERE id_asset_element IN (" + list + ")"
+                ).execute ();
+            });
+        }
+        trans.commit ();
+        uint64_t generation = bump_asset_generation ();
+        std::vector<a_elmnt_id_t> deleted_ids;
+        for ( const auto &element : deleted )
+            deleted_ids.push_back (element.id);
+        rack_capacity_changed (conn, deleted_ids, generation);
+        power_topology_changed (conn, deleted_ids, generation);
+        log_debug ("[t_bios_asset_element]: was deleted %" PRIu64 " rows", ret.affected_rows);
+        LOG_END;
+        return ret;
+    }
+    catch (const std::exception &e) {
+        deleted.clear ();
+        ret.status     = 0;
+        ret.errtype    = DB_ERR;
+        ret.errsubtype = DB_ERROR_INTERNAL;
+        ret.msg        = e.what ();
+        LOG_END_ABNORMAL(e);
+        return ret;
+    }
+}
+
 } // end namespace
@@ -24,6 +24,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #ifndef SRC_DB_ASSETS_GENERAL_H
 #define SRC_DB_ASSETS_GENERAL_H
 
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
 #include <tntdb/connect.h>
 #include "db/assetdef.h"
 #include "dbhelpers.h"
@@ -108,5 +112,33 @@ db_reply_t
          a_elmnt_id_t element_id);
 
 
+/**
+ * \brief Deletes a set of assets of any type in one transaction
+ *
+ * Blocking references are computed in the same transaction before
+ * anything is touched: a child whose parent is in the set, but which is
+ * not in the set itself, and a power link from a device outside of the
+ * set to an asset of it. Links going out of the set are simply removed.
+ * If there are any, nothing is deleted, the reply has status 0 with
+ * DB_ERROR_DELETEFAIL and blocked maps the blocked asset of the set to
+ * the reason.
+ *
+ * Group membership, links, ext attributes and the monitor relation are
+ * removed with one statement per 1000 ids, elements deepest level first.
+ *
+ * \param[out] deleted - deleted elements, for the notification of agents
+ * \param[out] blocked - asset id -> why it can't be deleted
+ *
+ * \return status 1 and affected_rows == number of deleted elements
+ *         on success, DB_ERROR_NOTFOUND if some id does not exist
+ */
+db_reply_t
+    delete_assets
+        (tntdb::Connection &conn,
+         const std::set<a_elmnt_id_t> &ids,
+         std::vector<db_a_elmnt_t> &deleted,
+         std::map<a_elmnt_id_t, std::string> &blocked);
+
+
 }   // end namespace
 #endif // SRC_DB_ASSETS_GENERAL_H
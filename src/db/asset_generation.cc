@@ -0,0 +1,66 @@
+/*
+Copyright (C) 2014-2015 Eaton
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*! \file   asset_generation.cc
+    \brief  Generation number of the asset model
+*/
+
+#include "asset_generation.h"
+
+#include <atomic>
+#include <ctime>
+
+#include "log.h"
+
+namespace persist {
+
+// other processes may change the assets behind our back
+#define ASSET_PERIOD std::chrono::seconds (60)
+
+static std::atomic<uint64_t> s_generation {1};
+static const time_t s_started = time (NULL);
+
+uint64_t
+    asset_generation (void)
+{
+    return s_generation.load ();
+}
+
+uint64_t
+    bump_asset_generation (void)
+{
+    uint64_t generation = ++s_generation;
+    log_debug ("asset model generation %" PRIu64, generation);
+    return generation;
+}
+
+uint64_t
+    asset_period (std::chrono::steady_clock::time_point time)
+{
+    return time.time_since_epoch () / ASSET_PERIOD;
+}
+
+std::string
+    asset_etag (void)
+{
+    return "\"" + std::to_string (s_started)
+        + "-" + std::to_string (asset_generation ())
+        + "-" + std::to_string (asset_period ()) + "\"";
+}
+
+} // namespace persist
@@ -0,0 +1,74 @@
+/*
+Copyright (C) 2014-2015 Eaton
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*! \file   asset_generation.h
+    \brief  Generation number of the asset model
+*/
+
+#ifndef SRC_DB_ASSET_GENERATION_H
+#define SRC_DB_ASSET_GENERATION_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace persist {
+
+/**
+ * \brief Current generation of the asset model
+ *
+ * Monotonically increasing, changes after every committed create, update
+ * or delete of an asset and after every CSV import done by this process.
+ */
+uint64_t
+    asset_generation (void);
+
+/**
+ * \brief Starts a new generation, returns its number
+ *
+ * Must be called after every committed change of the asset model.
+ */
+uint64_t
+    bump_asset_generation (void);
+
+/**
+ * \brief Period of the asset model time belongs to
+ *
+ * The generation only counts changes made by this process, changes of
+ * others (bios-csv import, agents writing to the database) are not seen.
+ * Data read from the database are trusted until the end of the minute of
+ * the steady clock they were read in: caches of the asset model reload
+ * when the period changes. ResponseCache with the default max_age uses
+ * the same periods.
+ */
+uint64_t
+    asset_period (std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now ());
+
+/**
+ * \brief Strong ETag (quoted) of the current generation and period
+ *
+ * Contains the start time of the process too, so a restart never
+ * reuses a tag handed out before. The period makes every tag expire
+ * within a minute, together with the data it was handed out for.
+ */
+std::string
+    asset_etag (void);
+
+} // namespace persist
+
+#endif // SRC_DB_ASSET_GENERATION_H
@@ -23,7 +23,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "assetr.h"
 #include "asset_types.h"
+#include "db/asset_closure.h"
 
+#include <algorithm>
 #include <exception>
 #include <assert.h>
 
@@ -100,6 +102,49 @@ name_to_asset_id (std::string asset_name)
     }
 }
 
+int
+names_to_asset_ids
+    (tntdb::Connection &conn,
+     const std::vector <std::string> &names,
+     std::map <std::string, a_elmnt_id_t> &ids)
+{
+    try
+    {
+        for (size_t i = 0; i < names.size (); i += 1000)
+        {
+            size_t n = std::min <size_t> (1000, names.size () - i);
+            std::string list;
+            for (size_t j = 0; j != n; ++j)
+                list += (j == 0 ? ":n" : ", :n") + std::to_string (j);
+
+            // the same count of names shares the statement
+            tntdb::Statement st = conn.prepareCached(
+            " SELECT name, id_asset_element"
+            " FROM"
+            "   t_bios_asset_element"
+            " WHERE name in (" + list + ")"
+            );
+            for (size_t j = 0; j != n; ++j)
+                st.set ("n" + std::to_string (j), names [i + j]);
+
+            for (auto &row: st.select ())
+            {
+                std::string name;
+                a_elmnt_id_t id = 0;
+                row [0].get (name);
+                row [1].get (id);
+                ids [name] = id;
+            }
+        }
+        return 0;
+    }
+    catch (const std::exception &e)
+    {
+        log_error ("exception caught %s", e.what ());
+        return -1;
+    }
+}
+
 int64_t
 extname_to_asset_id (std::string asset_ext_name)
 {
@@ -649,8 +694,8 @@ int
     try{
         tntdb::Statement st = conn.prepareCached(
             " SELECT"
-            "   v.id, v.name, v.type_name,"
-            "   v.subtype_name, v.id_parent,"
+            "   v.id, v.name, v.id_type, v.type_name,"
+            "   v.subtype_id, v.subtype_name, v.id_parent,"
             "   v.status, v.priority,"
             "   v.asset_tag"
             " FROM"
@@ -1018,38 +1063,200 @@ int
          std::vector<a_elmnt_stp_id_t> subtypes,
          std::function<void(const tntdb::Row&)> cb
          )
+{
+    return select_assets_by_container(conn, element_id, types, subtypes, asset_filter_t {}, NULL, cb);
+}
+
+// columns of the asset listings, a is t_bios_asset_element
+#define ASSET_LIST_COLUMNS \
+    "   a.name, " \
+    "   a.id_asset_element as asset_id, " \
+    "   a.id_subtype as subtype_id, " \
+    "   c.name as subtype_name, " \
+    "   a.id_type as type_id, " \
+    "   ext.value as ext_name " \
+    " FROM " \
+    "   t_bios_asset_element a " \
+    "   LEFT JOIN t_bios_asset_device_type c " \
+    "   ON a.id_subtype = c.id_asset_device_type " \
+    "   LEFT JOIN t_bios_asset_ext_attributes ext " \
+    "   ON ext.id_asset_element = a.id_asset_element AND ext.keytag = 'name' "
+
+static std::string
+    s_id_list (const std::vector<a_elmnt_stp_id_t> &ids)
+{
+    std::string list;
+    for ( auto &id: ids ) list += std::to_string(id) + ",";
+    return list.substr(0,list.size()-1);
+}
+
+// conditions of the filter (except of the page), to be bound by s_filter_bind
+static std::string
+    s_filter_sql
+        (const std::vector<a_elmnt_tp_id_t> &types,
+         const std::vector<a_elmnt_stp_id_t> &subtypes,
+         const asset_filter_t &filter)
+{
+    std::string sql;
+    if ( !subtypes.empty() )
+        sql += " AND a.id_subtype in (" + s_id_list (subtypes) + ")";
+    if ( !types.empty() )
+        sql += " AND a.id_type in (" + s_id_list (types) + ")";
+    if ( !filter.status.empty() )
+        sql += " AND a.status = :status";
+    if ( filter.priority != 0 )
+        sql += " AND a.priority = :priority";
+    if ( !filter.ext_key.empty() ) {
+        sql += " AND EXISTS (SELECT 1 FROM t_bios_asset_ext_attributes f"
+               " WHERE f.id_asset_element = a.id_asset_element AND f.keytag = :ext_key";
+        if ( !filter.ext_value.empty() )
+            sql += " AND f.value = :ext_value";
+        sql += ")";
+    }
+    return sql;
+}
+
+static void
+    s_filter_bind
+        (tntdb::Statement &st,
+         const asset_filter_t &filter)
+{
+    if ( !filter.status.empty() )
+        st.set ("status", filter.status);
+    if ( filter.priority != 0 )
+        st.set ("priority", filter.priority);
+    if ( !filter.ext_key.empty() ) {
+        st.set ("ext_key", filter.ext_key);
+        if ( !filter.ext_value.empty() )
+            st.set ("ext_value", filter.ext_value);
+    }
+}
+
+int
+    select_assets_by_container
+        (tntdb::Connection &conn,
+         a_elmnt_id_t element_id,
+         const std::vector<a_elmnt_tp_id_t> &types,
+         const std::vector<a_elmnt_stp_id_t> &subtypes,
+         const asset_filter_t &filter,
+         uint32_t *total,
+         std::function<void(const tntdb::Row&)> cb
+         )
 {
     LOG_START;
     log_debug ("container element_id = %" PRIu32, element_id);
 
     try {
-        std::string select =
-            " SELECT "
-            "   v.name, "
-            "   v.id_asset_element as asset_id, "
-            "   v.id_asset_device_type as subtype_id, "
-            "   v.type_name as subtype_name, "
-            "   v.id_type as type_id "
-            " FROM "
-            "   v_bios_asset_element_super_parent v "
-            " WHERE "
-            "   :containerid in (v.id_parent1, v.id_parent2, v.id_parent3, v.id_parent4, v.id_parent5)";
-        if (!subtypes.empty()) {
-            std::string list;
-            for( auto &id: subtypes) list += std::to_string(id) + ",";
-            select += " and v.id_asset_device_type in (" + list.substr(0,list.size()-1) + ")";
+        // descendants come from the closure, the database is asked only
+        // for details of the known ids
+        std::vector<a_elmnt_id_t> ids = asset_closure (conn)->descendants (element_id);
+        std::sort (ids.begin (), ids.end ());
+        log_debug ("container has %zu descendants", ids.size ());
+
+        std::string where = s_filter_sql (types, subtypes, filter);
+
+        if ( total ) {
+            *total = 0;
+            if ( where.empty() )
+                *total = ids.size ();
+            else
+                for_each_id_chunk (ids,
+                    [&conn, &where, &filter, total](const std::string &list)
+                    {
+                        tntdb::Statement st = conn.prepare (
+                            " SELECT COUNT(*) FROM t_bios_asset_element a "
+                            " WHERE a.id_asset_element in (" + list + ")" + where);
+                        s_filter_bind (st, filter);
+                        *total += st.selectValue ().getUnsigned32 ();
+                    });
         }
-        if (!types.empty()) {
+
+        // keyset page: ids are sorted, so skip everything up to the cursor
+        // and stop as soon as the page is full
+        ids.erase (ids.begin (), std::upper_bound (ids.begin (), ids.end (), filter.after));
+        uint32_t left = filter.limit;
+        for ( size_t i = 0; i < ids.size () && !(filter.limit && left == 0); i += 1000 ) {
             std::string list;
-            for( auto &id: types) list += std::to_string(id) + ",";
-            select += " and v.id_type in (" + list.substr(0,list.size()-1) + ")";
+            for ( size_t j = i; j < ids.size () && j < i + 1000; ++j )
+                list += ( j == i ? "" : "," ) + std::to_string (ids[j]);
+
+            // the id list changes every time, there is nothing to cache
+            tntdb::Statement st = conn.prepare (
+                " SELECT " ASSET_LIST_COLUMNS
+                " WHERE "
+                "   a.id_asset_element in (" + list + ")" + where +
+                " ORDER BY a.id_asset_element" +
+                ( filter.limit ? " LIMIT " + std::to_string (left) : "" ));
+            s_filter_bind (st, filter);
+            for ( auto &row: st.select() ) {
+                cb(row);
+                if ( filter.limit ) --left;
+            }
         }
+        LOG_END;
+        return 0;
+    }
+    catch (const std::exception& e) {
+        LOG_END_ABNORMAL(e);
+        return -1;
+    }
+}
+
+int
+    select_assets_by_type
+        (tntdb::Connection &conn,
+         a_elmnt_tp_id_t type_id,
+         a_elmnt_stp_id_t subtype_id,
+         std::function<void(const tntdb::Row&)> cb)
+{
+    std::vector<a_elmnt_stp_id_t> subtypes;
+    if ( subtype_id != 0 )
+        subtypes.push_back (subtype_id);
+    return select_assets_by_type (conn, type_id, subtypes, asset_filter_t {}, NULL, cb);
+}
+
+int
+    select_assets_by_type
+        (tntdb::Connection &conn,
+         a_elmnt_tp_id_t type_id,
+         const std::vector<a_elmnt_stp_id_t> &subtypes,
+         const asset_filter_t &filter,
+         uint32_t *total,
+         std::function<void(const tntdb::Row&)> cb)
+{
+    LOG_START;
+    log_debug ("type_id = %" PRIu16 ", %zu subtypes", type_id, subtypes.size ());
+
+    try {
+        std::string where = " WHERE a.id_type = :typeid ";
+        where += s_filter_sql ({}, subtypes, filter);
+
+        if ( total ) {
+            tntdb::Statement st = conn.prepareCached (
+                " SELECT COUNT(*) FROM t_bios_asset_element a " + where);
+            st.set ("typeid", type_id);
+            s_filter_bind (st, filter);
+            *total = st.selectValue ().getUnsigned32 ();
+        }
+
+        std::string select = " SELECT " ASSET_LIST_COLUMNS + where;
+        if ( filter.after != 0 )
+            select += " AND a.id_asset_element > :after ";
+        select += " ORDER BY a.id_asset_element ";
+        if ( filter.limit != 0 )
+            select += " LIMIT :limit ";
+
         // Can return more than one row.
         tntdb::Statement st = conn.prepareCached (select);
-
-        tntdb::Result result = st.set("containerid", element_id).
-                                  select();
-        log_debug("[v_bios_asset_element_super_parent]: were selected %" PRIu32 " rows",
+        st.set ("typeid", type_id);
+        if ( filter.after != 0 )
+            st.set ("after", filter.after);
+        if ( filter.limit != 0 )
+            st.set ("limit", filter.limit);
+        s_filter_bind (st, filter);
+
+        tntdb::Result result = st.select ();
+        log_debug ("[t_bios_asset_element]: were selected %" PRIu32 " rows",
                                                             result.size());
         for ( auto &row: result ) {
             cb(row);
@@ -1063,6 +1270,163 @@ int
     }
 }
 
+int
+    select_asset_details
+        (tntdb::Connection &conn,
+         const std::vector<a_elmnt_id_t> &ids,
+         std::function<void(const db_web_element_t&)> cb)
+{
+    LOG_START;
+    log_debug ("%zu ids", ids.size ());
+
+    try {
+        std::vector<a_elmnt_id_t> sorted (ids);
+        std::sort (sorted.begin (), sorted.end ());
+        sorted.erase (std::unique (sorted.begin (), sorted.end ()), sorted.end ());
+
+        for_each_id_chunk (sorted,
+            [&conn, &cb](const std::string &list)
+            {
+                std::map <a_elmnt_id_t, db_web_element_t> items;
+
+                // 1/2 basic information and up to five parents
+                tntdb::Statement st = conn.prepare (
+                    " SELECT"
+                    "   v.id, v.name, v.id_type, v.type_name,"
+                    "   v.subtype_id, v.id_parent,"
+                    "   v.id_parent_type, v.status,"
+                    "   v.priority, v.asset_tag, v.parent_name,"
+                    "   p.id_parent1, p.id_parent2, p.id_parent3, p.id_parent4, p.id_parent5,"
+                    "   p.name_parent1, p.name_parent2, p.name_parent3, p.name_parent4, p.name_parent5,"
+                    "   p.id_type_parent1, p.id_type_parent2, p.id_type_parent3,"
+                    "   p.id_type_parent4, p.id_type_parent5,"
+                    "   p.id_subtype_parent1, p.id_subtype_parent2, p.id_subtype_parent3,"
+                    "   p.id_subtype_parent4, p.id_subtype_parent5"
+                    " FROM"
+                    "   v_web_element v"
+                    " LEFT JOIN"
+                    "   v_bios_asset_element_super_parent p"
+                    " ON"
+                    "   p.id_asset_element = v.id"
+                    " WHERE v.id in (" + list + ")");
+
+                for ( auto &row: st.select () )
+                {
+                    db_web_element_t item {};
+                    row[0].get(item.basic.id);
+                    // v_web_element can return more than one row, first one wins
+                    if ( items.count (item.basic.id) )
+                        continue;
+                    row[1].get(item.basic.name);
+                    row[2].get(item.basic.type_id);
+                    row[3].get(item.basic.type_name);
+                    row[4].get(item.basic.subtype_id);
+                    row[5].get(item.basic.parent_id);
+                    row[6].get(item.basic.parent_type_id);
+                    row[7].get(item.basic.status);
+                    row[8].get(item.basic.priority);
+                    row[9].get(item.basic.asset_tag);
+                    row[10].get(item.basic.parent_name);
+                    item.basic.subtype_name = subtypeid_to_subtype (item.basic.subtype_id);
+
+                    for ( int i = 0; i != 5; ++i ) {
+                        a_elmnt_id_t id = 0;
+                        row[11 + i].get (id);
+                        std::string name;
+                        row[16 + i].get (name);
+                        a_elmnt_tp_id_t id_type = 0;
+                        row[21 + i].get (id_type);
+                        a_elmnt_stp_id_t id_subtype = 0;
+                        row[26 + i].get (id_subtype);
+                        if ( !name.empty () )
+                            item.parents.push_back (std::make_tuple (
+                                id,
+                                name,
+                                typeid_to_type (id_type),
+                                subtypeid_to_subtype (id_subtype)));
+                    }
+                    items.emplace (item.basic.id, item);
+                }
+                if ( items.empty () )
+                    return;
+
+                // 2/2 ext attributes, groups and power links in one go,
+                // the first column tells which one the row is
+                st = conn.prepare (
+                    " SELECT"
+                    "   'e', e.id_asset_element, e.keytag, e.value, e.read_only, NULL, NULL"
+                    " FROM"
+                    "   v_bios_asset_ext_attributes e"
+                    " WHERE e.id_asset_element in (" + list + ")"
+                    " UNION ALL"
+                    " SELECT"
+                    "   'g', r.id_asset_element, g.name, NULL, r.id_asset_group, NULL, NULL"
+                    " FROM"
+                    "   v_bios_asset_group_relation r,"
+                    "   v_bios_asset_element g"
+                    " WHERE"
+                    "   r.id_asset_element in (" + list + ") AND"
+                    "   g.id = r.id_asset_group"
+                    " UNION ALL"
+                    " SELECT"
+                    "   'l', l.id_asset_element_dest, l.src_name, NULL, l.id_asset_element_src,"
+                    "   l.src_out, l.dest_in"
+                    " FROM"
+                    "   v_web_asset_link l"
+                    " WHERE"
+                    "   l.id_asset_element_dest in (" + list + ") AND"
+                    "   l.id_asset_link_type = :idlinktype");
+
+                for ( auto &row: st.set ("idlinktype", INPUT_POWER_CHAIN).select () )
+                {
+                    std::string kind;
+                    row[0].get (kind);
+                    a_elmnt_id_t id = 0;
+                    row[1].get (id);
+                    auto it = items.find (id);
+                    if ( it == items.end () )
+                        continue;
+                    db_web_element_t &item = it->second;
+
+                    if ( kind == "e" ) {
+                        std::string keytag, value;
+                        int read_only = 0;
+                        row[2].get (keytag);
+                        row[3].get (value);
+                        row[4].get (read_only);
+                        item.ext.emplace (keytag, std::make_pair (value, read_only ? true : false));
+                    }
+                    else
+                    if ( kind == "g" ) {
+                        a_elmnt_id_t group_id = 0;
+                        std::string group_name;
+                        row[2].get (group_name);
+                        row[4].get (group_id);
+                        item.groups.emplace (group_id, group_name);
+                    }
+                    else
+                    if ( item.basic.type_id == asset_type::DEVICE ) {
+                        db_tmp_link_t link {0, id, "", "", ""};
+                        row[2].get (link.src_name);
+                        row[4].get (link.src_id);
+                        row[5].get (link.src_socket);
+                        row[6].get (link.dest_socket);
+                        item.powers.push_back (link);
+                    }
+                }
+
+                for ( const auto &it : items )
+                    cb (it.second);
+            });
+        LOG_END;
+        return 0;
+    }
+    catch (const std::exception& e) {
+        LOG_END_ABNORMAL(e);
+        return -1;
+    }
+}
+
 int select_asset_ext_attribute_by_keytag(
     tntdb::Connection &conn,
     const std::string &keytag,
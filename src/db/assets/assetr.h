@@ -73,6 +73,22 @@ struct db_web_element_t{
     std::vector <std::tuple <a_elmnt_id_t, std::string, std::string, std::string>> parents;        // list of parents (id, name)
 };
 
+/**
+ * \brief filter and page of asset listings
+ *
+ * Pages are keyset based: rows are ordered by asset id and a page starts
+ * right after the last id of the previous one, so the work done scales
+ * with the page, not with the position in the list.
+ */
+struct asset_filter_t {
+    std::string      status;        //!< only assets with this status, "" means all
+    a_elmnt_pr_t     priority = 0;  //!< only assets with this priority, 0 means all
+    std::string      ext_key;       //!< only assets having this ext attribute, "" means all
+    std::string      ext_value;     //!< ... with this value, "" means any value
+    a_elmnt_id_t     after = 0;     //!< only assets with id greater than this one
+    uint32_t         limit = 0;     //!< at most this many rows, 0 means no limit
+};
+
 
 namespace persist{
 
@@ -81,6 +97,15 @@ namespace persist{
 int64_t
     name_to_asset_id (std::string asset_name);
 
+// fills asset ids for given asset names, unknown names are left out,
+// any number of names costs one query per 1000 of them
+// In case of an error it returns -1
+int
+    names_to_asset_ids
+        (tntdb::Connection &conn,
+         const std::vector <std::string> &names,
+         std::map <std::string, a_elmnt_id_t> &ids);
+
 // <name, ext_name> 
 std::pair <std::string, std::string>
     id_to_name_ext_name (uint32_t asset_id);
@@ -296,7 +321,7 @@ int
  * \param[in] cb         - callback to be called with every selected row.
  *
  *  Every selected row has the following columns:
- *      name, asset_id, subtype_id, subtype_name, type_id
+ *      name, asset_id, subtype_id, subtype_name, type_id, ext_name
  *
  * \return 0 on success (even if nothing was found)
  */
@@ -318,7 +343,7 @@ int
  * \param[in] cb         - callback to be called with every selected row.
  *
  *  Every selected row has the following columns:
- *      name, asset_id, subtype_id, subtype_name, type_id
+ *      name, asset_id, subtype_id, subtype_name, type_id, ext_name
  *
  * \return 0 on success (even if nothing was found)
  */
@@ -330,6 +355,92 @@ int
          std::vector<a_elmnt_stp_id_t> subtypes,
          std::function<void(const tntdb::Row&)> cb);
 
+/**
+ * \brief select one page of assets inside the asset-container
+ *
+ * The same as previous function, but rows are ordered by asset id and
+ * only those matching the filter are selected.
+ *
+ * \param[in]  filter - filter and page to select
+ * \param[out] total  - if not NULL, number of all matching assets
+ *                       regardless of the page
+ *
+ * \return 0 on success (even if nothing was found)
+ */
+int
+    select_assets_by_container
+        (tntdb::Connection &conn,
+         a_elmnt_id_t element_id,
+         const std::vector<a_elmnt_tp_id_t> &types,
+         const std::vector<a_elmnt_stp_id_t> &subtypes,
+         const asset_filter_t &filter,
+         uint32_t *total,
+         std::function<void(const tntdb::Row&)> cb);
+
+/**
+ * \brief select all assets of given type (and subtype) ordered by id
+ *
+ * The same as calling select_short_elements and then id_to_name_ext_name
+ * for every element, but done in one query.
+ *
+ * \param[in] conn       - db connection
+ * \param[in] type_id    - type of the elements
+ * \param[in] subtype_id - subtype of the elements, 0 means all subtypes
+ * \param[in] cb         - callback to be called with every selected row.
+ *
+ *  Every selected row has the following columns:
+ *      name, asset_id, subtype_id, subtype_name, type_id, ext_name
+ *
+ * \return 0 on success (even if nothing was found)
+ */
+int
+    select_assets_by_type
+        (tntdb::Connection &conn,
+         a_elmnt_tp_id_t type_id,
+         a_elmnt_stp_id_t subtype_id,
+         std::function<void(const tntdb::Row&)> cb);
+
+/**
+ * \brief select one page of assets of given type (and subtypes)
+ *
+ * \param[in]  subtypes - subtypes of the elements, empty vector means all
+ * \param[in]  filter   - filter and page to select
+ * \param[out] total    - if not NULL, number of all matching assets
+ *                         regardless of the page
+ *
+ * \return 0 on success (even if nothing was found)
+ */
+int
+    select_assets_by_type
+        (tntdb::Connection &conn,
+         a_elmnt_tp_id_t type_id,
+         const std::vector<a_elmnt_stp_id_t> &subtypes,
+         const asset_filter_t &filter,
+         uint32_t *total,
+         std::function<void(const tntdb::Row&)> cb);
+
+/**
+ * \brief select full details (the same as asset_manager::get_item1) of
+ *        several assets at once
+ *
+ * Every chunk of 1000 ids costs two queries regardless of the number of
+ * assets: one for v_web_element together with the parents, one for ext
+ * attributes, groups and input power links. Power links are filled for
+ * devices only.
+ *
+ * \param[in] conn - db connection
+ * \param[in] ids  - ids of the assets, duplicates are ignored
+ * \param[in] cb   - callback called once per found asset in order of ids,
+ *                   unknown ids are skipped
+ *
+ * \return 0 on success (even if nothing was found), -1 on error
+ */
+int
+    select_asset_details
+        (tntdb::Connection &conn,
+         const std::vector<a_elmnt_id_t> &ids,
+         std::function<void(const db_web_element_t&)> cb);
+
 
 /**
  * \brief read particular asset ext property of device[s]
@@ -30,6 +30,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <tntdb/row.h>
 #include <tntdb/transaction.h>
 
+#include "asset_types.h"
 #include "db/assets.h"
 #include "dbpath.h"
 #include "log.h"
@@ -236,7 +237,9 @@ void
         std::string name = persist::id_to_name_ext_name (id_num).second;
         lcs.add(name);
 
-        r["type_name"].get(type_name);
+        a_elmnt_tp_id_t type_id = 0;
+        r["id_type"].get(type_id);
+        type_name = persist::typeid_to_type (type_id);
         lcs.add(type_name);
 
         std::string subtype_name = "";
@@ -248,7 +251,9 @@ void
             }
         }
         else {
-            r["subtype_name"].get(subtype_name);
+            a_elmnt_stp_id_t subtype_id = 0;
+            r["subtype_id"].get(subtype_id);
+            subtype_name = persist::subtypeid_to_subtype (subtype_id);
         }
         if ( subtype_name == "N_A" )
             subtype_name = "";
@@ -60,22 +60,18 @@ int
     return 5;
 }
 
-static std::map<std::string,int>
-    read_element_types
-        (tntdb::Connection &conn)
+// Business requirement: be able to write 'rack controller', 'RC', 'rc' as subtype == 'rack controller'
+static const std::map<std::string,int>&
+    device_types_with_aliases (void)
 {
-    auto res = get_dictionary_element_type(conn);
-    // in case of any error, it would be empty
-    return res.item;
-}
-
-static std::map<std::string,int>
-    read_device_types
-        (tntdb::Connection &conn)
-{
-    auto res = get_dictionary_device_type(conn);
-    // in case of any error, it would be empty
-    return res.item;
+    static const std::map<std::string,int> SUBTYPES = []() {
+        std::map<std::string,int> ret = device_types ();
+        for (const char *alias : {"rackcontroller", "rackcontroler", "rc", "RC", "RC3"})
+            ret.emplace (alias, asset_subtype::RACKCONTROLLER);
+        ret.emplace ("patchpanel", asset_subtype::PATCHPANEL);
+        return ret;
+    }();
+    return SUBTYPES;
 }
 
 static bool
@@ -300,19 +296,7 @@ static std::pair<db_a_elmnt_t, persist::asset_operation>
 
 
 
-    // Business requirement: be able to write 'rack controller', 'RC', 'rc' as subtype == 'rack controller'
-    std::map<std::string,int> local_SUBTYPES = SUBTYPES;
-    int rack_controller_id = SUBTYPES.find ("rack controller")->second;
-    int patch_panel_id = SUBTYPES.find ("patch panel")->second;
-
-    local_SUBTYPES.emplace (std::make_pair ("rackcontroller", rack_controller_id));
-    local_SUBTYPES.emplace (std::make_pair ("rackcontroler", rack_controller_id));
-    local_SUBTYPES.emplace (std::make_pair ("rc", rack_controller_id));
-    local_SUBTYPES.emplace (std::make_pair ("RC", rack_controller_id));
-    local_SUBTYPES.emplace (std::make_pair ("RC3", rack_controller_id));
-
-    local_SUBTYPES.emplace (std::make_pair ("patchpanel", patch_panel_id));
-
+    const std::map<std::string,int> &local_SUBTYPES = device_types_with_aliases ();
     auto subtype = cm.get_strip (row_i, "sub_type");
 
     log_debug ("subtype = '%s'", subtype.c_str());
@@ -330,7 +314,9 @@ static std::pair<db_a_elmnt_t, persist::asset_operation>
         bios_throw("request-param-required", "subtype (for type group)");
     }
 
-    auto subtype_id = local_SUBTYPES.find(subtype)->second;
+    // only devices must have a known subtype, the rest defaults to N_A like in the database
+    auto subtype_it = local_SUBTYPES.find(subtype);
+    auto subtype_id = subtype_it != local_SUBTYPES.cend() ? subtype_it->second : (int) asset_subtype::N_A;
     unused_columns.erase("sub_type");
 
     // now we have read all basic information about element
@@ -756,9 +742,9 @@ std::pair<db_a_elmnt_t, persist::asset_operation>
         bios_throw("internal-error", msg.c_str());
     }
 
-    auto TYPES = read_element_types (conn);
+    const auto &TYPES = element_types ();
 
-    auto SUBTYPES = read_device_types (conn);
+    const auto &SUBTYPES = device_types ();
 
     std::set<a_elmnt_id_t> ids{};
     auto ret = process_row(conn, cm, 1, TYPES, SUBTYPES, ids, false);
@@ -798,9 +784,9 @@ void
         bios_throw("internal-error", msg.c_str());
     }
 
-    auto TYPES = read_element_types (conn);
+    const auto &TYPES = element_types ();
 
-    auto SUBTYPES = read_device_types (conn);
+    const auto &SUBTYPES = device_types ();
 
     // BIOS-2506
     std::set<a_elmnt_id_t> ids{};
@@ -0,0 +1,419 @@
+/*
+Copyright (C) 2014-2015 Eaton
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*! \file   power_topology.cc
+    \brief  In-memory power accounting of the containers
+*/
+
+#include "power_topology.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+#include <tntdb/result.h>
+#include <tntdb/row.h>
+
+#include "log.h"
+#include "asset_types.h"
+#include "asset_closure.h"
+#include "asset_generation.h"
+
+namespace persist {
+
+const uint32_t PowerTopology::NONE;
+
+static void
+s_erase (std::vector<uint32_t> &v, uint32_t value)
+{
+    v.erase (std::remove (v.begin (), v.end (), value), v.end ());
+}
+
+PowerTopology::PowerTopology (const std::vector<asset_t> &assets, const Links &links)
+{
+    const size_t n = assets.size ();
+    _index.reserve (n);
+    _ids.reserve (n);
+    for (const auto &asset : assets) {
+        if (_index.emplace (asset.id, _ids.size ()).second)
+            _ids.push_back (asset.id);
+    }
+
+    _parent.assign (_ids.size (), NONE);
+    _power.assign (_ids.size (), false);
+    for (const auto &asset : assets) {
+        uint32_t i = _index[asset.id];
+        auto p = _index.find (asset.parent);
+        if (asset.parent != 0 && p != _index.end () && p->second != i)
+            _parent[i] = p->second;
+        _power[i] = is_power_device (asset.subtype);
+    }
+
+    // depths, a parent cycle is broken where it is found
+    enum { UNKNOWN, ON_CHAIN, DONE };
+    std::vector<uint8_t> state (_ids.size (), UNKNOWN);
+    std::vector<uint32_t> chain;
+    _depth.assign (_ids.size (), 0);
+    for (uint32_t i = 0; i != _ids.size (); ++i) {
+        chain.clear ();
+        uint32_t j = i;
+        while (j != NONE && state[j] == UNKNOWN) {
+            state[j] = ON_CHAIN;
+            chain.push_back (j);
+            j = _parent[j];
+        }
+        if (j != NONE && state[j] == ON_CHAIN)
+            _parent[chain.back ()] = NONE;
+        for (auto it = chain.rbegin (); it != chain.rend (); ++it) {
+            uint32_t parent = _parent[*it];
+            _depth[*it] = parent == NONE ? 0 : std::min (_depth[parent] + 1, 255);
+            state[*it] = DONE;
+        }
+    }
+
+    _children.assign (_ids.size (), 0);
+    for (const auto parent : _parent) {
+        if (parent != NONE)
+            ++_children[parent];
+    }
+
+    _sources.resize (_ids.size ());
+    _dests.resize (_ids.size ());
+    for (const auto &link : links) {
+        auto s = _index.find (link.first);
+        auto d = _index.find (link.second);
+        if (s == _index.end () || d == _index.end () || s->second == d->second)
+            continue;
+        _sources[d->second].push_back (s->second);
+        _dests[s->second].push_back (d->second);
+    }
+    // links differing only in sockets count once
+    for (auto *adjacency : {&_sources, &_dests}) {
+        for (auto &v : *adjacency) {
+            std::sort (v.begin (), v.end ());
+            v.erase (std::unique (v.begin (), v.end ()), v.end ());
+        }
+    }
+
+    _contributors.resize (_ids.size ());
+    for (uint32_t i = 0; i != _ids.size (); ++i) {
+        if (_power[i])
+            contribute (i, true);
+    }
+}
+
+bool
+    PowerTopology::is_power_device (a_elmnt_stp_id_t subtype)
+{
+    switch (subtype) {
+        case asset_subtype::UPS:
+        case asset_subtype::GENSET:
+        case asset_subtype::EPDU:
+        case asset_subtype::PDU:
+        case asset_subtype::FEED:
+        case asset_subtype::STS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+int
+    PowerTopology::bound (uint32_t device) const
+{
+    int ret = -1;
+    for (const auto source : _sources[device]) {
+        uint32_t a = _parent[device];
+        uint32_t b = _parent[source];
+        while (a != NONE && b != NONE && a != b) {
+            if (_depth[a] >= _depth[b])
+                a = _parent[a];
+            else
+                b = _parent[b];
+        }
+        if (a != NONE && a == b)
+            ret = std::max (ret, (int) _depth[a]);
+    }
+    return ret;
+}
+
+void
+    PowerTopology::contribute (uint32_t device, bool add)
+{
+    int depth = bound (device);
+    for (uint32_t c = _parent[device]; c != NONE && _depth[c] > depth; c = _parent[c]) {
+        if (add)
+            _contributors[c].push_back (device);
+        else
+            s_erase (_contributors[c], device);
+    }
+}
+
+std::vector<a_elmnt_id_t>
+    PowerTopology::contributors (a_elmnt_id_t container) const
+{
+    std::vector<a_elmnt_id_t> ret;
+    auto it = _index.find (container);
+    if (it == _index.end ())
+        return ret;
+    ret.reserve (_contributors[it->second].size ());
+    for (const auto device : _contributors[it->second])
+        ret.push_back (_ids[device]);
+    std::sort (ret.begin (), ret.end ());
+    return ret;
+}
+
+void
+    PowerTopology::add_link (a_elmnt_id_t src, a_elmnt_id_t dest)
+{
+    auto s = _index.find (src);
+    auto d = _index.find (dest);
+    if (s == _index.end () || d == _index.end () || s->second == d->second)
+        return;
+    auto &sources = _sources[d->second];
+    if (std::find (sources.begin (), sources.end (), s->second) != sources.end ())
+        return;
+
+    if (_power[d->second])
+        contribute (d->second, false);
+    sources.push_back (s->second);
+    _dests[s->second].push_back (d->second);
+    if (_power[d->second])
+        contribute (d->second, true);
+}
+
+void
+    PowerTopology::remove_link (a_elmnt_id_t src, a_elmnt_id_t dest)
+{
+    auto s = _index.find (src);
+    auto d = _index.find (dest);
+    if (s == _index.end () || d == _index.end ())
+        return;
+
+    if (_power[d->second])
+        contribute (d->second, false);
+    s_erase (_sources[d->second], s->second);
+    s_erase (_dests[s->second], d->second);
+    if (_power[d->second])
+        contribute (d->second, true);
+}
+
+bool
+    PowerTopology::add_asset (const asset_t &asset)
+{
+    if (_index.count (asset.id))
+        return false;
+
+    uint32_t i = _ids.size ();
+    auto p = _index.find (asset.parent);
+    uint32_t parent = (asset.parent != 0 && p != _index.end ()) ? p->second : NONE;
+
+    _index[asset.id] = i;
+    _ids.push_back (asset.id);
+    _parent.push_back (parent);
+    _depth.push_back (parent == NONE ? 0 : std::min (_depth[parent] + 1, 255));
+    _power.push_back (is_power_device (asset.subtype));
+    _children.push_back (0);
+    _sources.emplace_back ();
+    _dests.emplace_back ();
+    _contributors.emplace_back ();
+    if (parent != NONE)
+        ++_children[parent];
+    if (_power[i])
+        contribute (i, true);
+    return true;
+}
+
+bool
+    PowerTopology::remove_asset (a_elmnt_id_t id)
+{
+    auto it = _index.find (id);
+    if (it == _index.end ())
+        return true;
+    if (_children[it->second] != 0)
+        return false;
+    uint32_t i = it->second;
+
+    // devices it powers may start to count in its containers
+    for (const auto dest : std::vector<uint32_t> (_dests[i]))
+        remove_link (id, _ids[dest]);
+    for (const auto source : std::vector<uint32_t> (_sources[i]))
+        remove_link (_ids[source], id);
+    if (_power[i])
+        contribute (i, false);
+    if (_parent[i] != NONE)
+        --_children[_parent[i]];
+
+    // the slot stays, indexes of the others must not change
+    _index.erase (it);
+    _ids[i] = 0;
+    _parent[i] = NONE;
+    _power[i] = false;
+    _contributors[i].clear ();
+    return true;
+}
+
+bool
+    PowerTopology::update (const asset_t &asset, const std::vector<a_elmnt_id_t> &sources)
+{
+    auto it = _index.find (asset.id);
+    if (it == _index.end ())
+        add_asset (asset);
+    else {
+        uint32_t i = it->second;
+        auto p = _index.find (asset.parent);
+        uint32_t parent = (asset.parent != 0 && p != _index.end () && p->second != i) ? p->second : NONE;
+        if (parent != _parent[i] || is_power_device (asset.subtype) != _power[i]) {
+            if (_children[i] != 0)
+                return false;
+            // a new place, links from it are put back
+            std::vector<a_elmnt_id_t> dests;
+            for (const auto dest : _dests[i])
+                dests.push_back (_ids[dest]);
+            remove_asset (asset.id);
+            add_asset (asset);
+            for (const auto dest : dests)
+                add_link (asset.id, dest);
+        }
+    }
+
+    uint32_t i = _index[asset.id];
+    std::vector<a_elmnt_id_t> current;
+    for (const auto source : _sources[i])
+        current.push_back (_ids[source]);
+    for (const auto source : current) {
+        if (std::find (sources.begin (), sources.end (), source) == sources.end ())
+            remove_link (source, asset.id);
+    }
+    for (const auto source : sources)
+        add_link (source, asset.id);
+    return true;
+}
+
+static std::mutex s_topology_mux;
+static PowerTopologyPtr s_topology;
+static uint64_t s_topology_period = 0;
+static uint64_t s_topology_generation = 0;
+
+PowerTopologyPtr
+    power_topology
+        (tntdb::Connection &conn)
+{
+    std::lock_guard<std::mutex> lock (s_topology_mux);
+
+    uint64_t generation = asset_generation ();
+    uint64_t period = asset_period ();
+    if (s_topology
+        && s_topology_generation == generation
+        && s_topology_period == period)
+        return s_topology;
+
+    tntdb::Result result = conn.prepareCached (
+        " SELECT id_asset_element, id_parent, id_subtype FROM t_bios_asset_element "
+    ).select ();
+    std::vector<PowerTopology::asset_t> assets;
+    assets.reserve (result.size ());
+    for (const auto &row : result) {
+        PowerTopology::asset_t asset {0, 0, 0};
+        row[0].get (asset.id);
+        row[1].get (asset.parent);      // NULL for datacenters
+        row[2].get (asset.subtype);
+        assets.push_back (asset);
+    }
+
+    result = conn.prepareCached (
+        " SELECT id_asset_device_src, id_asset_device_dest FROM t_bios_asset_link "
+        " WHERE id_asset_link_type = :linktype "
+    ).set ("linktype", INPUT_POWER_CHAIN).select ();
+    PowerTopology::Links links;
+    links.reserve (result.size ());
+    for (const auto &row : result) {
+        a_elmnt_id_t src = 0, dest = 0;
+        row[0].get (src);
+        row[1].get (dest);
+        links.emplace_back (src, dest);
+    }
+
+    s_topology = std::make_shared<const PowerTopology> (assets, links);
+    s_topology_period = period;
+    s_topology_generation = generation;
+    log_debug ("power topology loaded, %zu elements, %zu links", s_topology->size (), links.size ());
+    return s_topology;
+}
+
+void
+    power_topology_changed
+        (tntdb::Connection &conn,
+         const std::vector<a_elmnt_id_t> &ids,
+         uint64_t generation)
+{
+    std::lock_guard<std::mutex> lock (s_topology_mux);
+
+    // a change we did not see, the next power_topology () reloads everything
+    if (!s_topology || s_topology_generation + 1 != generation)
+        return;
+
+    try {
+        std::map<a_elmnt_id_t, PowerTopology::asset_t> changed;
+        std::map<a_elmnt_id_t, std::vector<a_elmnt_id_t>> sources;
+        for_each_id_chunk (ids, [&conn, &changed, &sources](const std::string &list) {
+            tntdb::Result result = conn.prepare (
+                " SELECT id_asset_element, id_parent, id_subtype FROM t_bios_asset_element "
+                " WHERE id_asset_element IN (" + list + ")"
+            ).select ();
+            for (const auto &row : result) {
+                PowerTopology::asset_t asset {0, 0, 0};
+                row[0].get (asset.id);
+                row[1].get (asset.parent);      // NULL for datacenters
+                row[2].get (asset.subtype);
+                changed.emplace (asset.id, asset);
+            }
+
+            result = conn.prepare (
+                " SELECT id_asset_device_src, id_asset_device_dest FROM t_bios_asset_link "
+                " WHERE id_asset_link_type = :linktype "
+                "   AND id_asset_device_dest IN (" + list + ")"
+            ).set ("linktype", INPUT_POWER_CHAIN).select ();
+            for (const auto &row : result) {
+                a_elmnt_id_t src = 0, dest = 0;
+                row[0].get (src);
+                row[1].get (dest);
+                sources[dest].push_back (src);
+            }
+        });
+
+        // readers keep the instance they got, the copy replaces it
+        auto next = std::make_shared<PowerTopology> (*s_topology);
+        for (const auto id : ids) {
+            auto it = changed.find (id);
+            bool ok = it != changed.end () ? next->update (it->second, sources[id]) : next->remove_asset (id);
+            if (!ok) {
+                s_topology.reset ();
+                return;
+            }
+        }
+        s_topology = next;
+        s_topology_generation = generation;
+    }
+    catch (const std::exception &e) {
+        s_topology.reset ();
+        log_error ("updating power topology failed: %s", e.what ());
+    }
+}
+
+} // namespace persist
@@ -0,0 +1,154 @@
+/*
+Copyright (C) 2014-2015 Eaton
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*! \file   power_topology.h
+    \brief  In-memory power accounting of the containers
+*/
+
+#ifndef SRC_DB_POWER_TOPOLOGY_H
+#define SRC_DB_POWER_TOPOLOGY_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <tntdb/connect.h>
+
+#include "dbtypes.h"
+
+namespace persist {
+
+/**
+ * \brief Power devices whose sum is the total power of a container
+ *
+ * A power device (ups, genset, epdu, pdu, feed, sts) contributes to
+ * the total power of every container it is in, unless one of its
+ * power sources is in that container too - its power is already
+ * counted there at the source. So for a device the contributions end
+ * at the deepest common container of the device and any of its sources,
+ * which is found by walking at most the five levels of the tree.
+ *
+ * Containment and power links are kept in arrays indexed by a dense
+ * element index, contributors of all containers are computed in one
+ * pass over the power devices. Single link and leaf asset changes are
+ * applied in place, they only touch the containers of the devices
+ * involved. The shared instance is never changed, power_topology_changed ()
+ * applies changes to a copy and publishes it.
+ */
+class PowerTopology {
+public:
+    struct asset_t {
+        a_elmnt_id_t     id;
+        a_elmnt_id_t     parent;    // 0 for roots
+        a_elmnt_stp_id_t subtype;
+    };
+    /** \brief (id_asset_device_src, id_asset_device_dest) power links */
+    typedef std::vector<std::pair<a_elmnt_id_t, a_elmnt_id_t>> Links;
+
+    PowerTopology (const std::vector<asset_t> &assets, const Links &links);
+
+    /** \brief contributors to the total power of container, sorted by id */
+    std::vector<a_elmnt_id_t> contributors (a_elmnt_id_t container) const;
+
+    /** \brief true for subtypes measuring power for the containers */
+    static bool is_power_device (a_elmnt_stp_id_t subtype);
+
+    void add_link (a_elmnt_id_t src, a_elmnt_id_t dest);
+    void remove_link (a_elmnt_id_t src, a_elmnt_id_t dest);
+
+    /**
+     * \brief Adds a new asset without children and links
+     *
+     * Returns false (and does nothing) if the id is already known.
+     */
+    bool add_asset (const asset_t &asset);
+
+    /**
+     * \brief Removes an asset together with its links
+     *
+     * Returns false (and does nothing) for assets with children, removing
+     * those needs a reload. Unknown ids are ignored.
+     */
+    bool remove_asset (a_elmnt_id_t id);
+
+    /**
+     * \brief Adds or replaces one asset together with the sources of
+     *        its power links
+     *
+     * Links from the asset to others are kept. Returns false (and does
+     * nothing) if an asset with children moved or changed its subtype,
+     * the depths below it are not known here, reload instead.
+     */
+    bool update (const asset_t &asset, const std::vector<a_elmnt_id_t> &sources);
+
+    size_t size () const { return _index.size (); }
+
+private:
+    static const uint32_t NONE = UINT32_MAX;
+
+    // depth of the deepest container shared with a source, -1 for none
+    int bound (uint32_t device) const;
+    void contribute (uint32_t device, bool add);
+
+    std::unordered_map<a_elmnt_id_t, uint32_t> _index;
+    std::vector<a_elmnt_id_t> _ids;
+    std::vector<uint32_t> _parent;
+    std::vector<uint8_t> _depth;
+    std::vector<bool> _power;
+    std::vector<uint32_t> _children;
+    std::vector<std::vector<uint32_t>> _sources;
+    std::vector<std::vector<uint32_t>> _dests;
+    // per container, element indexes of the contributors
+    std::vector<std::vector<uint32_t>> _contributors;
+};
+
+typedef std::shared_ptr<const PowerTopology> PowerTopologyPtr;
+
+/**
+ * \brief Returns the power topology of the current asset generation,
+ *        loading it from t_bios_asset_element and t_bios_asset_link
+ *        if needed
+ *
+ * Reloaded after a change this process did not apply and in every new
+ * asset_period (), like asset_closure (). Throws on database errors.
+ */
+PowerTopologyPtr
+    power_topology
+        (tntdb::Connection &conn);
+
+/**
+ * \brief Applies committed changes of assets ids and of the power links
+ *        to them to the power topology
+ *
+ * Call with the generation returned by bump_asset_generation () after
+ * the commit, like rack_capacity_changed (). The changes are applied to
+ * a copy, which replaces the shared instance only if it was up to date
+ * with the previous generation, otherwise the next power_topology ()
+ * reloads it. Never throws.
+ */
+void
+    power_topology_changed
+        (tntdb::Connection &conn,
+         const std::vector<a_elmnt_id_t> &ids,
+         uint64_t generation);
+
+} // namespace persist
+
+#endif // SRC_DB_POWER_TOPOLOGY_H
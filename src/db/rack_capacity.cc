@@ -0,0 +1,340 @@
+/*
+Copyright (C) 2014-2015 Eaton
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*! \file   rack_capacity.cc
+    \brief  Index of used and free space and outlets of the racks
+*/
+
+#include "rack_capacity.h"
+
+#include <memory>
+#include <mutex>
+
+#include <tntdb/result.h>
+#include <tntdb/row.h>
+
+#include "log.h"
+#include "utils.h"
+#include "asset_types.h"
+#include "asset_closure.h"
+#include "asset_generation.h"
+
+namespace persist {
+
+// deeper chains are broken parent cycles
+#define RACK_CAPACITY_MAX_DEPTH 16
+
+RackCapacity::RackCapacity (const std::vector<asset_t> &assets)
+{
+    _assets.reserve (assets.size ());
+    for (const auto &asset : assets)
+        _assets[asset.id] = node_t {asset, 0, 0};
+
+    for (const auto &it : _assets) {
+        auto parent = _assets.find (it.second.asset.parent);
+        if (parent != _assets.end ())
+            ++parent->second.children;
+        if (it.second.asset.type == asset_type::RACK)
+            _racks[it.first] = rack_t {0, {}};
+        use_outlets (it.second.asset.sources, 1);
+    }
+    for (const auto &it : _assets)
+        attach (it.second, 1);
+}
+
+a_elmnt_id_t
+    RackCapacity::rack_of (a_elmnt_id_t id) const
+{
+    auto it = _assets.find (id);
+    for (int depth = 0; it != _assets.end () && depth != RACK_CAPACITY_MAX_DEPTH; ++depth) {
+        auto parent = _assets.find (it->second.asset.parent);
+        if (parent == _assets.end ())
+            return 0;
+        if (parent->second.asset.type == asset_type::RACK)
+            return parent->first;
+        it = parent;
+    }
+    return 0;
+}
+
+void
+    RackCapacity::attach (const node_t &node, int sign)
+{
+    a_elmnt_id_t id = rack_of (node.asset.id);
+    if (id == 0)
+        return;
+    rack_t &rack = _racks[id];
+    rack.used_u += sign * node.asset.u_size;
+    if (is_epdu (node.asset.subtype) || is_pdu (node.asset.subtype)) {
+        if (sign > 0)
+            rack.pdus.insert (node.asset.id);
+        else
+            rack.pdus.erase (node.asset.id);
+    }
+}
+
+void
+    RackCapacity::use_outlets (const std::vector<a_elmnt_id_t> &sources, int count)
+{
+    // sources deleted meanwhile are simply not found
+    for (const auto source : sources) {
+        auto it = _assets.find (source);
+        if (it != _assets.end ())
+            it->second.outlets_used += count;
+    }
+}
+
+bool
+    RackCapacity::get (a_elmnt_id_t id, rack_capacity_t &capacity) const
+{
+    auto rack = _racks.find (id);
+    auto node = _assets.find (id);
+    if (rack == _racks.end () || node == _assets.end ())
+        return false;
+
+    capacity.id = id;
+    capacity.size_u = node->second.asset.u_size;
+    capacity.used_u = rack->second.used_u;
+    capacity.free_u = capacity.size_u != 0 ? capacity.size_u - capacity.used_u : -1;
+    capacity.outlets_free = 0;
+    capacity.outlets.clear ();
+
+    bool tainted = false;
+    for (const auto pdu : rack->second.pdus) {
+        const node_t &p = _assets.at (pdu);
+        int available = p.asset.outlet_count >= 0 ? p.asset.outlet_count - p.outlets_used : -1;
+        if (available >= 0)
+            capacity.outlets_free += available;
+        else
+            tainted = true;
+        capacity.outlets[pdu] = available;
+    }
+    if (tainted)
+        capacity.outlets_free = -1;
+    return true;
+}
+
+bool
+    RackCapacity::update (const asset_t &asset)
+{
+    auto it = _assets.find (asset.id);
+    if (it == _assets.end ()) {
+        node_t &node = _assets[asset.id] = node_t {asset, 0, 0};
+        auto parent = _assets.find (asset.parent);
+        if (parent != _assets.end ())
+            ++parent->second.children;
+        if (asset.type == asset_type::RACK)
+            _racks[asset.id] = rack_t {0, {}};
+        use_outlets (asset.sources, 1);
+        attach (node, 1);
+        return true;
+    }
+
+    node_t &node = it->second;
+    if (node.asset.parent != asset.parent && node.children != 0
+        && asset.type != asset_type::DATACENTER
+        && asset.type != asset_type::ROOM
+        && asset.type != asset_type::ROW
+        && asset.type != asset_type::RACK)
+        return false;
+
+    attach (node, -1);
+    use_outlets (node.asset.sources, -1);
+    if (node.asset.parent != asset.parent) {
+        auto parent = _assets.find (node.asset.parent);
+        if (parent != _assets.end ())
+            --parent->second.children;
+        parent = _assets.find (asset.parent);
+        if (parent != _assets.end ())
+            ++parent->second.children;
+    }
+    node.asset = asset;
+    use_outlets (node.asset.sources, 1);
+    attach (node, 1);
+    return true;
+}
+
+bool
+    RackCapacity::remove (a_elmnt_id_t id)
+{
+    auto it = _assets.find (id);
+    if (it == _assets.end ())
+        return true;
+    if (it->second.children != 0)
+        return false;
+
+    attach (it->second, -1);
+    use_outlets (it->second.asset.sources, -1);
+    auto parent = _assets.find (it->second.asset.parent);
+    if (parent != _assets.end ())
+        --parent->second.children;
+    _racks.erase (id);
+    _assets.erase (it);
+    return true;
+}
+
+static int
+s_u_size (const std::string &value)
+{
+    uint32_t u_size = string_to_uint32 (value.c_str ());
+    return u_size != UINT32_MAX ? (int) u_size : 0;
+}
+
+static int
+s_outlet_count (std::string value)
+{
+    auto dot = value.find ('.');
+    if (dot != std::string::npos)
+        value.erase (dot);
+    // we're not going to have epdu with more 10K+ outlets
+    if (value.empty () || value.size () > 5)
+        return -1;
+    uint32_t count = string_to_uint32 (value.c_str ());
+    return count != UINT32_MAX ? (int) count : -1;
+}
+
+// all assets if ids is NULL
+static std::vector<RackCapacity::asset_t>
+s_select_assets (tntdb::Connection &conn, const std::vector<a_elmnt_id_t> *ids)
+{
+    std::vector<RackCapacity::asset_t> assets;
+    std::unordered_map<a_elmnt_id_t, size_t> index;
+
+    auto select = [&conn, &assets, &index](const std::string &where_ids) {
+        tntdb::Result result = conn.prepare (
+            " SELECT e.id_asset_element, e.id_parent, e.id_type, e.id_subtype, u.value, o.value "
+            " FROM t_bios_asset_element e "
+            "   LEFT JOIN t_bios_asset_ext_attributes u "
+            "   ON u.id_asset_element = e.id_asset_element AND u.keytag = 'u_size' "
+            "   LEFT JOIN t_bios_asset_ext_attributes o "
+            "   ON o.id_asset_element = e.id_asset_element AND o.keytag = 'outlet.count' "
+            + (where_ids.empty () ? "" : " WHERE e.id_asset_element IN (" + where_ids + ")")
+        ).select ();
+        for (const auto &row : result) {
+            RackCapacity::asset_t asset {0, 0, 0, 0, 0, -1, {}};
+            std::string u_size, outlet_count;
+            row[0].get (asset.id);
+            row[1].get (asset.parent);      // NULL for datacenters
+            row[2].get (asset.type);
+            row[3].get (asset.subtype);
+            if (row[4].get (u_size))
+                asset.u_size = s_u_size (u_size);
+            if (row[5].get (outlet_count))
+                asset.outlet_count = s_outlet_count (outlet_count);
+            index[asset.id] = assets.size ();
+            assets.push_back (asset);
+        }
+
+        result = conn.prepare (
+            " SELECT id_asset_device_src, id_asset_device_dest FROM t_bios_asset_link "
+            " WHERE id_asset_link_type = :linktype "
+            + (where_ids.empty () ? "" : " AND id_asset_device_dest IN (" + where_ids + ")")
+        ).set ("linktype", INPUT_POWER_CHAIN).select ();
+        for (const auto &row : result) {
+            a_elmnt_id_t src = 0, dest = 0;
+            row[0].get (src);
+            row[1].get (dest);
+            auto it = index.find (dest);
+            if (it != index.end ())
+                assets[it->second].sources.push_back (src);
+        }
+    };
+
+    if (ids == NULL)
+        select ("");
+    else
+        for_each_id_chunk (*ids, select);
+    return assets;
+}
+
+static std::mutex s_capacity_mux;
+static std::unique_ptr<RackCapacity> s_capacity;
+static uint64_t s_capacity_period = 0;
+static uint64_t s_capacity_generation = 0;
+
+int
+    select_rack_capacity
+        (tntdb::Connection &conn,
+         const std::vector<a_elmnt_id_t> &racks,
+         std::vector<rack_capacity_t> &capacities)
+{
+    std::lock_guard<std::mutex> lock (s_capacity_mux);
+
+    uint64_t generation = asset_generation ();
+    uint64_t period = asset_period ();
+    if (!s_capacity
+        || s_capacity_generation != generation
+        || s_capacity_period != period)
+    {
+        try {
+            s_capacity.reset (new RackCapacity (s_select_assets (conn, NULL)));
+        }
+        catch (const std::exception &e) {
+            s_capacity.reset ();
+            log_error ("loading rack capacity failed: %s", e.what ());
+            return -1;
+        }
+        s_capacity_period = period;
+        s_capacity_generation = generation;
+        log_debug ("rack capacity loaded, %zu elements", s_capacity->size ());
+    }
+
+    capacities.clear ();
+    capacities.reserve (racks.size ());
+    for (const auto id : racks) {
+        rack_capacity_t capacity;
+        if (s_capacity->get (id, capacity))
+            capacities.push_back (std::move (capacity));
+    }
+    return 0;
+}
+
+void
+    rack_capacity_changed
+        (tntdb::Connection &conn,
+         const std::vector<a_elmnt_id_t> &ids,
+         uint64_t generation)
+{
+    std::lock_guard<std::mutex> lock (s_capacity_mux);
+
+    // a change we did not see, the next select reloads everything
+    if (!s_capacity || s_capacity_generation + 1 != generation)
+        return;
+
+    try {
+        std::map<a_elmnt_id_t, RackCapacity::asset_t> changed;
+        for (auto &asset : s_select_assets (conn, &ids))
+            changed.emplace (asset.id, std::move (asset));
+
+        for (const auto id : ids) {
+            auto it = changed.find (id);
+            bool ok = it != changed.end () ? s_capacity->update (it->second) : s_capacity->remove (id);
+            if (!ok) {
+                s_capacity.reset ();
+                return;
+            }
+        }
+        s_capacity_generation = generation;
+    }
+    catch (const std::exception &e) {
+        s_capacity.reset ();
+        log_error ("updating rack capacity failed: %s", e.what ());
+    }
+}
+
+} // namespace persist
@@ -0,0 +1,140 @@
+/*
+Copyright (C) 2014-2015 Eaton
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*! \file   rack_capacity.h
+    \brief  Index of used and free space and outlets of the racks
+*/
+
+#ifndef SRC_DB_RACK_CAPACITY_H
+#define SRC_DB_RACK_CAPACITY_H
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <tntdb/connect.h>
+
+#include "dbtypes.h"
+
+namespace persist {
+
+struct rack_capacity_t {
+    a_elmnt_id_t id;
+    int size_u;         // u_size of the rack, 0 if not known
+    int used_u;         // sum of u_size of the devices inside
+    int free_u;         // size_u - used_u, -1 if size_u is not known
+    int outlets_free;   // sum over outlets, -1 if some count is not known
+    // epdu/pdu id -> outlet.count minus power links from it, -1 if not known
+    std::map<a_elmnt_id_t, int> outlets;
+};
+
+/**
+ * \brief Used U and outlets per rack, kept up to date device by device
+ *
+ * Every asset is indexed with its parent, u_size, outlet.count and power
+ * sources, every rack keeps the sum of u_size and the set of epdus/pdus
+ * of the devices below it. A change of one asset moves its share from
+ * one rack to another, a change of power sources moves the used outlets
+ * of the sources, no rack is ever summed up again.
+ */
+class RackCapacity {
+public:
+    struct asset_t {
+        a_elmnt_id_t     id;
+        a_elmnt_id_t     parent;        // 0 for roots
+        a_elmnt_tp_id_t  type;
+        a_elmnt_stp_id_t subtype;
+        int              u_size;        // 0 if not set
+        int              outlet_count;  // -1 if not set
+        // id_asset_device_src of power links to the asset, one per link
+        std::vector<a_elmnt_id_t> sources;
+    };
+
+    explicit RackCapacity (const std::vector<asset_t> &assets);
+
+    /** \brief false if rack is not a known rack */
+    bool get (a_elmnt_id_t rack, rack_capacity_t &capacity) const;
+
+    /**
+     * \brief Adds or replaces one asset
+     *
+     * Returns false (and does nothing) if a device with children moved,
+     * the racks of the children are not known here, reload instead.
+     */
+    bool update (const asset_t &asset);
+
+    /** \brief false (and does nothing) for assets with children,
+     *         unknown ids are ignored */
+    bool remove (a_elmnt_id_t id);
+
+    size_t size () const { return _assets.size (); }
+
+private:
+    struct node_t {
+        asset_t asset;
+        uint32_t children;
+        int outlets_used;
+    };
+    struct rack_t {
+        int used_u;
+        std::set<a_elmnt_id_t> pdus;
+    };
+
+    // nearest rack above id, 0 for none
+    a_elmnt_id_t rack_of (a_elmnt_id_t id) const;
+    void attach (const node_t &node, int sign);
+    void use_outlets (const std::vector<a_elmnt_id_t> &sources, int count);
+
+    std::unordered_map<a_elmnt_id_t, node_t> _assets;
+    std::unordered_map<a_elmnt_id_t, rack_t> _racks;
+};
+
+/**
+ * \brief Capacity of racks, unknown racks are left out
+ *
+ * The index is loaded from the database on first use, after a change
+ * this process did not apply and in every new asset_period (), like
+ * asset_closure ().
+ *
+ * \return 0 on success, -1 on database errors
+ */
+int
+    select_rack_capacity
+        (tntdb::Connection &conn,
+         const std::vector<a_elmnt_id_t> &racks,
+         std::vector<rack_capacity_t> &capacities);
+
+/**
+ * \brief Applies committed changes of assets ids to the index
+ *
+ * Call with the generation returned by bump_asset_generation () after
+ * the commit. The index is patched only if it was up to date with the
+ * previous generation, otherwise the next select reloads it. Never throws.
+ */
+void
+    rack_capacity_changed
+        (tntdb::Connection &conn,
+         const std::vector<a_elmnt_id_t> &ids,
+         uint64_t generation);
+
+} // namespace persist
+
+#endif // SRC_DB_RACK_CAPACITY_H
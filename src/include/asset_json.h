@@ -0,0 +1,70 @@
+/*
+ *
+ * Copyright (C) 2015 Eaton
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*!
+ * \file  asset_json.h
+ * \brief Details of an asset in the format of GET /api/v1/asset/<id>
+ */
+#ifndef SRC_WEB_INCLUDE_ASSET_JSON_H
+#define SRC_WEB_INCLUDE_ASSET_JSON_H
+
+#include <map>
+#include <set>
+#include <string>
+
+#include <tntdb/connect.h>
+
+#include "json_writer.h"
+#include "db/assets.h"
+
+/*!
+ \brief Adds to ids the assets whose names asset_json () writes: the asset
+        itself, its location, groups, power sources and parents
+*/
+void
+asset_json_referred (
+        const db_web_element_t &item,
+        std::set <a_elmnt_id_t> &ids);
+
+/*!
+ \brief Reads the "name" ext attribute of ids in one query
+
+ \return 0 on success
+*/
+int
+asset_json_ext_names (
+        tntdb::Connection &conn,
+        const std::set <a_elmnt_id_t> &ids,
+        std::map <a_elmnt_id_t, std::string> &ext_names);
+
+/*!
+ \brief Writes the members of the asset into the object open in json,
+        everything GET /api/v1/asset/<id> returns except "computed"
+
+ ext_names should hold the names of asset_json_referred (item), missing
+ ones are written as "".
+*/
+void
+asset_json (
+        utils::json::JsonWriter &json,
+        const db_web_element_t &item,
+        const std::map <a_elmnt_id_t, std::string> &ext_names);
+
+#endif // SRC_WEB_INCLUDE_ASSET_JSON_H
@@ -28,6 +28,7 @@
 #ifndef SRC_SHARED_ASSET_TYPES_H
 #define SRC_SHARED_ASSET_TYPES_H
 
+#include <map>
 #include <string>
 
 #include "dbtypes.h"
@@ -81,22 +82,42 @@ std::string
     operation2str
         (asset_operation operation);
 
+/*
+ * Element types and device types come from one immutable process-wide
+ * registry built on the first use: names are found by a binary search in
+ * a sorted table (case insensitive), ids index an array directly. The ids
+ * are the ones of t_bios_asset_element_type and t_bios_asset_device_type,
+ * so the registry replaces reading those dictionaries from the database.
+ */
+
+// TUNKNOWN for unknown type
 a_elmnt_tp_id_t
     type_to_typeid
         (const std::string &type);
 
-std::string
+// "unknown" for unknown type id
+const std::string&
     typeid_to_type
         (a_elmnt_tp_id_t type_id);
 
+// SUNKNOWN for unknown subtype, N_A for "" or "n_a"
 a_elmnt_stp_id_t
     subtype_to_subtypeid
         (const std::string &subtype);
 
-std::string
+// "unknown" for unknown subtype id
+const std::string&
     subtypeid_to_subtype
         (a_elmnt_tp_id_t subtype_id);
 
+// element types as in t_bios_asset_element_type, name -> id
+const std::map <std::string, int>&
+    element_types (void);
+
+// device types as in t_bios_asset_device_type, name -> id
+const std::map <std::string, int>&
+    device_types (void);
+
 bool
 is_epdu(int x);
 
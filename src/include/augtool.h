@@ -28,20 +28,40 @@
  * \brief Not yet documented file
  */
 #include <string>
+#include <map>
 #include <mutex>
+#include <utility>
 #include <functional>
 
 #include "subprocess.h"
 
 //! Simple class abstraction over augtool
+//!
+//! Output of read-only commands (get, ls, match, print) is cached and served
+//! without talking to the subprocess. Cache is dropped whenever the tree gets
+//! modified or when any of the files backing the tree changes on disk.
 class augtool {
 protected:
-    //! Shared mutex
+    //! Modification time of a watched file, {-1, -1} if it does not exist
+    typedef std::pair<long, long> mtime_t;
+    //! Shared mutex, guards everything below
     std::mutex mux;
     //! Subprocess itself
     shared::SubProcess *prc;
-    //! Ensures we are in reasonably clean state
+    //! Output of read-only commands since the last load
+    std::map<std::string, std::string> cache;
+    //! Modification times of watched files at the time of the last load
+    std::map<std::string, mtime_t> mtimes;
+    //! Tree was modified since the last load
+    bool dirty;
+    //! Ensures we are in reasonably clean state, reloads tree only if needed
     void clear();
+    //! Talks to the subprocess, expects mux to be locked
+    std::string exec(std::string cmd);
+    //! Current modification times of watched files
+    static std::map<std::string, mtime_t> snapshot();
+    //! Whether the output of the command depends only on the tree content
+    static bool is_read_only(const std::string& cmd);
 public:
     //! Singleton get_instance method
     static augtool* get_instance();
@@ -49,6 +49,9 @@ Example:
 extern "C" {
 #include <libcidr.h>
 }
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 #include <iostream>
@@ -402,6 +405,8 @@ public:
   int compare(const CIDRAddress& a2) const;
   ~CIDRAddress();
 private:
+  friend class CIDRList;
+
   // private pointer to libcidr structure
   CIDR *_cidr;
 
@@ -418,6 +423,8 @@ private:
  */
 std::ostream& operator<<(std::ostream& os, const CIDRAddress& address);
 
+class CIDRPart;
+
 /**
  * \class CIDRList
  *
@@ -430,6 +437,11 @@ std::ostream& operator<<(std::ostream& os, const CIDRAddress& address);
  * Exclude/include evaluation uses prefix for prioritization the same way
  * as routing does - longer prefix win. In case of equality exclude win.
  *
+ * Networks are CIDR blocks, so two of them are either nested or disjoint.
+ * Every add() and exclude() resolves the networks into a sorted list of
+ * address ranges to walk trough, next() then costs O(1) and includes()
+ * and excludes() O(log n).
+ *
  *     CIDRList list;
  *     list.add("1.2.3.0/24");
  *     list.exclude("1.2.0.0/16"); //this will hide nothing (smaller prefix)
@@ -494,7 +506,9 @@ public:
    *     }
    *
    *
-   * in the future we need some clever mechanism for IPv6.
+   * IPv6 networks are walked after IPv4 ones. They have no broadcast,
+   * only the subnet-router anycast address (the network address) is
+   * filtered for prefixes shorter than 127.
    */
   bool next(CIDRAddress& address);
 
@@ -537,20 +551,164 @@ public:
    * \brief Simple evaluation if address is in excluded networks.
    */
   bool excludes(const CIDRAddress& address) const;
+
+  /**
+   * \brief Number of addresses next() walks trough, UINT64_MAX if more.
+   */
+  uint64_t size() const;
+
+  /**
+   * \brief Split addresses walked by next() into parts.
+   * \param number of parts
+   * \return at most parts CIDRPart objects, fewer if there is less addresses
+   *
+   * Parts are disjoint, in order and their sizes differ by one at most.
+   * Walking them one after another gives the same addresses as walking
+   * the list. Parts do not change when the list changes. Only the first
+   * UINT64_MAX addresses are balanced, the last part takes the rest.
+   */
+  std::vector<CIDRPart> split(size_t parts) const;
 private:
+  friend class CIDRPart;
+  friend class CIDRWalker;
+
+  // address as a number, IPv4 sorts before IPv6
+  struct Key {
+    uint8_t proto;
+    uint64_t hi;
+    uint64_t lo;
+
+    bool operator<(const Key& k) const;
+    bool operator==(const Key& k) const;
+    // following and previous address, past the highest one sorts after
+    // all addresses of the protocol
+    Key succ() const;
+    Key pred() const;
+    // address n positions further, must not overflow
+    Key plus(uint64_t n) const;
+  };
+
+  // inclusive range of addresses
+  struct Range {
+    Key first;
+    Key last;
+  };
+
   // list of includes
   std::vector<CIDRAddress> _networks;
   // list of excludes
   std::vector<CIDRAddress> _excludedNetworks;
-  // highest address from list
-  CIDRAddress _last;
-
-  // skipping gaps between networks
-  void _skipToNextPool(CIDRAddress& address) const;
-  // skipping to the end of exclude or to beginning of next include
-  void _skipToExcludeEnd(CIDRAddress& address) const;
-  // simple increment address of 1 eventually go at the beginning
-  bool _nextSimple(CIDRAddress& address);
+  // addresses walked by next(), sorted and merged
+  std::vector<Range> _ranges;
+  // outermost includes and excludes, sorted and disjoint
+  std::vector<Range> _includeBlocks;
+  std::vector<Range> _excludeBlocks;
+  // range and address returned by last next(), saves the search
+  size_t _cursor;
+  Key _cursorKey;
+
+  // recompute ranges and blocks from networks
+  void _rebuild();
+  // host part of address
+  static Key _key(const CIDRAddress& address);
+  // all addresses of network
+  static Range _block(const CIDRAddress& net);
+  static void _setAddress(CIDRAddress& address, const Key& key);
+  // some of sorted outermost blocks contains address
+  static bool _contains(const std::vector<Range>& blocks, const CIDRAddress& address);
+  // number of addresses in range, UINT64_MAX if more
+  static uint64_t _size(const Range& range);
+  static uint64_t _size(const std::vector<Range>& ranges, size_t begin);
+  // next() over ranges, cursor and cursorKey are next() state
+  static bool _walk(const std::vector<Range>& ranges, size_t& cursor, Key& cursorKey, CIDRAddress& address);
+  // leave first keep addresses from ranges[begin] on in ranges, move the rest to rest
+  static void _cut(std::vector<Range>& ranges, size_t begin, uint64_t keep, std::vector<Range>& rest);
+};
+
+/**
+ * \class CIDRPart
+ *
+ * \brief Part of addresses of CIDRList, see CIDRList::split()
+ *
+ * Network addresses, broadcasts and excludes are already filtered out,
+ * next() walks trough the part the same way CIDRList::next() does.
+ */
+class CIDRPart {
+public:
+  CIDRPart();
+
+  /**
+   * \brief Set address to next in part.
+   * \see CIDRList::next()
+   */
+  bool next(CIDRAddress& address);
+
+  /**
+   * \brief Number of addresses in part, UINT64_MAX if more.
+   */
+  uint64_t size() const;
+
+  /**
+   * \brief First and last address walked trough, invalid for empty part.
+   */
+  CIDRAddress firstAddress() const;
+  CIDRAddress lastAddress() const;
+private:
+  friend class CIDRList;
+  friend class CIDRWalker;
+
+  std::vector<CIDRList::Range> _ranges;
+  size_t _cursor;
+  CIDRList::Key _cursorKey;
+};
+
+/**
+ * \class CIDRWalker
+ *
+ * \brief Walks trough addresses of CIDRList from several threads
+ *
+ * Every worker gets one part of the list (see CIDRList::split()). Worker
+ * done with its part takes the second half of what is left from the
+ * worker with most addresses left, so all of them run until the very end
+ * even if probing some addresses takes much longer than others.
+ *
+ *     CIDRWalker walker(list, 4);
+ *     // in thread i = 0..3
+ *     CIDRAddress addr;
+ *     while( walker.next(i, addr) ) {
+ *         probe(addr);
+ *     }
+ *
+ * Every address of the list is returned exactly once, each worker gets
+ * its addresses in ascending order. The walker is a snapshot, changes of
+ * the list later on are not seen.
+ */
+class CIDRWalker {
+public:
+  /**
+   * \brief Creates walker for workers 0 .. workers - 1
+   */
+  CIDRWalker(const CIDRList& list, size_t workers);
+
+  /**
+   * \brief Set address to next one for worker
+   * \param worker index, every worker calls next() from one thread only
+   * \param address is set to next address or invalidated
+   * \return false if there is nothing left for anybody
+   */
+  bool next(size_t worker, CIDRAddress& address);
+
+  size_t workers() const { return _slots.size(); }
+private:
+  struct Slot {
+    std::mutex mux;
+    // addresses left are in ranges from begin on
+    std::vector<CIDRList::Range> ranges;
+    size_t begin;
+    // number of addresses left, UINT64_MAX if more
+    uint64_t left;
+  };
+  std::vector<std::unique_ptr<Slot>> _slots;
 };
 
 
@@ -0,0 +1,106 @@
+/*
+Copyright (C) 2015 Eaton
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*! \file   config_store.h
+    \brief  ZPL configuration files kept in memory for /config
+ */
+
+#ifndef SRC_SHARED_CONFIG_STORE_H_
+#define SRC_SHARED_CONFIG_STORE_H_
+
+#include <czmq.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cxxtools/serializationinfo.h>
+
+namespace utils {
+namespace config {
+
+/*!
+ * \brief Configuration files behind /config, parsed once
+ *
+ * Every file (see get_path ()) is loaded on first use and lookups are
+ * served from the parsed tree. Directories of loaded files are watched
+ * with inotify, a file changed by somebody else (agents, augtool, admin
+ * with vi) is loaded again on next lookup. Without inotify every lookup
+ * loads the file like before.
+ *
+ * put () applies all keys of a request to the trees and writes every
+ * touched file once, to a temporary file renamed over the old one, so
+ * readers never see half written configuration.
+ */
+class ConfigStore {
+    public:
+        //\brief all files are under root, for tests
+        explicit ConfigStore (const std::string& root = "");
+        ~ConfigStore ();
+
+        ConfigStore (const ConfigStore& other) = delete;
+        ConfigStore& operator=(const ConfigStore& other) = delete;
+
+        /*!
+         \brief Value of key (with get_mapping () applied)
+
+         \param [out] value - value of the item
+         \param [out] array - non empty values of children, if any
+         \return false if the file or the item does not exist
+        */
+        bool get (const std::string& key, std::string& value, std::vector <std::string>& array);
+
+        /*!
+         \brief Apply json document of PUT/POST /config and save touched files
+
+         \throws BiosError on bad document (nothing is changed then) or on
+                 failed write (files written before stay written)
+        */
+        void put (const cxxtools::SerializationInfo& si);
+
+        //\brief number of file loads so far
+        size_t loads () const;
+
+    private:
+        struct file_t {
+            zconfig_t *root;
+            bool stale;
+        };
+
+        zconfig_t *load (const std::string& path);
+        void save (const std::string& path, zconfig_t *root);
+        bool watch (const std::string& path);
+        void read_events ();
+        void drop (const std::string& path);
+
+        std::string _root;
+
+        mutable std::mutex _mux;
+        std::map <std::string, file_t> _files;
+        int _inotify;                           // -1 before first load or if not available
+        bool _inotify_failed;
+        std::map <int, std::string> _watches;   // watch descriptor -> directory
+        size_t _loads;
+};
+
+//\brief store of /config
+extern ConfigStore config_store;
+
+} // namespace utils::config
+} // namespace utils
+
+#endif // SRC_SHARED_CONFIG_STORE_H_
@@ -30,6 +30,7 @@
 #include <string>
 #include "utils_web.h"
 #include <tnt/httprequest.h>
+#include <tnt/httpreply.h>
 
 /*!
  \brief BiosProfile enum - defines levels of permissions
@@ -179,6 +180,66 @@ bool check_alert_just_rule_part (const std::string& param_name, const std::strin
 */
 bool check_asset_name (const std::string& param_name, const std::string& name, http_errors_t &errors);
 
+struct asset_filter_t;
+
+/*!
+ \brief Check filter and page parameters of asset listings
+
+ All of them are optional:
+    status    - active, nonactive, spare or retired
+    priority  - P1 .. P5
+    ext_key   - only assets having this ext attribute
+    ext_value - ... with this value (requires ext_key)
+    after     - cursor of the previous page, X-Next-After header of its
+                reply (numeric asset id); for compatibility, identifier of
+                an existing asset is accepted too
+    limit     - maximum number of assets in the reply
+
+ A numeric cursor is a position, it stays valid when the asset it comes
+ from is deleted.
+
+ \param[in]     qparam          query parameters of the request
+ \param[out]    filter          filter to be filled
+ \param[out]    errors          errors structure for storing conversion errors
+ \return
+    true on success
+    false on failure, errors are updated (exactly one item is added to structure)
+*/
+bool
+check_asset_filter (const tnt::QueryParams& qparam, asset_filter_t& filter, http_errors_t& errors);
+
+/*!
+  \brief macro for typical usage of check_asset_filter. Webserver dies with bad-param if
+         the check fails
+*/
+#define check_asset_filter_or_die(qparam, filter) \
+{  \
+    http_errors_t errors; \
+    if (! check_asset_filter (qparam, filter, errors)) { \
+        http_die_error (errors); \
+    } \
+}
+
+/*!
+ \brief Compare ETag of the current representation with If-None-Match
+        of the request
+
+ Call it once the request is known to be valid ("*" matches any existing
+ representation). On success the caller sets the ETag header itself, error
+ replies and representations which are never the same (realtime data)
+ have no ETag.
+
+ \param[in]     request         http request
+ \param[out]    reply           http reply, gets the ETag header on a match
+ \param[in]     etag            quoted entity tag of the current representation
+ \return
+    true if the client already has the current representation, the caller
+         should return HTTP_NOT_MODIFIED without a body
+    false otherwise
+*/
+bool
+check_etag (const tnt::HttpRequest& request, tnt::HttpReply& reply, const std::string& etag);
+
 /*!
  * \brief Check user permissions
  *
@@ -218,7 +279,7 @@ void check_user_permissions (
     do { \
         http_errors_t errors; \
         std::string __http_die__debug__ {""}; \
-        if (::getenv ("BIOS_LOG_LEVEL") && !strcmp (::getenv ("BIOS_LOG_LEVEL"), "LOG_DEBUG")) { \
+        if (_die_debug ()) { \
             __http_die__debug__ = {__FILE__}; \
             __http_die__debug__ += ": " + std::to_string (__LINE__); \
         } \
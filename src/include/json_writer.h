@@ -0,0 +1,126 @@
+/*
+Copyright (C) 2015 Eaton
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*! \file   json_writer.h
+    \brief  JSON written directly to a stream
+ */
+
+#ifndef SRC_SHARED_JSON_WRITER_H_
+#define SRC_SHARED_JSON_WRITER_H_
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace utils {
+namespace json {
+
+/*!
+ \brief Write string escaped the same way as escape () does, without
+        a temporary string
+*/
+void escape (std::ostream& out, const char *string, size_t length);
+
+inline void escape (std::ostream& out, const std::string& string) {
+    escape (out, string.data (), string.size ());
+}
+
+/*!
+ * \brief Streaming JSON writer
+ *
+ * Values are written to the stream (reply.out () of a page) as they come,
+ * strings are escaped straight into it. Memory used does not depend on
+ * the size of the document, only on the depth of nesting. Separators are
+ * written by the writer:
+ *
+ *   utils::json::JsonWriter json (reply.out ());
+ *   json.begin_array ();
+ *   for (...)
+ *       json.begin_object ()
+ *           .member ("id", name)
+ *           .member ("size", size)
+ *           .end_object ();
+ *   json.end_array ();
+ *
+ * The output is compact, the caller is responsible for a well formed
+ * sequence of calls.
+ */
+class JsonWriter {
+    public:
+        explicit JsonWriter (std::ostream& out);
+
+        JsonWriter (const JsonWriter& other) = delete;
+        JsonWriter& operator=(const JsonWriter& other) = delete;
+
+        JsonWriter& begin_object ();
+        JsonWriter& end_object ();
+        JsonWriter& begin_array ();
+        JsonWriter& end_array ();
+
+        //\brief name of the next member of the current object
+        JsonWriter& key (const char *name, size_t length);
+        JsonWriter& key (const char *name);
+        JsonWriter& key (const std::string& name) { return key (name.data (), name.size ()); }
+
+        JsonWriter& value (const char *string, size_t length);
+        //\brief null for nullptr
+        JsonWriter& value (const char *string);
+        JsonWriter& value (const std::string& string) { return value (string.data (), string.size ()); }
+        //\brief null for NaN and infinity
+        JsonWriter& value (double number);
+        JsonWriter& value (bool boolean);
+
+        template <typename T
+                , typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type* = nullptr>
+        JsonWriter& value (T number) {
+            separate ();
+            // char types would be written as characters
+            if (sizeof (T) == 1)
+                _out << static_cast<int> (number);
+            else
+                _out << number;
+            return *this;
+        }
+
+        JsonWriter& null ();
+
+        //\brief already serialized json value
+        JsonWriter& raw (const std::string& json);
+
+        template <typename S, typename T>
+        JsonWriter& member (const S& name, const T& value) {
+            return key (name).value (value);
+        }
+
+        //\brief number of containers not ended yet
+        size_t depth () const { return _first.size (); }
+
+    private:
+        void separate ();
+
+        std::ostream& _out;
+        std::vector<bool> _first;   // per open container, nothing written into it yet
+        bool _after_key;
+};
+
+} // namespace utils::json
+} // namespace utils
+
+#endif // SRC_SHARED_JSON_WRITER_H_
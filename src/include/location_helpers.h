@@ -28,8 +28,13 @@
 #define SRC_WEB_INCLUDE_LOCATION_HELPERS
 
 #include <string>
-#include "asset_msg.h"
+#include "assettopology.h"
 
-int asset_location_r(asset_msg_t** asset_msg, std::string& json);
+/**
+ * \brief Appends the JSON of the element at index and its subtree
+ *
+ * \return HTTP_OK
+ */
+int asset_location_r(const location_topology_t& topology, std::string& json, size_t index = 0);
 
 #endif // SRC_WEB_INCLUDE_LOCATION_HELPERS
@@ -67,6 +67,18 @@ extern "C" {
 
 #define LOG_NOOP LOG_EMERG -1
 
+/*! \def LOG_COMPILE_LEVEL
+ *  Messages less important than this level are removed at compile time, so
+ *  they cost nothing, not even a level check. Defaults to LOG_DEBUG (keep
+ *  everything), see --with-log-compile-level configure option. */
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_DEBUG
+#endif
+
+/*! \brief the least important level enabled globally or for any module
+ *  An internal variable for the fast path of log macros, don't touch! */
+extern int log_max_level;
+
 /*! \brief open log
  *
  * Function initialize logging system - it can react on BIOS_LOG_LEVEL environment and setup log level accordingly.
@@ -90,12 +102,57 @@ void log_set_level(int level);
 /*! \brief get the maximum stderr level */
 int log_get_level();
 
+/*! \brief set the maximum log level for one source module
+ *
+ * Module is the basename of the source file without extension, e.g.
+ * "importcsv" for src/db/inout/importcsv.cc. The module level overrides
+ * the global one in both directions. BIOS_LOG_MODULES environment variable
+ * read by \ref log_open has the form "importcsv:LOG_DEBUG,data:LOG_INFO".
+ *
+ * \return 0 on success, -1 if there are too many modules configured
+ * */
+int log_set_module_level(const char *module, int level);
+
+/*! \brief get the effective maximum log level for one source module */
+int log_get_module_level(const char *module);
+
+/*! \brief return non-zero if message of given level issued in file is printed
+ *  An internal function, used by log macros to skip argument evaluation */
+int log_module_enabled(int level, const char *file);
+
+static inline int log_is_enabled(int level, const char *file) {
+    if (level > log_max_level)
+        return 0;
+    return log_module_enabled(level, file);
+}
+
 /*! \brief get the stderr FILE* */
 FILE *log_get_file();
 
 /*! \brief set the stderr FILE* */
 void log_set_file(FILE* file);
 
+/*! \brief switch to asynchronous logging
+ *
+ * Messages are then formatted by the calling thread directly into a
+ * preallocated lock-free ring buffer and written out in batches by a
+ * background thread. When the ring buffer is full, messages are dropped
+ * and counted, see \ref log_get_dropped. log_open() calls this when
+ * BIOS_LOG_ASYNC environment variable is set to "yes".
+ *
+ * \return 0 on success, -1 if writer thread can't be started
+ * */
+int log_async_start();
+
+/*! \brief write out pending messages and return to synchronous logging
+ *
+ * Messages logged by other threads meanwhile are written synchronously.
+ * */
+void log_async_stop();
+
+/*! \brief get the number of messages dropped by asynchronous logging */
+uint64_t log_get_dropped();
+
 /*! \brief do logging
     An internal logging function, use specific log_error, log_debug  macros!
     \param level - level for message, see \ref log_get_level for legal values
@@ -112,9 +169,11 @@ int do_log(
         const char* format,
         ...) __attribute__ ((format (printf, 5, 6)));
 
+/* Arguments are evaluated only if the message is going to be printed */
 #define log_macro(level, ...) \
     do { \
-        do_log((level), __FILE__, __LINE__, __func__, __VA_ARGS__); \
+        if ((level) <= LOG_COMPILE_LEVEL && log_is_enabled((level), __FILE__)) \
+            do_log((level), __FILE__, __LINE__, __func__, __VA_ARGS__); \
     } while(0)
 
 /*! \def log_debug(format, ...)
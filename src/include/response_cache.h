@@ -0,0 +1,158 @@
+/*
+Copyright (C) 2015 Eaton
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+/*! \file   response_cache.h
+    \brief  Bounded LRU cache of rendered REST responses
+ */
+
+#ifndef SRC_SHARED_RESPONSE_CACHE_H_
+#define SRC_SHARED_RESPONSE_CACHE_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+/*!
+ * \brief Cache of serialized responses, shared by all tntnet worker threads
+ *
+ * Every entry belongs to a generation of the data it was rendered from
+ * (see persist::asset_generation ()). A lookup with a newer generation drops
+ * all older entries, a lookup with an older generation is never served
+ * nor stored. Only one thread renders a missing entry, others asking for
+ * the same key wait for it:
+ *
+ *   ResponseCache::Ticket ticket = topology_cache.acquire (key, generation);
+ *   if (ticket.hit ()) {
+ *       reply.out () << ticket.value ();
+ *       return HTTP_OK;
+ *   }
+ *   ... render json, http_die on errors ...
+ *   reply.out () << ticket.fill (std::move (json));
+ *
+ * A ticket destroyed without fill () (http_die returned early) wakes
+ * the waiters up, one of them renders the response then.
+ *
+ * The generation only counts changes made by this process. Time is cut
+ * into periods of max_age of the steady clock and entries stored in an
+ * older period are rendered again, so changes of other processes (bios-csv
+ * import, agents writing to the database) show up at the latest after
+ * max_age. With the default max_age the periods are those of
+ * persist::asset_period (), so a response is never older than the period
+ * of the ETag it is served with.
+ */
+class ResponseCache {
+    public:
+        typedef std::shared_ptr<const std::string> Value;
+
+        struct Stats {
+            uint64_t hits;
+            uint64_t misses;
+            uint64_t waits;         // lookups which waited for another thread
+            uint64_t evictions;
+            uint64_t expirations;   // entries dropped because of their age
+            size_t entries;
+            size_t bytes;
+
+            double hit_rate () const {
+                return hits + misses == 0 ? 0.0 : (double) hits / (hits + misses);
+            }
+        };
+
+        class Ticket {
+            public:
+                Ticket (Ticket&& other);
+                Ticket (const Ticket& other) = delete;
+                Ticket& operator=(const Ticket& other) = delete;
+                ~Ticket ();
+
+                //\brief true if value () is the cached response
+                bool hit () const { return _value != nullptr; }
+
+                const std::string& value () const { return *_value; }
+
+                //\brief stores the rendered response (if still current), returns it
+                const std::string& fill (std::string&& response);
+
+            private:
+                friend class ResponseCache;
+                Ticket (ResponseCache *cache, const std::string& key, uint64_t generation, Value value);
+
+                ResponseCache *_cache;  // nullptr when nothing to release
+                std::string _key;
+                uint64_t _generation;
+                Value _value;
+        };
+
+        explicit ResponseCache (size_t max_entries = 128, size_t max_bytes = 32 * 1024 * 1024,
+                                std::chrono::steady_clock::duration max_age = std::chrono::seconds (60));
+
+        ResponseCache (const ResponseCache& other) = delete;
+        ResponseCache& operator=(const ResponseCache& other) = delete;
+
+        //\brief cached response or a ticket to render it, blocks while another thread renders key
+        Ticket acquire (const std::string& key, uint64_t generation);
+
+        Stats stats () const;
+
+        void clear ();
+
+    private:
+        struct entry_t {
+            Value value;
+            std::list<std::string>::iterator lru;
+            std::chrono::steady_clock::time_point stored;
+        };
+
+        void store (const std::string& key, uint64_t generation, Value value);
+        void release (const std::string& key, uint64_t generation);
+        void evict ();
+
+        size_t _max_entries;
+        size_t _max_bytes;
+        std::chrono::steady_clock::duration _max_age;
+
+        mutable std::mutex _mux;
+        std::condition_variable _cond;
+        uint64_t _generation;
+        std::unordered_map<std::string, entry_t> _entries;
+        std::list<std::string> _lru;    // most recently used first
+        std::set<std::string> _pending;
+        Stats _stats;
+};
+
+/*!
+ \brief Cache key of an endpoint, the order of parameters does not matter
+
+ \param[in]     endpoint    name of the endpoint
+ \param[in]     params      checked (normalized) parameters of the request
+ \return "endpoint?name1=value1&name2=value2"
+*/
+std::string
+response_cache_key (const std::string& endpoint, const std::map<std::string, std::string>& params);
+
+//\brief cache of /topology/location and /topology/power responses
+extern ResponseCache topology_cache;
+
+#endif // SRC_SHARED_RESPONSE_CACHE_H_
@@ -35,6 +35,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <string>
 #include <sstream>
 #include <map>
+#include <functional>
 
 /* \brief Helper classes for managing processes
  *
@@ -64,6 +65,9 @@ namespace shared {
 //! \brief list of arguments
 typedef std::vector<std::string> Argv;
 
+//! \brief consumer of a chunk of process output
+typedef std::function<void(const char* data, size_t size)> OutputCallback;
+
 class SubProcess {
     public:
 
@@ -196,10 +200,10 @@ int call(const Argv& args);
 // @param o reference to variable will contain stdout
 // @param e reference to variable will contain stderr
 // @param timeout - maximum timeout in seconds (0 means wait forewer)
-// @param timestep - how often to pool buffer for subproces output (msecs)
+// @param timestep - how often to check the process if the kernel can't notify us about its exit (msecs)
 // @return see \SubProcess.wait for meaning
 //
-// \warning use internal reactor, so it regularly reads from stdout and stderr
+// On timeout the process gets SIGTERM and SIGKILL if it does not exit within 2 seconds.
 int output(const Argv& args, std::string& o, std::string& e, uint64_t timeout = 0, size_t timestep = 500);
 
 // \brief Run command with arguments and return just stdout (no stderr) as a string.
@@ -212,10 +216,8 @@ int output2(const Argv& args, std::string& o, uint64_t timeout = 0, size_t times
 // @param e reference to variable will contain stderr
 // @param i const reference to variable will contain stdin
 // @param timeout - maximum timeout in seconds (0 means wait forewer)
-// @param timestep - how often to pool buffer for subproces output (msecs)
+// @param timestep - how often to check the process if the kernel can't notify us about its exit (msecs)
 // @return see \SubProcess.wait for meaning
-//
-// \warning use internal reactor, so it regularly reads from stdout and stderr
 int
 output(
     const Argv& args,
@@ -223,6 +225,15 @@ output(
     std::string& e,
     const std::string& i, uint64_t timeout = 0, size_t timestep = 500);
 
+// \brief Run command with arguments and pass its stdout to callback as it arrives.
+//
+// @param args list of command line arguments
+// @param out_cb called for every chunk of stdout, from the calling thread
+// @param e reference to variable will contain stderr
+// @param timeout - maximum timeout in seconds (0 means wait forewer)
+// @return see \SubProcess.wait for meaning
+int output_stream(const Argv& args, const OutputCallback& out_cb, std::string& e, uint64_t timeout = 0);
+
 } //namespace shared
 
 #endif //_SRC_SHARED_SUBPROCESS_H
@@ -39,6 +39,11 @@
 #include <stdarg.h>
 #include <cmath>
 #include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <type_traits>
 #include <cxxtools/serializationinfo.h>
 #include "log.h"
 #include "utils++.h"
@@ -67,8 +72,7 @@ typedef std::array<_WSError, _WSErrorsCOUNT> _WSErrors;
 //
 // TL;DR;
 // The .messages are supposed to be called with FEWER formatting arguments than defined.
-// To avoid issues with going to unallocated memory, the _die_asprintf is called with
-// **5** additional empty strings, which fill sefgaults for other formatting specifiers.
+// _die_format replaces every %s missing an argument with an empty string.
 
 #define HTTP_TEAPOT 418 //see RFC2324
 static constexpr const _WSErrors _errors = { {
@@ -104,28 +108,68 @@ _die_idx<1>(const char* key)
     return (_errors.at(1).key == key || _errors.at(1).message == key) ? 1: 0;
 }
 
-static int
-_die_asprintf(
-        char **buf,
-        const char* format,
-        ...) __attribute__ ((format (printf, 2, 3))) __attribute__ ((__unused__));
-
-static int
-_die_asprintf(
-        char **buf,
-        const char* format,
-        ...)
+// format argument of .message, a string, a const char* or an integer
+struct _WSErrorArg {
+    const char *data;       // nullptr for an integer, its digits are in number
+    size_t size;
+    char number [24];
+
+    const char *text () const { return data ? data : number; }
+};
+
+inline _WSErrorArg
+_die_arg (const char *string)
 {
-    int r;
-    int saved_errno = errno;
-    va_list args;
+    // what printf writes for NULL
+    return string ? _WSErrorArg {string, strlen (string), {}} : _WSErrorArg {"(null)", 6, {}};
+}
+
+inline _WSErrorArg
+_die_arg (const std::string& string)
+{
+    return _WSErrorArg {string.data (), string.size (), {}};
+}
 
-    va_start(args, format);
-    r = vasprintf(buf, format, args);
-    va_end(args);
+template <typename T
+    , typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type* = nullptr>
+inline _WSErrorArg
+_die_arg (T number)
+{
+    _WSErrorArg arg {nullptr, 0, {}};
+    arg.size = snprintf (arg.number, sizeof (arg.number), "%jd", (intmax_t) number);
+    return arg;
+}
 
-    errno = saved_errno;
-    return r;
+template <typename T
+    , typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type* = nullptr>
+inline _WSErrorArg
+_die_arg (T number)
+{
+    _WSErrorArg arg {nullptr, 0, {}};
+    arg.size = snprintf (arg.number, sizeof (arg.number), "%ju", (uintmax_t) number);
+    return arg;
+}
+
+// .message of _errors [idx] with every %s replaced by the next of args,
+// by "" if there are fewer args; in one allocation, the .messages are split
+// at %s once
+std::string
+_die_format_args (size_t idx, const _WSErrorArg *args, size_t count);
+
+template <typename... Args>
+std::string
+_die_format (size_t idx, const Args&... args)
+{
+    const _WSErrorArg list [] = {_die_arg (args)..., _die_arg ("")};
+    return _die_format_args (idx, list, sizeof... (Args));
+}
+
+// error responses carry file and line for BIOS_LOG_LEVEL=LOG_DEBUG
+inline bool
+_die_debug ()
+{
+    const char *level = ::getenv ("BIOS_LOG_LEVEL");
+    return level && !strcmp (level, "LOG_DEBUG");
 }
 
 //  ###### THOSE DEFINITONS ABOVE ARE PRIVATE TO http_die AND SHALL NOT BE ACCESSED DIRECTLY
@@ -168,16 +212,14 @@ _die_asprintf(
     do { \
         constexpr size_t __http_die__key_idx__ = _die_idx<_WSErrorsCOUNT-1>((const char*)key); \
         static_assert(__http_die__key_idx__ != 0, "Can't find '" key "' in list of error messages. Either add new one either fix the typo in key"); \
-        char *__http_die__error_message__ = NULL; \
-        _die_asprintf(&__http_die__error_message__, _errors.at(__http_die__key_idx__).message, ##__VA_ARGS__, "", "", "", "", "" ); \
-        if (::getenv ("BIOS_LOG_LEVEL") && !strcmp (::getenv ("BIOS_LOG_LEVEL"), "LOG_DEBUG")) { \
+        std::string __http_die__error_message__ = _die_format (__http_die__key_idx__, ##__VA_ARGS__); \
+        if (_die_debug ()) { \
             std::string __http_die__debug__ = {__FILE__}; \
             __http_die__debug__ += ": " + std::to_string (__LINE__); \
             reply.out() << utils::json::create_error_json(__http_die__error_message__, _errors.at(__http_die__key_idx__).err_code, __http_die__debug__); \
         } \
         else \
             reply.out() << utils::json::create_error_json(__http_die__error_message__, _errors.at(__http_die__key_idx__).err_code); \
-        free(__http_die__error_message__); \
         http_die_contenttype(reply); \
         return _errors.at(__http_die__key_idx__).http_code;\
     } \
@@ -203,7 +245,7 @@ do { \
     if (_idx < 0) _idx = _idx * -1; \
     if (_idx >= (int64_t)_WSErrorsCOUNT) _idx = 0; \
     if (_idx == 0) log_error("TEAPOT");\
-    if (::getenv ("BIOS_LOG_LEVEL") && !strcmp (::getenv ("BIOS_LOG_LEVEL"), "LOG_DEBUG")) { \
+    if (_die_debug ()) { \
         std::string __http_die__debug__ = {__FILE__}; \
         __http_die__debug__ += ": " + std::to_string (__LINE__); \
         reply.out() << utils::json::create_error_json(msg, _errors.at(_idx).err_code, __http_die__debug__);\
@@ -226,10 +268,7 @@ do { \
     constexpr size_t __http_die__key_idx__ = _die_idx<_WSErrorsCOUNT-1>((const char*)key); \
     static_assert(__http_die__key_idx__ != 0, "Can't find '" key "' in list of error messages. Either add new one either fix the typo in key"); \
     (errors).http_code = _errors.at (__http_die__key_idx__).http_code; \
-    char *__http_die__error_message__ = NULL; \
-    _die_asprintf(&__http_die__error_message__, _errors.at(__http_die__key_idx__).message, ##__VA_ARGS__, "", "", "", "", "" ); \
-    (errors).errors.push_back (std::make_tuple (_errors.at (__http_die__key_idx__).err_code, __http_die__error_message__, (debug))); \
-    free (__http_die__error_message__); \
+    (errors).errors.emplace_back (_errors.at (__http_die__key_idx__).err_code, _die_format (__http_die__key_idx__, ##__VA_ARGS__), (debug)); \
 } \
 while (0)
 
@@ -310,11 +349,8 @@ do { \
     static_assert (std::is_same <decltype (str), std::string>::value || std::is_same <decltype (str), std::string&>::value, "'str' argument in macro bios_error_idx must be a std::string."); \
     constexpr size_t __http_die__key_idx__ = _die_idx<_WSErrorsCOUNT-1>((const char*)key); \
     static_assert(__http_die__key_idx__ != 0, "Can't find '" key "' in list of error messages. Either add new one either fix the typo in key"); \
-    char *__http_die__error_message__ = NULL; \
-    _die_asprintf(&__http_die__error_message__, _errors.at(__http_die__key_idx__).message, ##__VA_ARGS__, "", "", "", "", "" ); \
-    str = __http_die__error_message__; \
+    str = _die_format (__http_die__key_idx__, ##__VA_ARGS__); \
     idx = __http_die__key_idx__; \
-    free (__http_die__error_message__); \
 } \
 while (0)
 
@@ -333,10 +369,7 @@ while (0)
     do { \
         constexpr size_t __http_die__key_idx__ = _die_idx<_WSErrorsCOUNT-1>((const char*)key); \
         static_assert(__http_die__key_idx__ != 0, "Can't find '" key "' in list of error messages. Either add new one either fix the typo in key"); \
-        char *__http_die__error_message__ = NULL; \
-        _die_asprintf(&__http_die__error_message__, _errors.at(__http_die__key_idx__).message, ##__VA_ARGS__, "", "", "", "", "" ); \
-        std::string str{__http_die__error_message__}; \
-        free(__http_die__error_message__); \
+        std::string str = _die_format (__http_die__key_idx__, ##__VA_ARGS__); \
         log_warning("throw BiosError{%zu, \"%s\"}", __http_die__key_idx__, str.c_str());\
         throw BiosError{__http_die__key_idx__, str}; \
     } while (0);
@@ -389,6 +422,17 @@ std::string escape (const char *string);
 */
 std::string escape (const std::string& before);
 
+/*!
+ \brief Length of the longest prefix of string which escape () copies as is
+*/
+size_t escape_span (const char *string, size_t length);
+
+/*!
+ \brief What escape () writes instead of byte c
+ \return nullptr if c is copied as is
+*/
+const char *escape_replacement (unsigned char c, size_t& length);
+
 std::string jsonify (double t);
 
 template <typename T
@@ -40,6 +40,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "asset_types.h"
 #include "cleanup.h"
 #include "db/assets.h"
+#include "db/asset_closure.h"
 
 
 
@@ -390,29 +391,21 @@ db_reply <std::set <std::pair<a_elmnt_id_t ,a_elmnt_id_t>>>
     try{
         // v_bios_asset_link are only devices,
         // so there is no need to add more constrains
+        // power links are few compared to the assets, so select all of
+        // them and keep those touching the container via the closure
+        persist::AssetClosurePtr closure = persist::asset_closure (conn);
         tntdb::Statement st = conn.prepareCached(
             " SELECT"
             "   v.id_asset_element_src,"
             "   v.id_asset_element_dest"
             " FROM"
-            "   v_bios_asset_link v,"
-            "   v_bios_asset_element_super_parent v1,"
-            "   v_bios_asset_element_super_parent v2"
+            "   v_bios_asset_link v"
             " WHERE"
-            "   v.id_asset_link_type = :linktypeid AND"
-            "   v.id_asset_element_dest = v2.id_asset_element AND"
-            "   v.id_asset_element_src = v1.id_asset_element AND"
-            "   ("
-            "       ( :containerid IN (v2.id_parent1, v2.id_parent2 ,v2.id_parent3,"
-            "               v2.id_parent4, v2.id_parent5) ) OR"
-            "       ( :containerid IN (v1.id_parent1, v1.id_parent2 ,v1.id_parent3,"
-            "               v1.id_parent4, v1.id_parent5) )"
-            "   )"
+            "   v.id_asset_link_type = :linktypeid"
         );
 
         // can return more than one row
-        tntdb::Result result = st.set("containerid", element_id).
-                                  set("linktypeid", linktype).
+        tntdb::Result result = st.set("linktypeid", linktype).
                                   select();
         log_debug("[t_bios_asset_link]: were selected %" PRIu32 " rows",
                                                          result.size());
@@ -430,6 +423,10 @@ db_reply <std::set <std::pair<a_elmnt_id_t ,a_elmnt_id_t>>>
             row[1].get(id_asset_element_dest);
             assert ( id_asset_element_dest );
 
+            if ( !closure->is_under (id_asset_element_src, element_id) &&
+                 !closure->is_under (id_asset_element_dest, element_id) )
+                continue;
+
             ret.item.insert(std::pair<a_elmnt_id_t ,a_elmnt_id_t>(id_asset_element_src, id_asset_element_dest));
         } // end for
         ret.status = 1;
@@ -87,6 +87,9 @@ db_reply <std::vector<db_a_elmnt_t>>
 
 /**
  * \brief Selects all links, where at least one end is inside the container
+ *
+ * To find out which devices make up the total power of a container use
+ * persist::power_topology (conn)->contributors (container) instead.
  */
 db_reply <std::set <std::pair<a_elmnt_id_t ,a_elmnt_id_t>>>
     select_links_by_container
@@ -16,6 +16,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <set>
@@ -36,6 +37,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "assettopology.h"
 #include "persist_error.h"
 #include "cleanup.h"
+#include "db/asset_closure.h"
 
 // TODO HARDCODED CONSTANTS for asset device types
 
@@ -445,696 +447,430 @@ size_t my_size(zframe_t* frame)
         return zframe_size (frame);
 }
 
-zmsg_t* select_group_elements(
-            const char*     url             , a_elmnt_id_t    element_id, 
-            a_elmnt_tp_id_t element_type_id , const char*     group_name, 
-            const char*     dtype_name      , a_elmnt_tp_id_t filtertype
-        )
+// appends members of the group, ordered by type (datacenters first, devices last)
+static void
+s_location_group_members (
+    tntdb::Connection &conn,
+    location_topology_t &topology,
+    a_elmnt_id_t group_id,
+    a_elmnt_tp_id_t filtertype)
 {
-    assert ( element_id );  // id of the group should be specified
-    assert ( element_type_id ); // type_id of the group
-    assert ( ( filtertype >= persist::asset_type::GROUP ) && ( filtertype <= 7 ) ); 
-    // it can be only 1,2,3,4,5,6.7. 7 means - take all
-
-    log_info ("start");
-    log_debug ("element_id = %" PRIu32, element_id);
-    log_debug ("filter_type = %" PRIu16, filtertype);
- 
-    try{
-        tntdb::Connection conn = tntdb::connectCached(url); 
-        tntdb::Statement st = conn.prepareCached(
-                " SELECT"
-                "   v.id_asset_element,"
-                "   v1.name,"
-                "   v1.id_type AS id_asset_element_type,"
-                "   v3.name AS dtype_name,"
-                "   v2.name AS name_asset_element_type"
-                " FROM    t_bios_asset_group_relation v"
-                "   INNER JOIN t_bios_asset_element v1"
-                "       ON (v.id_asset_element = v1.id_asset_element )"
-                "   INNER JOIN t_bios_asset_element_type v2"
-                "       ON (v1.id_type = v2.id_asset_element_type)"
-                "   LEFT JOIN v_bios_asset_device v3"
-                "       ON v3.id_asset_element = v1.id_asset_element"
-                "       WHERE v.id_asset_group = :elementid"
-            );
-            
-        // Could return more than one row
-        tntdb::Result result = st.set("elementid", element_id).
-                                  select();
-        
-        log_debug("rows selected %u", result.size());
-        int i = 0;
-        int rv = 0;
-
-        _scoped_zmsg_t* dcss     = zmsg_new();
-        _scoped_zmsg_t* roomss   = zmsg_new();
-        _scoped_zmsg_t* rowss    = zmsg_new();
-        _scoped_zmsg_t* rackss   = zmsg_new();
-        _scoped_zmsg_t* devicess = zmsg_new();
+    tntdb::Statement st = conn.prepareCached(
+        " SELECT"
+        "   v.id_asset_element,"
+        "   v1.name,"
+        "   v1.id_type AS id_asset_element_type,"
+        "   v3.name AS dtype_name,"
+        "   ext.value AS ext_name"
+        " FROM    t_bios_asset_group_relation v"
+        "   INNER JOIN t_bios_asset_element v1"
+        "       ON (v.id_asset_element = v1.id_asset_element )"
+        "   LEFT JOIN v_bios_asset_device v3"
+        "       ON v3.id_asset_element = v1.id_asset_element"
+        "   LEFT JOIN t_bios_asset_ext_attributes ext"
+        "       ON (ext.id_asset_element = v1.id_asset_element AND ext.keytag = 'name')"
+        " WHERE v.id_asset_group = :elementid"
+    );
+    tntdb::Result result = st.set("elementid", group_id).select();
+    log_debug("rows selected %u", result.size());
 
-        for ( auto &row: result )
+    size_t first = topology.size ();
+    for ( auto &row: result )
+    {
+        location_node_t node {0, 0, "", "", "", 0};
+        row[0].get(node.id);
+        row[1].get(node.name);
+        row[2].get(node.type_id);
+        row[3].get(node.dtype_name);
+        row[4].get(node.ext_name);
+
+        // group of groups is not allowed
+        if ( node.type_id == persist::asset_type::GROUP )
+            continue;
+        // only first layer of inclusion
+        if ( ( filtertype == 7 ) || ( filtertype == persist::asset_type::GROUP )
+                || ( filtertype == node.type_id ) )
         {
-            i++;
-            a_elmnt_id_t id = 0;
-            row[0].get(id);
-            assert ( id );      // required field, otherwise db is corrupted
-    
-            std::string name = "";
-            row[1].get(name);
-            assert ( !name.empty() ); // otherwise db is corrupted
-
-            a_elmnt_tp_id_t id_type = 0;
-            row[2].get(id_type);
-            assert ( id_type );
-            
-            std::string dtype_name = "";
-            row[3].get(dtype_name);
-            
-            log_debug ("for");
-            log_debug ("i = %d", i);
-            log_debug ("id = %" PRIu32, id);
-            log_debug ("name = %s", name.c_str());
-            log_debug ("id_type = %" PRIu16, id_type);
-            log_debug ("dtype_name = %s", dtype_name.c_str());
-
-            // we are interested in this element if we are interested in 
-            // all elements ( filtertype == 7) or if this element has 
-            // exactly the type of the filter (filtertype == id_type)
-            // or we are interested in groups details 
-            // ( filtertype == persist::asset_type::GROUP )
-            if ( ( filtertype == 7 ) || ( filtertype == persist::asset_type::GROUP )
-                    || ( filtertype == id_type ) )
-            {
-                // dcs, rooms, rows, racks, devices, groups are NULL
-                // because we provide only first layer of inclusion
-                _scoped_zmsg_t* el = asset_msg_encode_return_location_from 
-                              (id, id_type, name.c_str(), dtype_name.c_str(), 
-                               NULL, NULL, NULL, NULL, NULL, NULL);
-                assert ( el );
-        
-                // we are interested in this element
-                log_debug ("created msg el for i = %d", i);
-
-                // put elements into the bins by its asset_element_type_id
-                if ( id_type == persist::asset_type::DATACENTER )
-                    rv = zmsg_addmsg (dcss, &el);
-                else if ( id_type == persist::asset_type::ROOM )
-                    rv = zmsg_addmsg (roomss, &el);
-                else if ( id_type == persist::asset_type::ROW )
-                    rv = zmsg_addmsg (rowss, &el);
-                else if ( id_type == persist::asset_type::RACK )
-                    rv = zmsg_addmsg (rackss, &el);
-                else if ( id_type == persist::asset_type::DEVICE )
-                    rv = zmsg_addmsg (devicess, &el);
-                assert ( rv != -1 );
-                assert ( el == NULL );                 
-                // group of groups is not allowed 
-            } // end of if interested in element
-        }// end for
-        
-        _scoped_zframe_t* dcs     = NULL;
-        _scoped_zframe_t* rooms   = NULL;
-        _scoped_zframe_t* rows    = NULL;
-        _scoped_zframe_t* racks   = NULL;
-        _scoped_zframe_t* devices = NULL;
-        
-        // transform bins to the frames
-        rv = matryoshka2frame (&dcss, &dcs);
-        assert ( rv == 0 );
-        rv = matryoshka2frame (&roomss, &rooms);
-        assert ( rv == 0 );
-        rv = matryoshka2frame (&rowss, &rows);
-        assert ( rv == 0 );
-        rv = matryoshka2frame (&rackss, &racks);
-        assert ( rv == 0 );
-        rv = matryoshka2frame (&devicess, &devices);
-        assert ( rv == 0 );
-
-        // generate message for the group with filled elements
-        zmsg_t* el = asset_msg_encode_return_location_from 
-                      (element_id, element_type_id, group_name, dtype_name, 
-                       dcs, rooms, rows, racks, devices, NULL);
-        assert ( el );
-        log_info ("end");
-        return el;
-    }
-    catch (const std::exception &e) {
-        log_warning ("abort with err = '%s'", e.what());
-        return common_msg_encode_fail (BIOS_ERROR_DB, DB_ERROR_INTERNAL, 
-                                                        e.what(), NULL);
+            node.end = topology.size () + 1;
+            topology.push_back (std::move (node));
+        }
     }
+    std::stable_sort (topology.begin () + first, topology.end (),
+        [](const location_node_t &a, const location_node_t &b) { return a.type_id < b.type_id; });
+    for ( size_t i = first; i != topology.size (); ++i )
+        topology[i].end = i + 1;
 }
 
-zframe_t* select_childs(
-    const char*     url             , a_elmnt_id_t element_id,
-    a_elmnt_tp_id_t element_type_id , a_elmnt_tp_id_t child_type_id,
-    bool            is_recursive    , uint32_t current_depth,
-    a_elmnt_tp_id_t     filtertype  , a_elmnt_id_t feed_by_id)
+// appends children of element_id of type child_type_id (with their
+// subtrees) to the topology, element_id == 0 means unlocated elements
+static void
+s_location_children (
+    const char* url,
+    tntdb::Connection &conn,
+    location_topology_t &topology,
+    a_elmnt_id_t element_id,
+    a_elmnt_tp_id_t child_type_id,
+    bool is_recursive,
+    uint32_t current_depth,
+    a_elmnt_tp_id_t filtertype,
+    a_elmnt_id_t feed_by_id)
 {
-    assert ( child_type_id );   // is required
-    assert ( ( filtertype >= persist::asset_type::GROUP ) && ( filtertype <= 7 ) ); 
-    // it can be only 1,2,3,4,5,6.7. 7 means - take all
+    log_debug ("depth = %" PRIu32 ", element_id = %" PRIu32 ", child_type_id = %" PRIu16,
+            current_depth, element_id, child_type_id);
 
-    log_info ("start select_childs");
-    log_debug ("depth = %" PRIu32, current_depth);
-    log_debug ("element_id = %" PRIu32, element_id);
-    log_debug ("element_type_id = %" PRIu16, element_type_id);
-    log_debug ("child_type_id = %" PRIu16, child_type_id);
-    log_debug ("feed_by_id = %" PRIu32, feed_by_id);
-
-    try{
-        tntdb::Connection conn = tntdb::connectCached(url); 
-        tntdb::Statement st;
-        tntdb::Result result; 
+    tntdb::Statement st;
+    // for the groups other select is needed
+    // because type of the group should be selected
+    if ( child_type_id == persist::asset_type::GROUP )
+    {
         if ( element_id != 0 )
-        {
-            // for the groups other select is needed
-            // because type of the group should be selected
-            if ( child_type_id == persist::asset_type::GROUP )
-            {
-                st = conn.prepareCached(
-                    " SELECT"
-                    "    v.id, v.name, v.id_type, v1.value as dtype_name"
-                    " FROM v_bios_asset_element v"
-                    "    INNER JOIN t_bios_asset_ext_attributes v1"
-                    "      ON ( v.id = v1.id_asset_element AND"
-                    "           v1.keytag = 'type')"
-                    " WHERE v.id_parent = :elementid AND"
-                    "       v.id_parent_type = :elementtypeid AND"
-                    "       v.id_type = :childtypeid"
-                );
-            }
-            else
-            {
-                st = conn.prepareCached(
-                    " SELECT"
-                    "    v.id, v.name, v.id_type, v1.name as dtype_name"
-                    " FROM v_bios_asset_element v"
-                    "    LEFT JOIN v_bios_asset_device v1"
-                    "      ON (v.id = v1.id_asset_element)"
-                    " WHERE v.id_parent = :elementid AND"
-                    "       v.id_parent_type = :elementtypeid AND"
-                    "       v.id_type = :childtypeid"
-                );
-            }
-            // Could return more than one row
-            result = st.set("elementid", element_id).
-                        set("elementtypeid", element_type_id).
-                        set("childtypeid", child_type_id).
-                        select();
-        }
+            st = conn.prepareCached(
+                " SELECT"
+                "    v.id, v.name, v.id_type, v1.value as dtype_name, ext.value as ext_name"
+                " FROM v_bios_asset_element v"
+                "    INNER JOIN t_bios_asset_ext_attributes v1"
+                "      ON ( v.id = v1.id_asset_element AND"
+                "           v1.keytag = 'type')"
+                "    LEFT JOIN t_bios_asset_ext_attributes ext"
+                "      ON ( v.id = ext.id_asset_element AND"
+                "           ext.keytag = 'name')"
+                " WHERE v.id_parent = :elementid AND"
+                "       v.id_type = :childtypeid"
+            );
+        else
+            st = conn.prepareCached(
+                " SELECT"
+                "    v.id, v.name, v.id_type, v1.value as dtype_name, ext.value as ext_name"
+                " FROM v_bios_asset_element v"
+                "    INNER JOIN t_bios_asset_ext_attributes v1"
+                "      ON ( v.id = v1.id_asset_element AND"
+                "           v1.keytag = 'type')"
+                "    LEFT JOIN t_bios_asset_ext_attributes ext"
+                "      ON ( v.id = ext.id_asset_element AND"
+                "           ext.keytag = 'name')"
+                " WHERE v.id_parent is NULL AND"
+                "       v.id_type = :childtypeid"
+            );
+    }
+    else
+    {
+        if ( element_id != 0 )
+            st = conn.prepareCached(
+                " SELECT"
+                "    v.id, v.name, v.id_type, v1.name as dtype_name, ext.value as ext_name"
+                " FROM v_bios_asset_element v"
+                "    LEFT JOIN v_bios_asset_device v1"
+                "      ON (v.id = v1.id_asset_element)"
+                "    LEFT JOIN t_bios_asset_ext_attributes ext"
+                "      ON ( v.id = ext.id_asset_element AND"
+                "           ext.keytag = 'name')"
+                " WHERE v.id_parent = :elementid AND"
+                "       v.id_type = :childtypeid"
+            );
         else
+            st = conn.prepareCached(
+                " SELECT"
+                "    v.id, v.name, v.id_type, v1.name as dtype_name, ext.value as ext_name"
+                " FROM v_bios_asset_element v"
+                "    LEFT JOIN v_bios_asset_device v1"
+                "      ON (v.id = v1.id_asset_element)"
+                "    LEFT JOIN t_bios_asset_ext_attributes ext"
+                "      ON ( v.id = ext.id_asset_element AND"
+                "           ext.keytag = 'name')"
+                " WHERE v.id_parent is NULL AND"
+                "       v.id_type = :childtypeid"
+            );
+    }
+    if ( element_id != 0 )
+        st.set("elementid", element_id);
+    // Could return more than one row
+    tntdb::Result result = st.set("childtypeid", child_type_id).select();
+    log_debug("rows selected %u", result.size());
+
+    for ( auto &row: result )
+    {
+        location_node_t node {0, 0, "", "", "", 0};
+        row[0].get(node.id);
+        row[1].get(node.name);
+        row[2].get(node.type_id);
+        row[3].get(node.dtype_name);
+        row[4].get(node.ext_name);
+        assert ( node.id );
+        assert ( node.type_id );
+
+        if ( child_type_id == persist::asset_type::GROUP )
         {
-            // for the groups, other select is needed
-            // because type of the group should be selected
-            if ( child_type_id == persist::asset_type::GROUP )
-            {
-                st = conn.prepareCached(
-                    " SELECT"
-                    "    v.id, v.name, v.id_type, v1.value as dtype_name"
-                    " FROM v_bios_asset_element v"
-                    "   INNER JOIN t_bios_asset_ext_attributes v1"
-                    "      ON ( v.id = v1.id_asset_element AND"
-                    "           v1.keytag = 'type')"
-                    " WHERE v.id_parent is NULL  AND"
-                    "       v.id_type = :childtypeid"
-                );
-            }
-            else
-            {
-                st = conn.prepareCached(
-                    " SELECT"
-                    "    v.id, v.name, v.id_type, v1.name as dtype_name"
-                    " FROM v_bios_asset_element v"
-                    "    LEFT JOIN v_bios_asset_device v1"
-                    "      ON (v.id = v1.id_asset_element)"
-                    " WHERE v.id_parent is NULL  AND "
-                    "       v.id_type = :childtypeid"
-                );
-            }
-            // Could return more than one row
-            result = st.set("childtypeid", child_type_id).
-                        select();
+            if ( ( filtertype != persist::asset_type::GROUP ) && ( filtertype != 7 ) )
+                continue;
+            size_t index = topology.size ();
+            topology.push_back (std::move (node));
+            if ( is_recursive && ( current_depth <= MAX_RECURSION_DEPTH ) )
+                s_location_group_members (conn, topology, topology[index].id, filtertype);
+            topology[index].end = topology.size ();
+            continue;
         }
-        log_debug("rows selected %u", result.size());
-        int rv = 0;
-        _scoped_zmsg_t* ret = zmsg_new();
-        int i = 0;
-        for ( auto &row: result )
-        {
-            i++;
-            uint32_t id = 0;
-            row[0].get(id);
-            assert ( id );
-    
-            std::string name = "";
-            row[1].get(name);
-            assert ( !name.empty() );
 
-            uint16_t id_type = 0;
-            row[2].get(id_type);
-            assert ( id_type );
-            
-            std::string dtype_name = "";
-            row[3].get(dtype_name);
-            
-            log_debug ("for");
-            log_debug ("i = %d", i);
-            log_debug ("id = %" PRIu32, id);
-            log_debug ("name = %s", name.c_str());
-            log_debug ("id_type = %" PRIu16, id_type);
-            log_debug ("dtype_name = %s", dtype_name.c_str());
-
-            _scoped_zframe_t* dcs     = NULL;
-            _scoped_zframe_t* rooms   = NULL;
-            _scoped_zframe_t* rows    = NULL;
-            _scoped_zframe_t* racks   = NULL;
-            _scoped_zframe_t* devices = NULL;
-            _scoped_zmsg_t*   grp     = NULL;
-            
-            // Select childs only 
-            // 2. it is recursive search, and we didn't achive max 
-            // 3. recursion depth
-            //////////////////////////
-            if (    ( is_recursive ) && 
-                    ( current_depth <= MAX_RECURSION_DEPTH ) )
+        // We found a device. Need to check, if it is feeded by feed_by_id
+        if ( ( child_type_id == persist::asset_type::DEVICE ) &&
+             ( feed_by_id != 0 ) )
+        {
+            bool want_it = false;
+            std::pair < std::set < device_info_t >, std::set < powerlink_info_t > >  power_topology =
+                select_power_topology_to (url, node.id, INPUT_POWER_CHAIN, true);
+            for ( const auto &one_device : power_topology.first )
             {
-                // There is no need to select datacenters, because 
-                // they could be seleted only for grops, but for groups
-                // there is a special processing
-                
-                // Select rooms only for datacenters
-                // and TODO filter
-                if (    ( child_type_id == persist::asset_type::DATACENTER ) && 
-                        ( 3 <= filtertype ) )
+                if ( device_info_id (one_device) == feed_by_id )
                 {
-                    log_info ("start select_rooms");
-                    rooms = select_childs (url, id, child_type_id, 
-                                persist::asset_type::ROOM, is_recursive, 
-                                current_depth + 1, filtertype, feed_by_id);
-                    log_info ("end select_rooms");
-                }
-
-                // Select rows only for datacenters and rooms
-                // and TODO filter
-                if ( (  ( child_type_id == persist::asset_type::DATACENTER ) ||
-                        ( child_type_id == persist::asset_type::ROOM ) )     && 
-                     ( 4 <= filtertype ) )
-                {
-                    log_info ("start select_rows");
-                    rows  = select_childs (url, id, child_type_id,
-                                persist::asset_type::ROW, is_recursive, 
-                                current_depth + 1, filtertype, feed_by_id);
-                    log_info ("end select_rows");
-                }
-                
-                // Select racks only for datacenters, rooms, rows
-                // and TODO filter
-                if ( (  ( child_type_id == persist::asset_type::DATACENTER)  ||
-                        ( child_type_id == persist::asset_type::ROOM )       ||
-                        ( child_type_id == persist::asset_type::ROW ) )     && 
-                     ( 5 <= filtertype ) )
-                {
-                    log_info ("start select_racks");
-                    racks   = select_childs (url, id, child_type_id,
-                                persist::asset_type::RACK, is_recursive,
-                                current_depth + 1, filtertype, feed_by_id);
-                    log_info ("end select_racks");
-                }
-
-                // Select devices only for datacenters, rooms, rows, racks
-                // and TODO filter
-                if ( (  ( child_type_id == persist::asset_type::DATACENTER)  ||
-                        ( child_type_id == persist::asset_type::ROOM )       ||
-                        ( child_type_id == persist::asset_type::ROW )        ||
-                        ( child_type_id == persist::asset_type::RACK ) )     &&
-                     ( 6 <= filtertype ) )
-                {
-                    log_info ("start select_devices");
-                    devices = select_childs (url, id, child_type_id,
-                                persist::asset_type::DEVICE, is_recursive,
-                                current_depth + 1, filtertype, feed_by_id);
-                    log_info ("end select_devices");
+                    want_it = true;
+                    break;
                 }
+            }
+            if ( !want_it )
+                continue;
+        }
 
-                // BIOS-1333 -> we have devices for devices also, but only once now.
-                // Select devices only for datacenters, rooms, rows, racks
-                // and TODO filter
-                if ( ( ( child_type_id == persist::asset_type::DEVICE) ) &&
-                     ( 6 <= filtertype ) )
-                {
-                    log_info ("start select_devices FOR devices BIOS-1333");
-                    devices = select_childs (url, id, child_type_id,
-                                persist::asset_type::DEVICE, is_recursive,
-                                MAX_RECURSION_DEPTH, filtertype, feed_by_id);
-                    log_info ("end select_devices FOR devices BIOS-1333");
-                }
+        size_t index = topology.size ();
+        a_elmnt_id_t id = node.id;
+        topology.push_back (std::move (node));
 
-                // TODO filter
-                // if it is a group, then do a special processing
-                if (    ( child_type_id == persist::asset_type::GROUP) && 
-                        (   ( persist::asset_type::GROUP == filtertype ) || 
-                            ( filtertype == 7 ) 
-                        ) )
-                {
-                    log_info ("start select elements of the grp");
-                    grp = select_group_elements (url, id, persist::asset_type::GROUP, 
-                                name.c_str(), dtype_name.c_str(), filtertype);
-                    log_info ("end select elements of the grp");
-                }
-            }
-            // all sub elements selected
-            
-            // We found a device. Need to check, if it is feeded by feed_by_id
-            bool want_it = true;
+        if ( is_recursive && ( current_depth <= MAX_RECURSION_DEPTH ) )
+        {
+            // children are appended type by type, datacenters are never
+            // selected as they can be only in groups
+            if ( ( child_type_id == persist::asset_type::DATACENTER ) &&
+                 ( 3 <= filtertype ) )
+                s_location_children (url, conn, topology, id, persist::asset_type::ROOM,
+                        is_recursive, current_depth + 1, filtertype, feed_by_id);
+            if ( ( ( child_type_id == persist::asset_type::DATACENTER ) ||
+                   ( child_type_id == persist::asset_type::ROOM ) ) &&
+                 ( 4 <= filtertype ) )
+                s_location_children (url, conn, topology, id, persist::asset_type::ROW,
+                        is_recursive, current_depth + 1, filtertype, feed_by_id);
+            if ( ( ( child_type_id == persist::asset_type::DATACENTER ) ||
+                   ( child_type_id == persist::asset_type::ROOM ) ||
+                   ( child_type_id == persist::asset_type::ROW ) ) &&
+                 ( 5 <= filtertype ) )
+                s_location_children (url, conn, topology, id, persist::asset_type::RACK,
+                        is_recursive, current_depth + 1, filtertype, feed_by_id);
+            if ( ( ( child_type_id == persist::asset_type::DATACENTER ) ||
+                   ( child_type_id == persist::asset_type::ROOM ) ||
+                   ( child_type_id == persist::asset_type::ROW ) ||
+                   ( child_type_id == persist::asset_type::RACK ) ) &&
+                 ( 6 <= filtertype ) )
+                s_location_children (url, conn, topology, id, persist::asset_type::DEVICE,
+                        is_recursive, current_depth + 1, filtertype, feed_by_id);
+            // BIOS-1333 -> we have devices for devices also
             if ( ( child_type_id == persist::asset_type::DEVICE ) &&
-                 ( feed_by_id != 0 )
-               )
-            {
-                // error handling is almost ignored, as it would 
-                // be legacy stuff soon and asset_msg is legacy
-                want_it = false;
-                a_lnk_tp_id_t  linktype   = INPUT_POWER_CHAIN;
-                std::pair < std::set < device_info_t >, std::set < powerlink_info_t > >  power_topology =
-                    select_power_topology_to (url, id, linktype, true);
-                for ( const auto &one_device : power_topology.first )
-                {
-                    if ( device_info_id (one_device) == feed_by_id )
-                    {
-                        want_it = true;
-                        break;
-                    }
-                }
-            }
-            log_debug ("want_id = %s", want_it ? "yes":"no");
-            // add this asset_element to return result
-            // if   selecting ALL or
-            //      for this element where selected sub elements or
-            //      the type of the element is a filter type
-            if ( want_it &&
-                 ( 
-                    !( ( filtertype < 7 ) &&
-                        ( ( my_size(dcs) == 0 ) && ( my_size(rooms) == 0 ) 
-                            && ( my_size(rows) == 0 ) && ( my_size(racks) == 0 ) 
-                            && ( my_size(devices) == 0 )  
-                        ) &&
-                        ( child_type_id != filtertype ) 
-                    )
-                 )
-                )
-            {
-                _scoped_zmsg_t* el;
-                if (    ( child_type_id == persist::asset_type::GROUP ) && 
-                        ( is_recursive ) )
-                    el = zmsg_dup (grp);   // because of the special group processing
-                else 
-                    el = asset_msg_encode_return_location_from 
-                                (id, id_type, name.c_str(), 
-                                 dtype_name.c_str(), dcs, rooms, 
-                                 rows, racks, devices, NULL);
-                assert ( el );
-                log_debug ("created msg el for i = %d",i);
-                rv = zmsg_addmsg ( ret, &el);
-                assert ( rv != -1 );
-                assert ( el == NULL );
-                zframe_destroy (&dcs);
-                zframe_destroy (&rooms);
-                zframe_destroy (&rows);
-                zframe_destroy (&racks);
-                zframe_destroy (&devices);
-            }
-        }// end for
-        zframe_t* res = NULL;
-        rv = matryoshka2frame (&ret, &res);
-        assert ( rv == 0 );
-        log_info ("end");
-        return res;
-    }
-    catch (const std::exception &e) {
-        log_warning ("abort with err = '%s'", e.what());
-        return NULL;
+                 ( 6 <= filtertype ) )
+                s_location_children (url, conn, topology, id, persist::asset_type::DEVICE,
+                        is_recursive, MAX_RECURSION_DEPTH, filtertype, feed_by_id);
+        }
+
+        // keep the element if selecting ALL or
+        //      some sub elements were selected or
+        //      the type of the element is a filter type
+        if ( ( filtertype < 7 ) &&
+             ( topology.size () == index + 1 ) &&
+             ( child_type_id != filtertype ) )
+        {
+            topology.pop_back ();
+            continue;
+        }
+        topology[index].end = topology.size ();
     }
 }
 
-zmsg_t* get_return_topology_from(const char* url, asset_msg_t* getmsg, a_elmnt_id_t feed_by_id)
+int
+    select_location_topology_from (
+        const char* url,
+        a_elmnt_id_t element_id,
+        a_elmnt_tp_id_t filter_type,
+        bool is_recursive,
+        a_elmnt_id_t feed_by_id,
+        location_topology_t &topology)
 {
-    assert ( getmsg );
     assert ( url );
-    assert ( asset_msg_id (getmsg) == ASSET_MSG_GET_LOCATION_FROM );
     log_info ("start");
 
-    uint32_t element_id   = asset_msg_element_id  (getmsg);
-    uint8_t  filter_type  = asset_msg_filter_type (getmsg);
-    bool     is_recursive = false;
-    uint16_t type_id      = 0;
-
-    // element_id == 0 => we are looking for unlocated elements;
-    // recursive := false; 
-    if (element_id != 0) {
-        is_recursive = asset_msg_recursive (getmsg);
-    } 
-    
-    _scoped_zframe_t* dcs     = NULL;
-    _scoped_zframe_t* rooms   = NULL;
-    _scoped_zframe_t* rows    = NULL;
-    _scoped_zframe_t* racks   = NULL;
-    _scoped_zframe_t* devices = NULL;
-    _scoped_zframe_t* grps    = NULL;
-
-    std::string name = "";
-    std::string dtype_name = "";
+    topology.clear ();
+    // for unlocated elements only a non recursive search is provided
+    if ( element_id == 0 )
+        is_recursive = false;
 
-    // select additional information about starting device
-    if ( element_id != 0 )
-    {
-        // if looking for a lockated elements
-        try{
-            tntdb::Connection conn = tntdb::connectCached(url);
-            tntdb::Statement st = conn.prepareCached(
-                " SELECT"
-                "    v.name, v.id_subtype, v.id_type"
-                " FROM v_bios_asset_element v"
-                " WHERE v.id = :id"
-            );
-
-            tntdb::Row row = st.set("id", element_id).
-                                selectRow();
-
-            row[0].get(name);
-            assert ( !name.empty() );
-            a_elmnt_stp_id_t subtype_id = 0;
-            row[1].get(subtype_id);
-            // QWER: use c++ dictionary instead of db dictionary
-            dtype_name = persist::subtypeid_to_subtype (subtype_id);
-            row[2].get(type_id);
-            assert ( type_id );
-
-        }
-        catch (const tntdb::NotFound &e) {
-            // element with specified id was not found
-            log_warning ("abort select element with err = '%s'", e.what());
-            return common_msg_encode_fail (BIOS_ERROR_DB, DB_ERROR_NOTFOUND,
-                                                        e.what(), NULL);
-        }
-        catch (const std::exception &e) {
-            // internal error in database
-            log_warning ("abort select element with err = '%s'", e.what());
-            return common_msg_encode_fail (BIOS_ERROR_DB, DB_ERROR_INTERNAL,
-                                                        e.what(), NULL);
-        }
+    try {
+        tntdb::Connection conn = tntdb::connectCached(url);
 
-        if ( type_id == persist::asset_type::GROUP )
+        location_node_t root {element_id, 0, "", "", "", 0};
+        // select additional information about starting element
+        if ( element_id != 0 )
         {
-            try{
-                tntdb::Connection conn = tntdb::connectCached(url);
+            try {
                 tntdb::Statement st = conn.prepareCached(
                     " SELECT"
-                    "    v.value"
-                    " FROM"
-                    "    t_bios_asset_ext_attributes v"
-                    " WHERE v.id_asset_element = :elementid AND "
-                    "       v.keytag = 'type'"
+                    "    v.name, v.id_subtype, v.id_type, ext.value"
+                    " FROM v_bios_asset_element v"
+                    "    LEFT JOIN t_bios_asset_ext_attributes ext"
+                    "      ON ( v.id = ext.id_asset_element AND"
+                    "           ext.keytag = 'name')"
+                    " WHERE v.id = :id"
                 );
-                tntdb::Row row = st.set("elementid", element_id).
-
-                                    selectRow();
-    
-                log_debug("element_id = %" PRIu32, element_id);
-                row[0].get(dtype_name);
-                assert ( !dtype_name.empty() ) ; 
+                tntdb::Row row = st.set("id", element_id).selectRow();
+
+                row[0].get(root.name);
+                assert ( !root.name.empty() );
+                a_elmnt_stp_id_t subtype_id = 0;
+                row[1].get(subtype_id);
+                root.dtype_name = persist::subtypeid_to_subtype (subtype_id);
+                row[2].get(root.type_id);
+                assert ( root.type_id );
+                row[3].get(root.ext_name);
             }
             catch (const tntdb::NotFound &e) {
-                // atribute type for the group was not specified, 
-                // but it is a mandatory
-                log_warning ("abort type for the group was not specified"
-                                " err = '%s'\n", e.what());
-                return common_msg_encode_fail (BIOS_ERROR_DB, 
-                        DB_ERROR_DBCORRUPTED, e.what(), NULL);
-            }
-            catch (const std::exception &e) {
-                // internal error in database
                 log_warning ("abort select element with err = '%s'", e.what());
-                return common_msg_encode_fail (BIOS_ERROR_DB, 
-                        DB_ERROR_INTERNAL, e.what(), NULL);
+                return DB_ERROR_NOTFOUND;
             }
 
+            if ( root.type_id == persist::asset_type::GROUP )
+            {
+                try {
+                    tntdb::Statement st = conn.prepareCached(
+                        " SELECT"
+                        "    v.value"
+                        " FROM"
+                        "    t_bios_asset_ext_attributes v"
+                        " WHERE v.id_asset_element = :elementid AND "
+                        "       v.keytag = 'type'"
+                    );
+                    tntdb::Row row = st.set("elementid", element_id).selectRow();
+                    row[0].get(root.dtype_name);
+                    assert ( !root.dtype_name.empty() ) ;
+                }
+                catch (const tntdb::NotFound &e) {
+                    // atribute type for the group was not specified,
+                    // but it is a mandatory
+                    log_warning ("abort type for the group was not specified"
+                                    " err = '%s'", e.what());
+                    return DB_ERROR_DBCORRUPTED;
+                }
+            }
         }
+        a_elmnt_tp_id_t type_id = root.type_id;
+        topology.push_back (std::move (root));
 
+        if ( type_id == persist::asset_type::GROUP )
+            s_location_group_members (conn, topology, element_id, filter_type);
+
+        // Select sub elements by types
+        // ACE: 11.12.14 according rfc and the logic, there is no need to
+        // select datacenters
+        if ( ( ( type_id == persist::asset_type::DATACENTER ) ||
+               ( element_id == 0 ) ) &&
+             ( 3 <= filter_type ) )
+            s_location_children (url, conn, topology, element_id, persist::asset_type::ROOM,
+                    is_recursive, 1, filter_type, feed_by_id);
+        if ( ( ( type_id == persist::asset_type::DATACENTER ) ||
+               ( type_id == persist::asset_type::ROOM ) ||
+               ( element_id == 0 ) ) &&
+             ( 4 <= filter_type ) )
+            s_location_children (url, conn, topology, element_id, persist::asset_type::ROW,
+                    is_recursive, 1, filter_type, feed_by_id);
+        if ( ( ( type_id == persist::asset_type::DATACENTER ) ||
+               ( type_id == persist::asset_type::ROOM ) ||
+               ( type_id == persist::asset_type::ROW ) ||
+               ( element_id == 0 ) ) &&
+             ( 5 <= filter_type ) )
+            s_location_children (url, conn, topology, element_id, persist::asset_type::RACK,
+                    is_recursive, 1, filter_type, feed_by_id);
+        if ( ( ( type_id == persist::asset_type::DATACENTER ) ||
+               ( type_id == persist::asset_type::ROOM ) ||
+               ( type_id == persist::asset_type::ROW ) ||
+               ( type_id == persist::asset_type::RACK ) ||
+               ( element_id == 0 ) ) &&
+             ( 6 <= filter_type ) )
+            s_location_children (url, conn, topology, element_id, persist::asset_type::DEVICE,
+                    is_recursive, 1, filter_type, feed_by_id);
+        // BIOS-1333 -> we have devices for devices also
+        if ( ( type_id == persist::asset_type::DEVICE ) &&
+             ( 6 <= filter_type ) )
+            s_location_children (url, conn, topology, element_id, persist::asset_type::DEVICE,
+                    is_recursive, MAX_RECURSION_DEPTH, filter_type, feed_by_id);
+        // Groups can be selected
+        //      - only for datacenter (if selecting all childs  or only groups).
+        //      - unlockated.
+        if ( ( ( type_id == persist::asset_type::DATACENTER ) &&
+               ( ( filter_type == persist::asset_type::GROUP ) ||
+                 ( filter_type == 7 ) ) ) ||
+             ( element_id == 0 ) )
+            s_location_children (url, conn, topology, element_id, persist::asset_type::GROUP,
+                    is_recursive, 1, filter_type, feed_by_id);
+
+        topology[0].end = topology.size ();
     }
+    catch (const std::exception &e) {
+        log_warning ("abort with err = '%s'", e.what());
+        topology.clear ();
+        return DB_ERROR_INTERNAL;
+    }
+    log_info ("end normal, %zu elements", topology.size ());
+    return 0;
+}
 
-    // Select sub elements by types
-
-    // Select datacenters
-    // ACE: 11.12.14 according rfc and the logic, there is no need to 
-    // select datacenters
+// encodes the node and its subtree as ASSET_MSG_RETURN_LOCATION_FROM
+static zmsg_t*
+s_location_encode (const location_topology_t &topology, size_t index)
+{
+    const location_node_t &node = topology[index];
 
-    // Select rooms
-    // only for datacenters according filter
-    // TODO filter
-    if ( ( ( type_id == persist::asset_type::DATACENTER ) || 
-           ( element_id == 0 ) ) &&
-         ( 3 <= filter_type ) )
-        
+    // bins of children indexed by the type id
+    zframe_t *bins[persist::asset_type::DEVICE + 1] = {NULL};
+    zmsg_t *bin = NULL;
+    a_elmnt_tp_id_t bin_type = 0;
+    for ( size_t child = index + 1; child < node.end; child = topology[child].end )
     {
-        log_info ("start select_rooms");
-        rooms = select_childs (url, element_id, type_id, persist::asset_type::ROOM,
-                        is_recursive, 1, filter_type, feed_by_id);
-        if ( rooms == NULL )
-        {
-            zframe_destroy (&dcs);
-            log_warning ("end abnormal");
-            return common_msg_encode_fail (BIOS_ERROR_DB, DB_ERROR_INTERNAL, 
-                                                    "rooms error", NULL);
+        if ( topology[child].type_id != bin_type ) {
+            if ( bin )
+                matryoshka2frame (&bin, &bins[bin_type]);
+            bin = zmsg_new ();
+            bin_type = topology[child].type_id;
         }
-        log_info ("end select_rooms");
-    }
-    // Select rows
-    // only for rooms, datacenters, unlockated
-    // TODO filter
-    if ( ( ( type_id == persist::asset_type::DATACENTER )  ||
-           ( type_id == persist::asset_type::ROOM )       || 
-           ( element_id == 0 ) ) &&
-         ( 4 <= filter_type ) )
-    {
-        log_info ("start select_rows");
-        rows = select_childs (url, element_id, type_id, persist::asset_type::ROW,
-                        is_recursive, 1, filter_type, feed_by_id);
-        if ( rows == NULL )
-        {
-            zframe_destroy (&dcs);
-            zframe_destroy (&rooms);
-            log_warning("end abnormal");
-            return common_msg_encode_fail (BIOS_ERROR_DB, DB_ERROR_INTERNAL, 
-                                                    "rows error", NULL);
-        }
-        log_info ("end select_rows");
-    }
-    // Select racks
-    // only for rooms, datacenters, rows, unlockated
-    // TODO filter
-    if ( ( ( type_id == persist::asset_type::DATACENTER)  ||
-           ( type_id == persist::asset_type::ROOM )       ||
-           ( type_id == persist::asset_type::ROW )        || 
-           ( element_id == 0 ) ) &&
-         ( 5 <= filter_type ) )
-    {
-        log_info ("start select_racks");
-        racks = select_childs (url, element_id, type_id, persist::asset_type::RACK,
-                        is_recursive, 1, filter_type, feed_by_id);
-        if ( racks == NULL )
-        {
-            zframe_destroy (&dcs);
-            zframe_destroy (&rooms);
-            zframe_destroy (&rows);
-            log_warning ("end abnormal");
-            return common_msg_encode_fail (BIOS_ERROR_DB, DB_ERROR_INTERNAL, 
-                                                    "racks error", NULL);
-        }
-        log_info ("end select_racks");
-    }
-    // Select devices
-    // only for rooms, datacenters, rows, racks, unlockated
-    // TODO filter
-    if ( ( ( type_id == persist::asset_type::DATACENTER)  ||
-           ( type_id == persist::asset_type::ROOM )       ||
-           ( type_id == persist::asset_type::ROW )        ||
-           ( type_id == persist::asset_type::RACK )     ||
-           ( element_id == 0 )  ) &&
-         ( 6 <= filter_type ) )
-    {
-        log_info ("start select_devices");
-        devices = select_childs (url, element_id, type_id, persist::asset_type::DEVICE,
-                        is_recursive, 1, filter_type, feed_by_id);
-        if ( devices == NULL )
-        {
-            zframe_destroy (&dcs);
-            zframe_destroy (&rooms);
-            zframe_destroy (&rows);
-            zframe_destroy (&racks);
-            log_warning ("end abnormal");
-            return common_msg_encode_fail (BIOS_ERROR_DB, DB_ERROR_INTERNAL, 
-                                                    "devices error", NULL);
-        }
-        log_info ("end select_devices");
-    }
-    // BIOS-1333 -> we have devices for devices also, but only once now.
-    // Select devices only for datacenters, rooms, rows, racks
-    // and TODO filter
-    if ( ( ( type_id == persist::asset_type::DEVICE) ) &&
-            ( 6 <= filter_type ) )
-    {
-        log_info ("start select_devices FOR devices BIOS-1333");
-        devices = select_childs (url, element_id, type_id,
-                persist::asset_type::DEVICE, is_recursive,
-                MAX_RECURSION_DEPTH, filter_type, feed_by_id);
-        log_info ("end select_devices FOR devices BIOS-1333");
-    }
-    // Select groups
-    // Groups can be selected
-    //      - only for datacenter (if selecting all childs  or only groups).
-    //      - unlockated.
-    // TODO filter
-    if  ( ( ( type_id == persist::asset_type::DATACENTER ) && 
-            ( ( filter_type == persist::asset_type::GROUP ) || 
-              ( filter_type == 7 ) ) ) ||
-          ( element_id == 0 ) )
-    {
-        log_info ("start select_grps");
-        grps = select_childs (url, element_id, type_id, persist::asset_type::GROUP,
-                        is_recursive, 1, filter_type, feed_by_id);
-        if ( grps == NULL )
-        {
-            zframe_destroy (&dcs);
-            zframe_destroy (&rooms);
-            zframe_destroy (&rows);
-            zframe_destroy (&racks);
-            zframe_destroy (&devices);
-            log_warning ("end abnormal");
-            return common_msg_encode_fail (BIOS_ERROR_DB, DB_ERROR_INTERNAL, 
-                                                    "groups error", NULL);
-        }
-        log_info ("end select_grps");
-    }
-    
-    zmsg_t* el = NULL; 
-    log_info ("creating return element");
-    if ( type_id == persist::asset_type::GROUP )
-    {
-        el = select_group_elements (url, element_id, type_id, name.c_str(), 
-                                    dtype_name.c_str(), filter_type);
+        zmsg_t *el = s_location_encode (topology, child);
+        zmsg_addmsg (bin, &el);
     }
-    else
-    {
-        el = asset_msg_encode_return_location_from 
-                    (element_id, type_id, name.c_str(), 
-                     dtype_name.c_str(), dcs, rooms, rows, 
-                     racks, devices, grps);
-    }
-    log_info ("end normal");
+    if ( bin )
+        matryoshka2frame (&bin, &bins[bin_type]);
+
+    zmsg_t *el = asset_msg_encode_return_location_from
+                (node.id, node.type_id, node.name.c_str(),
+                 node.dtype_name.c_str(),
+                 bins[persist::asset_type::DATACENTER],
+                 bins[persist::asset_type::ROOM],
+                 bins[persist::asset_type::ROW],
+                 bins[persist::asset_type::RACK],
+                 bins[persist::asset_type::DEVICE],
+                 bins[persist::asset_type::GROUP]);
+    for ( auto &frame : bins )
+        zframe_destroy (&frame);
     return el;
 }
 
+zmsg_t* get_return_topology_from(const char* url, asset_msg_t* getmsg, a_elmnt_id_t feed_by_id)
+{
+    assert ( getmsg );
+    assert ( url );
+    assert ( asset_msg_id (getmsg) == ASSET_MSG_GET_LOCATION_FROM );
+
+    location_topology_t topology;
+    int rv = select_location_topology_from (url,
+            asset_msg_element_id (getmsg),
+            asset_msg_filter_type (getmsg),
+            asset_msg_recursive (getmsg),
+            feed_by_id,
+            topology);
+    if ( rv != 0 )
+        return common_msg_encode_fail (BIOS_ERROR_DB, rv, "location topology error", NULL);
+    return s_location_encode (topology, 0);
+}
+
 bool compare_start_element (asset_msg_t* rmsg, uint32_t id, uint8_t id_type,
                             const char* name, const char* dtype_name)
 {
@@ -2033,26 +1769,32 @@ zmsg_t* get_return_power_topology_datacenter(const char* url,
     log_info ("start select devices");
     // result set of found devices
     std::set< device_info_t > resultdevices;
+    persist::AssetClosurePtr closure;
     try{
         tntdb::Connection conn = tntdb::connectCached(url);
-        tntdb::Statement st = conn.prepareCached(
-            " SELECT"
-            "   v.id_asset_element, v.name,"
-            "   v.id_asset_device_type"
-            " FROM"
-            "   v_bios_asset_element_super_parent v"
-            " WHERE :dcid IN (v.id_parent1, v.id_parent2 ,v.id_parent3,"
-            "                   v.id_parent4, v.id_parent5) AND"
-            "       id_type = :devicetype"
-        );
-        // can return more than one row
+        closure = persist::asset_closure (conn);
         log_debug ("element id %u", element_id);
-        tntdb::Result result = st.set("dcid", element_id).
-                                  set("devicetype", persist::asset_type::DEVICE).
-                                  select();
-        log_debug("rows selected %u", result.size());
 
-        for ( auto &row: result )
+        std::vector<tntdb::Row> rows;
+        persist::for_each_id_chunk (closure->descendants (element_id),
+            [&conn, &rows](const std::string &list)
+            {
+                tntdb::Statement st = conn.prepare(
+                    " SELECT"
+                    "   v.id_asset_element, v.name,"
+                    "   v.id_subtype"
+                    " FROM"
+                    "   t_bios_asset_element v"
+                    " WHERE v.id_asset_element IN (" + list + ") AND"
+                    "       v.id_type = :devicetype"
+                );
+                // can return more than one row
+                for ( auto &row: st.set("devicetype", persist::asset_type::DEVICE).select() )
+                    rows.push_back (row);
+            });
+        log_debug("rows selected %zu", rows.size());
+
+        for ( auto &row: rows )
         {
             // id_asset_element, required
             a_elmnt_id_t id_asset_element = 0;
@@ -2096,26 +1838,18 @@ zmsg_t* get_return_power_topology_datacenter(const char* url,
         tntdb::Connection conn = tntdb::connectCached(url);
         // v_bios_asset_link are only devices,
         // so there is no need to add more constrains
+        // both ends have to be in the datacenter, checked via the closure
         tntdb::Statement st = conn.prepareCached(
             " SELECT"
             "   v.src_out, v.id_asset_element_src, v.dest_in,"
             "   v.id_asset_element_dest"
             " FROM"
-            "   v_bios_asset_link v,"
-            "   v_bios_asset_element_super_parent v1,"
-            "   v_bios_asset_element_super_parent v2"
+            "   v_bios_asset_link v"
             " WHERE"
-            "   v.id_asset_link_type = :linktypeid AND"
-            "   v.id_asset_element_dest = v2.id_asset_element AND"
-            "   ( :dcid IN (v2.id_parent1, v2.id_parent2 ,v2.id_parent3,"
-            "               v2.id_parent4, v2.id_parent5) ) AND"
-            "   v.id_asset_element_src = v1.id_asset_element AND"
-            "   ( :dcid IN (v1.id_parent1, v1.id_parent2 ,v1.id_parent3,"
-            "               v1.id_parent4, v1.id_parent5) )"
+            "   v.id_asset_link_type = :linktypeid"
         );
         // can return more than one row
-        tntdb::Result result = st.set("dcid", element_id).
-                                  set("linktypeid", linktype).
+        tntdb::Result result = st.set("linktypeid", linktype).
                                   select();
         log_debug("rows selected %u", result.size());
 
@@ -2140,6 +1874,10 @@ zmsg_t* get_return_power_topology_datacenter(const char* url,
             row[3].get(id_asset_element_dest);
             assert ( id_asset_element_dest );
 
+            if ( !closure->is_under (id_asset_element_src, element_id) ||
+                 !closure->is_under (id_asset_element_dest, element_id) )
+                continue;
+
             log_debug ("for");
             log_debug ("asset_element_id_src = %" PRIu32,
                                                 id_asset_element_src);
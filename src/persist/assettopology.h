@@ -24,6 +24,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #ifndef SRC_PERSIST_ASSETTOPOLOGY_H_
 #define SRC_PERSIST_ASSETTOPOLOGY_H_
 #include <set>
+#include <string>
+#include <vector>
 #include <inttypes.h>
 #include "asset_msg.h"
 #include "dbtypes.h"
@@ -285,53 +287,53 @@ bool compare_start_element (asset_msg_t* rmsg, uint32_t id, uint8_t id_type,
 // ===============================================================
 
 /**
- * \brief Selects group elements of specified type for the specified group.
- *  
- *  Paramenters "element_type_id" and "group_name" are used only in the 
- *  returned zmsg_t message.
- * 
- *  In case of success it generates ASEET_MSG_RETURN_LOCATION_FROM message.
- *  In case of failure returns COMMON_MSG_FAIL message.
+ * \brief One element of a location topology.
  *
- * \param url             - connection to database.
- * \param element_id      - asset element id of the group.
- * \param element_type_id - asset_element_type_id of the group.
- * \param group_name      - name of the group.
- * \param filter_type     - id of the type of the searched elements
- *                          (from the table t_bios_asset_element_type).
- *
- * \return zmsg_t  - encoded ASEET_MSG_RETURN_LOCATION_FROM or 
- *                           COMMON_MSG_FAIL message.
-*/
-zmsg_t* select_group_elements(
-            const char*     url             , a_elmnt_id_t    element_id, 
-            a_elmnt_tp_id_t element_type_id , const char* group_name, 
-            const char*     dtype_name      , a_elmnt_tp_id_t     filtertype
-        );
+ * The topology is a flat array of the elements in preorder: children of
+ * the element i start at i + 1, the next sibling of i is at end. Children
+ * of the same type are adjacent and the types go in the order datacenters,
+ * rooms, rows, racks, devices, groups.
+ */
+struct location_node_t {
+    a_elmnt_id_t    id;
+    a_elmnt_tp_id_t type_id;
+    std::string     name;
+    std::string     ext_name;
+    std::string     dtype_name;     // device type, group type or "N_A"
+    uint32_t        end;            // index one past the last descendant
+};
+
+typedef std::vector <location_node_t> location_topology_t;
 
 /**
- * \brief Select childs of specified type for the specified element 
- *  (element_id + element_type_id). 
- *  
+ * \brief Selects the location topology of the element in one pass.
+ *
+ *  The same selection as get_return_topology_from, the element itself
+ *  is at index 0.
+ *
  *  To select unlockated elements need to set element_id to 0.
+ *  For unlockated elements only a non recursive search is provided.
  *  To select without the filter need to set a filtertype to 7.
  *
  * \param url             - connection to database.
  * \param element_id      - id of the asset element.
- * \param element_type_id - id of the type of the asset element.
- * \param child_type_id   - type id of the child asset elements.
- * \param is_recursive    - if the search recursive or not.
- * \param current_depth   - a recursion parameter, started from 1.
  * \param filter_type     - id of the type of the searched elements.
+ * \param is_recursive    - if the search recursive or not.
+ * \param feed_by_id      - an id of the asset element that must apear in
+ *                          the power chain for every returned device
+ * \param topology        - the result.
  *
- * \return zframe_t - list of the childs of secified type according 
- *                    to the filter filter_type. (it is a Matryoshka).
+ * \return 0 on success, DB_ERROR_NOTFOUND, DB_ERROR_DBCORRUPTED or
+ *         DB_ERROR_INTERNAL otherwise.
  */
-zframe_t* select_childs(
-    const char*     url             , a_elmnt_id_t element_id,
-    a_elmnt_tp_id_t element_type_id , a_elmnt_tp_id_t child_type_id,
-    bool            is_recursive    , uint32_t current_depth,
-    a_elmnt_tp_id_t     filtertype  , a_elmnt_id_t feed_by_id);
+int
+    select_location_topology_from (
+        const char* url,
+        a_elmnt_id_t element_id,
+        a_elmnt_tp_id_t filter_type,
+        bool is_recursive,
+        a_elmnt_id_t feed_by_id,
+        location_topology_t &topology);
 
 
 /*
@@ -26,164 +26,169 @@
 #include "asset_types.h"
 
 #include <algorithm>
+#include <utility>
+#include <vector>
+#include <ctype.h>
 
 namespace persist {
 
+namespace {
+
+class TypeRegistry {
+public:
+    // names indexed by id, names[0] is the one of the unknown id
+    TypeRegistry (
+            std::vector <std::string> names,
+            const std::vector <std::pair <std::string, uint16_t>> &aliases)
+        : _names (std::move (names))
+    {
+        for (uint16_t id = 1; id < _names.size (); ++id) {
+            _by_name.emplace_back (s_lower (_names [id]), id);
+            _dictionary.emplace (_names [id], id);
+        }
+        for (const auto &alias : aliases)
+            _by_name.emplace_back (s_lower (alias.first), alias.second);
+        std::stable_sort (_by_name.begin (), _by_name.end (),
+            [](const entry_t &a, const entry_t &b) { return a.first < b.first; });
+    }
+
+    const std::string&
+        name (uint16_t id) const
+    {
+        return id < _names.size () ? _names [id] : _names [0];
+    }
+
+    // 0 if not found, case insensitive
+    uint16_t
+        id (const std::string &name) const
+    {
+        // all names are short, longer ones are not worth lowering
+        char lower [MAX_NAME];
+        if (name.size () >= MAX_NAME)
+            return 0;
+        for (size_t i = 0; i != name.size (); ++i)
+            lower [i] = ::tolower ((unsigned char) name [i]);
+
+        size_t first = 0, last = _by_name.size ();
+        while (first < last) {
+            size_t middle = first + (last - first) / 2;
+            int cmp = _by_name [middle].first.compare (0, std::string::npos, lower, name.size ());
+            if (cmp == 0)
+                return _by_name [middle].second;
+            if (cmp < 0)
+                first = middle + 1;
+            else
+                last = middle;
+        }
+        return 0;
+    }
+
+    const std::map <std::string, int>&
+        dictionary () const
+    {
+        return _dictionary;
+    }
+
+private:
+    typedef std::pair <std::string, uint16_t> entry_t;
+    static const size_t MAX_NAME = 32;
+
+    static std::string
+        s_lower (std::string s)
+    {
+        std::transform (s.begin (), s.end (), s.begin (), ::tolower);
+        return s;
+    }
+
+    std::vector <std::string> _names;
+    std::vector <entry_t> _by_name;     // lower case, sorted
+    std::map <std::string, int> _dictionary;
+};
+
+const TypeRegistry&
+    s_types (void)
+{
+    static const TypeRegistry registry ({
+        "unknown",
+        "group",        // GROUP
+        "datacenter",   // DATACENTER
+        "room",         // ROOM
+        "row",          // ROW
+        "rack",         // RACK
+        "device"        // DEVICE
+    }, {});
+    return registry;
+}
+
+const TypeRegistry&
+    s_subtypes (void)
+{
+    static const TypeRegistry registry ({
+        "unknown",
+        "ups",              // UPS
+        "genset",           // GENSET
+        "epdu",             // EPDU
+        "pdu",              // PDU
+        "server",           // SERVER
+        "feed",             // FEED
+        "sts",              // STS
+        "switch",           // SWITCH
+        "storage",          // STORAGE
+        "vm",               // VIRTUAL
+        "N_A",              // N_A
+        "router",           // ROUTER
+        "rack controller",  // RACKCONTROLLER
+        "sensor",           // SENSOR
+        "appliance",        // APPLIANCE
+        "chassis",          // CHASSIS
+        "patch panel",      // PATCHPANEL
+        "other"             // OTHER
+    }, {
+        {"", asset_subtype::N_A}
+    });
+    return registry;
+}
+
+} // namespace
+
 a_elmnt_tp_id_t
     type_to_typeid
         (const std::string &type)
 {
-    std::string t (type);
-    std::transform(t.begin(), t.end(), t.begin(), ::tolower);
-    if(t == "datacenter") {
-        return asset_type::DATACENTER;
-    } else if(t == "room") {
-        return asset_type::ROOM;
-    } else if(t == "row") {
-        return asset_type::ROW;
-    } else if(t == "rack") {
-        return asset_type::RACK;
-    } else if(t == "group") {
-        return asset_type::GROUP;
-    } else if(t == "device") {
-        return asset_type::DEVICE;
-    } else
-        return asset_type::TUNKNOWN;
+    return s_types ().id (type);
 }
 
-std::string
+const std::string&
     typeid_to_type
         (a_elmnt_tp_id_t type_id)
 {
-    switch(type_id) {
-        case asset_type::DATACENTER:
-            return "datacenter";
-        case asset_type::ROOM:
-            return "room";
-        case asset_type::ROW:
-            return "row";
-        case asset_type::RACK:
-            return "rack";
-        case asset_type::GROUP:
-            return "group";
-        case asset_type::DEVICE:
-            return "device";
-        default:
-            return "unknown";
-    }
+    return s_types ().name (type_id);
 }
 
 a_elmnt_stp_id_t
     subtype_to_subtypeid
         (const std::string &subtype)
 {
-    std::string st(subtype);
-    std::transform(st.begin(), st.end(), st.begin(), ::tolower);
-    if(st == "ups") {
-        return asset_subtype::UPS;
-    }
-    else if(st == "genset") {
-        return asset_subtype::GENSET;
-    }
-    else if(st == "epdu") {
-        return asset_subtype::EPDU;
-    }
-    else if(st == "server") {
-        return asset_subtype::SERVER;
-    }
-    else if(st == "pdu") {
-        return asset_subtype::PDU;
-    }
-    else if(st == "feed") {
-        return asset_subtype::FEED;
-    }
-    else if(st == "sts") {
-        return asset_subtype::STS;
-    }
-    else if(st == "switch") {
-        return asset_subtype::SWITCH;
-    }
-    else if(st == "storage") {
-        return asset_subtype::STORAGE;
-    }
-    else if (st == "vm") {
-        return asset_subtype::VIRTUAL;
-    }
-    else if (st == "router") {
-        return asset_subtype::ROUTER;
-    }
-    else if (st == "rack controller") {
-        return asset_subtype::RACKCONTROLLER;
-    }
-    else if (st == "sensor") {
-        return asset_subtype::SENSOR;
-    }
-    else if (st == "appliance") {
-        return asset_subtype::APPLIANCE;
-    }
-    else if (st == "chassis") {
-        return asset_subtype::CHASSIS;
-    }
-    else if (st == "patch panel") {
-        return asset_subtype::PATCHPANEL;
-    }
-    else if (st == "other") {
-        return asset_subtype::OTHER;
-    }
-    else if(st == "n_a") {
-        return asset_subtype::N_A;
-    }
-    else if(st == "") {
-        return asset_subtype::N_A;
-    }
-    else
-        return asset_subtype::SUNKNOWN;
+    return s_subtypes ().id (subtype);
 }
 
-std::string
+const std::string&
     subtypeid_to_subtype
         (a_elmnt_tp_id_t subtype_id)
 {
-    switch(subtype_id) {
-        case asset_subtype::UPS:
-            return "ups";
-        case asset_subtype::GENSET:
-            return "genset";
-        case asset_subtype::STORAGE:
-            return "storage";
-        case asset_subtype::STS:
-            return "sts";
-        case asset_subtype::FEED:
-            return "feed";
-        case asset_subtype::EPDU:
-            return "epdu";
-        case asset_subtype::PDU:
-            return "pdu";
-        case asset_subtype::SERVER:
-            return "server";
-        case asset_subtype::SWITCH:
-            return "switch";
-        case asset_subtype::ROUTER:
-            return "router";
-        case asset_subtype::RACKCONTROLLER:
-            return "rack controller";
-        case asset_subtype::SENSOR:
-            return "sensor";
-        case asset_subtype::APPLIANCE:
-            return "appliance";
-        case asset_subtype::CHASSIS:
-            return "chassis";
-        case asset_subtype::PATCHPANEL:
-            return "patch panel";
-        case asset_subtype::OTHER:
-            return "other";
-        case asset_subtype::VIRTUAL:
-            return "vm";
-        case asset_subtype::N_A:
-            return "N_A";
-        default:
-            return "unknown";
-    }
+    return s_subtypes ().name (subtype_id);
+}
+
+const std::map <std::string, int>&
+    element_types (void)
+{
+    return s_types ().dictionary ();
+}
+
+const std::map <std::string, int>&
+    device_types (void)
+{
+    return s_subtypes ().dictionary ();
 }
 
 std::string
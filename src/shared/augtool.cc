@@ -27,11 +27,20 @@
 #include <string>
 #include <functional>
 #include <cxxtools/split.h>
+#include <sys/stat.h>
 
 #include "augtool.h"
 
 using namespace shared;
 
+//! Files loaded into the augeas tree by the lenses we use
+static const char *WATCHED_FILES[] = {
+    "/etc/network/interfaces",
+    "/etc/resolv.conf",
+    "/etc/ntp.conf",
+    NULL
+};
+
 std::string augtool::get_cmd_out(std::string cmd, bool key_value,
                                  std::string sep,
                                  std::function<bool(std::string)> filter) {
@@ -69,29 +78,64 @@ std::string augtool::get_cmd_out(std::string cmd, bool key_value,
 }
 
 
-std::string augtool::get_cmd_out_raw(std::string command) {
-    std::string ret;
-    bool err = false;
-    mux.lock();
+std::string augtool::exec(std::string command) {
     if(command.empty() || command.back() != '\n')
         command += "\n";
     if(write(prc->getStdin(), command.c_str(), command.length()) < 1)
-        err = true;
-    ret = wait_read_all(prc->getStdout());
-    mux.unlock();
-    return err ? "" : ret;
+        return "";
+    return wait_read_all(prc->getStdout());
+}
+
+std::string augtool::get_cmd_out_raw(std::string command) {
+    std::lock_guard<std::mutex> lock(mux);
+    if(!is_read_only(command)) {
+        dirty = true;
+        cache.clear();
+        return exec(command);
+    }
+    if(dirty)
+        return exec(command);
+    auto it = cache.find(command);
+    if(it != cache.end())
+        return it->second;
+    std::string ret = exec(command);
+    cache[command] = ret;
+    return ret;
 }
 
 void augtool::run_cmd(std::string cmd) {
     get_cmd_out_raw(cmd);
 }
 
+bool augtool::is_read_only(const std::string& cmd) {
+    auto end = cmd.find_first_of(" \t\n");
+    std::string verb = cmd.substr(0, end);
+    return verb == "get" || verb == "ls" || verb == "match" || verb == "print";
+}
+
+std::map<std::string, augtool::mtime_t> augtool::snapshot() {
+    std::map<std::string, mtime_t> ret;
+    struct stat st;
+    for(const char **file = WATCHED_FILES; *file != NULL; file++) {
+        if(stat(*file, &st) == 0)
+            ret[*file] = mtime_t(st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+        else
+            ret[*file] = mtime_t(-1, -1);
+    }
+    return ret;
+}
+
 void augtool::clear() {
-    static std::mutex clear_mux;
-    clear_mux.lock();
-    run_cmd("");
-    run_cmd("load");
-    clear_mux.unlock();
+    std::lock_guard<std::mutex> lock(mux);
+    // Take the snapshot before loading, so change during load triggers reload
+    auto now = snapshot();
+    if(!dirty && !mtimes.empty() && now == mtimes)
+        return;
+    exec("");
+    exec("load");
+    cache.clear();
+    mtimes = now;
+    dirty = false;
 }
 
 augtool* augtool::get_instance() {
@@ -112,6 +156,7 @@ augtool* augtool::get_instance() {
         if(!inst.prc->isRunning() || nil.find("match") == nil.npos) {
             delete inst.prc;
             inst.prc = NULL;
+            in_mux.unlock();
             return NULL;
         }
     }
@@ -119,4 +164,3 @@ augtool* augtool::get_instance() {
     inst.clear();
     return &inst;
 }
-
@@ -26,9 +26,11 @@
  * \brief Not yet documented file
  */
 #include "cidr.h"
+#include <algorithm>
 #include <cstdio>
 #include <stdlib.h>
 #include <string.h>
+#include <arpa/inet.h>
 
 namespace shared {
 
@@ -473,55 +475,283 @@ std::ostream& operator<<(std::ostream& os, const CIDRAddress& address)
   return os << address.toString();
 }
 
-CIDRList::CIDRList(){
+bool CIDRList::Key::operator<(const Key& k) const {
+  if( proto != k.proto ) return proto < k.proto;
+  if( hi != k.hi ) return hi < k.hi;
+  return lo < k.lo;
+}
 
+bool CIDRList::Key::operator==(const Key& k) const {
+  return proto == k.proto && hi == k.hi && lo == k.lo;
 }
 
-bool CIDRList::_nextSimple(CIDRAddress& address) {
-  if( ! address.valid() ) {
-    address.set(firstAddress());
-    _last = lastAddress();
-    return address.valid();
+CIDRList::Key CIDRList::Key::succ() const {
+  Key k = *this;
+  // IPv4 lives in lo only, 255.255.255.255 + 1 is still below any IPv6
+  if( ++k.lo == 0 && ++k.hi == 0 ) ++k.proto;
+  return k;
+}
+
+CIDRList::Key CIDRList::Key::pred() const {
+  Key k = *this;
+  if( k.lo-- == 0 ) k.hi--;
+  return k;
+}
+
+CIDRList::Key CIDRList::Key::plus(uint64_t n) const {
+  Key k = *this;
+  k.lo += n;
+  if( k.lo < n ) k.hi++;
+  return k;
+}
+
+CIDRList::CIDRList() :
+  _cursor(SIZE_MAX),
+  _cursorKey{0, 0, 0}
+{
+}
+
+CIDRList::Key CIDRList::_key(const CIDRAddress& address) {
+  Key key = {0, 0, 0};
+  if( cidr_get_proto(address._cidr) == CIDR_IPV4 ) {
+    struct in_addr inaddr;
+    cidr_to_inaddr(address._cidr, &inaddr);
+    key.proto = 4;
+    key.lo = ntohl(inaddr.s_addr);
+  } else {
+    struct in6_addr in6addr;
+    cidr_to_in6addr(address._cidr, &in6addr);
+    key.proto = 6;
+    for(int i=0; i<8; i++) {
+      key.hi = (key.hi << 8) | in6addr.s6_addr[i];
+      key.lo = (key.lo << 8) | in6addr.s6_addr[i+8];
+    }
   }
-  ++address;
-  if( address > _last ) {
-    address.invalidate();
+  return key;
+}
+
+CIDRList::Range CIDRList::_block(const CIDRAddress& net) {
+  Range range;
+  range.first = _key(net);
+  int hostbits = (range.first.proto == 4 ? 32 : 128) - net.prefix();
+  uint64_t himask = 0, lomask = 0;
+  if( hostbits >= 64 ) {
+    lomask = UINT64_MAX;
+    himask = hostbits == 128 ? UINT64_MAX : (1ULL << (hostbits - 64)) - 1;
+  } else if( hostbits > 0 ) {
+    lomask = (1ULL << hostbits) - 1;
+  }
+  range.first.hi &= ~himask;
+  range.first.lo &= ~lomask;
+  range.last = range.first;
+  range.last.hi |= himask;
+  range.last.lo |= lomask;
+  return range;
+}
+
+void CIDRList::_setAddress(CIDRAddress& address, const Key& key) {
+  if( key.proto == 4 ) {
+    struct in_addr inaddr;
+    inaddr.s_addr = htonl((uint32_t)key.lo);
+    address.set(&inaddr);
+  } else {
+    struct in6_addr in6addr;
+    for(int i=0; i<8; i++) {
+      in6addr.s6_addr[i] = (key.hi >> (56 - 8*i)) & 0xff;
+      in6addr.s6_addr[i+8] = (key.lo >> (56 - 8*i)) & 0xff;
+    }
+    address.set(&in6addr);
+  }
+}
+
+bool CIDRList::_contains(const std::vector<Range>& blocks, const CIDRAddress& address) {
+  if( ! address.valid() ) return false;
+  Range range = _block(address);
+  // the last block starting before the address is the only candidate
+  auto it = std::upper_bound(blocks.begin(), blocks.end(), range.first,
+      [](const Key& k, const Range& r) { return k < r.first; });
+  if( it == blocks.begin() ) return false;
+  --it;
+  return ! (it->last < range.last);
+}
+
+void CIDRList::_rebuild() {
+  struct Block {
+    Range range;
+    bool excluded;
+    bool filterFirst;
+    bool filterLast;
+  };
+  std::vector<Block> blocks;
+  blocks.reserve(_networks.size() + _excludedNetworks.size());
+  for(const auto& net : _networks ) {
+    Block b = { _block(net), false, false, false };
+    if( b.range.first.proto == 4 ) {
+      // network address and broadcast
+      b.filterFirst = b.filterLast = net.prefix() < 31;
+    } else {
+      // subnet-router anycast
+      b.filterFirst = net.prefix() < 127;
+    }
+    blocks.push_back(b);
+  }
+  for(const auto& net : _excludedNetworks ) {
+    blocks.push_back( Block{ _block(net), true, false, false } );
+  }
+  // outer blocks first, exclude inside the same include (it wins)
+  std::sort(blocks.begin(), blocks.end(), [](const Block& a, const Block& b) {
+    if( ! (a.range.first == b.range.first) ) return a.range.first < b.range.first;
+    if( ! (a.range.last == b.range.last) ) return b.range.last < a.range.last;
+    return a.excluded < b.excluded;
+  });
+
+  _includeBlocks.clear();
+  _excludeBlocks.clear();
+  for(const auto& b : blocks ) {
+    auto& outer = b.excluded ? _excludeBlocks : _includeBlocks;
+    if( outer.empty() || outer.back().last < b.range.first ) {
+      outer.push_back(b.range);
+    }
   }
-  return address.valid();
-}
 
-bool CIDRList::next(CIDRAddress& address) {
-  int filtered,iprefix,eprefix;
-  do {
-    filtered = 0;
-    _nextSimple(address);
-    if( ! address.valid() ) { break; }
-    iprefix = bestNetworkPrefixFor(address);
-    if( iprefix == -1) {
-      // out of scope
-      _skipToNextPool(address);
-      filtered = 1;
+  // blocks are nested or disjoint, every address belongs to the innermost
+  // block around it
+  _ranges.clear();
+  auto emit = [this](Key first, Key last, const Block& owner) {
+    if( owner.excluded ) return;
+    if( owner.filterFirst && first == owner.range.first ) first = first.succ();
+    if( owner.filterLast && last == owner.range.last ) last = last.pred();
+    // 0.0.0.0 and :: are not valid addresses
+    if( first.hi == 0 && first.lo == 0 ) first = first.succ();
+    if( last < first ) return;
+    if( ! _ranges.empty() && _ranges.back().last.succ() == first ) {
+      _ranges.back().last = last;
     } else {
-      eprefix = bestExcludePrefixFor(address);
-      if(eprefix > iprefix) {
-        //excluded
-        _skipToExcludeEnd(address);
-        filtered = 1;
-      } else {
-        //not excluded, skip net and broadcast
-        CIDRAddress net = bestNetworkFor(address);
-        // FIXME IPv6
-        if( net.prefix() < 31 /* and IPv4? */) {
-          if( ( address == net.host() ) || ( address == net.broadcast() ) ){
-            filtered = 1;
-          }
-        }
+      _ranges.push_back( Range{ first, last } );
+    }
+  };
+  std::vector<const Block*> stack;
+  Key cursor = {0, 0, 0};
+  for(const auto& b : blocks ) {
+    while( ! stack.empty() && stack.back()->range.last < b.range.first ) {
+      if( ! (stack.back()->range.last < cursor) ) {
+        emit(cursor, stack.back()->range.last, *stack.back());
+        cursor = stack.back()->range.last.succ();
       }
+      stack.pop_back();
+    }
+    if( ! stack.empty() && cursor < b.range.first ) {
+      emit(cursor, b.range.first.pred(), *stack.back());
+    }
+    cursor = b.range.first;
+    stack.push_back(&b);
+  }
+  while( ! stack.empty() ) {
+    if( ! (stack.back()->range.last < cursor) ) {
+      emit(cursor, stack.back()->range.last, *stack.back());
+      cursor = stack.back()->range.last.succ();
     }
-  } while ( filtered );
+    stack.pop_back();
+  }
+  _cursor = SIZE_MAX;
+}
+
+bool CIDRList::_walk(const std::vector<Range>& ranges, size_t& cursor, Key& cursorKey, CIDRAddress& address) {
+  size_t i = 0;
+  Key key;
+
+  if( ! address.valid() ) {
+    if( ranges.empty() ) return false;
+    key = ranges[0].first;
+  } else {
+    Key current = _key(address);
+    if( cursor < ranges.size() && current == cursorKey ) {
+      // continuing the iteration
+      i = cursor;
+      if( current == ranges[i].last ) ++i;
+    } else {
+      // first range ending after the address
+      i = std::upper_bound(ranges.begin(), ranges.end(), current,
+          [](const Key& k, const Range& r) { return k < r.last; }) - ranges.begin();
+    }
+    if( i == ranges.size() ) {
+      cursor = SIZE_MAX;
+      address.invalidate();
+      return false;
+    }
+    key = current < ranges[i].first ? ranges[i].first : current.succ();
+  }
+  cursor = i;
+  cursorKey = key;
+  _setAddress(address, key);
   return address.valid();
 }
 
+bool CIDRList::next(CIDRAddress& address) {
+  return _walk(_ranges, _cursor, _cursorKey, address);
+}
+
+uint64_t CIDRList::_size(const Range& range) {
+  uint64_t hi = range.last.hi - range.first.hi;
+  if( range.last.lo < range.first.lo ) hi--;
+  uint64_t lo = range.last.lo - range.first.lo;
+  if( hi != 0 || lo == UINT64_MAX ) return UINT64_MAX;
+  return lo + 1;
+}
+
+void CIDRList::_cut(std::vector<Range>& ranges, size_t begin, uint64_t keep, std::vector<Range>& rest) {
+  size_t i = begin;
+  while( keep != 0 && i < ranges.size() ) {
+    uint64_t size = _size(ranges[i]);
+    if( size > keep ) {
+      // split this range
+      Range tail = { ranges[i].first.plus(keep), ranges[i].last };
+      ranges[i].last = tail.first.pred();
+      rest.assign(1, tail);
+      rest.insert(rest.end(), ranges.begin() + i + 1, ranges.end());
+      ranges.resize(i + 1);
+      return;
+    }
+    keep -= size;
+    i++;
+  }
+  rest.assign(ranges.begin() + i, ranges.end());
+  ranges.resize(i);
+}
+
+uint64_t CIDRList::_size(const std::vector<Range>& ranges, size_t begin) {
+  uint64_t result = 0;
+  for(size_t i = begin; i < ranges.size(); i++ ) {
+    uint64_t size = _size(ranges[i]);
+    if( size > UINT64_MAX - result ) return UINT64_MAX;
+    result += size;
+  }
+  return result;
+}
+
+uint64_t CIDRList::size() const {
+  return _size(_ranges, 0);
+}
+
+std::vector<CIDRPart> CIDRList::split(size_t parts) const {
+  std::vector<CIDRPart> result;
+  uint64_t total = size();
+  if( parts == 0 || total == 0 ) return result;
+  if( parts > total ) parts = total;
+
+  std::vector<Range> rest = _ranges;
+  result.resize(parts);
+  for(size_t i = 0; i < parts; i++ ) {
+    result[i]._ranges.swap(rest);
+    // the last part takes what is left, even beyond UINT64_MAX addresses
+    if( i + 1 < parts ) {
+      uint64_t keep = total / parts + (i < total % parts ? 1 : 0);
+      _cut(result[i]._ranges, 0, keep, rest);
+    }
+  }
+  return result;
+}
+
 bool CIDRList::add(const std::string &net) {
   CIDRAddress cnet(net);
   return add(cnet);
@@ -535,6 +765,7 @@ bool CIDRList::add(const CIDRAddress& net) {
     }
   }
   _networks.push_back(net);
+  _rebuild();
   return true;
 }
 
@@ -549,6 +780,7 @@ bool CIDRList::exclude(const CIDRAddress& net) {
     if( _excludedNetworks[i].equals(net) ) return false;
   }
   _excludedNetworks.push_back(net);
+  _rebuild();
   return true;
 }
 
@@ -590,45 +822,6 @@ CIDRAddress CIDRList::bestNetworkFor(CIDRAddress& address) const{
   return net;
 }
 
-void CIDRList::_skipToNextPool(CIDRAddress& address) const{
-  CIDRAddress selected;
-  for(unsigned int i=0; i<_networks.size(); i++ ) {
-    // we should not walk trough ipv6
-    if( _networks[i] > address && (_networks[i].protocol() == 4 ) ) {
-      if( selected.valid() ) {
-        if( _networks[i] < selected ) {
-          selected = _networks[i].host();
-        }
-      } else {
-        selected = _networks[i].host();
-      }
-    }
-  }
-  --selected;
-  address.set(selected);
-}
-
-void CIDRList::_skipToExcludeEnd(CIDRAddress& address) const {
-  CIDRAddress currentExclude = bestExcludeFor(address);
-  CIDRAddress excludeEnd = currentExclude.broadcast();
-  CIDRAddress selected = excludeEnd;
-  
-  for(unsigned int i=0; i<_networks.size(); i++ ) {
-    if( (_networks[i] > address) && (_networks[i] < excludeEnd) ) {
-      if( selected.valid() ) {
-        if( _networks[i] < selected ) {
-          selected = _networks[i].host();
-          --selected;
-        }
-      } else {
-        selected = _networks[i].host();
-        --selected;
-      }
-    }
-  }
-  address.set(selected);
-}
-
 int CIDRList::bestNetworkPrefixFor(CIDRAddress& address) const{
   CIDRAddress bestnet = bestNetworkFor(address);
   if(bestnet.valid()) return bestnet.prefix();
@@ -657,24 +850,105 @@ int CIDRList::bestExcludePrefixFor(CIDRAddress& address) const {
 }
 
 bool CIDRList::includes(const CIDRAddress& address) const {
-  for(unsigned int i=0; i<_networks.size(); i++ ){
-    if( _networks[i].contains(address)  ) return true;
-  }
-  return false;
+  return _contains(_includeBlocks, address);
 }
 
 bool CIDRList::excludes(const CIDRAddress& address) const{
-  for(unsigned int i=0; i<_excludedNetworks.size(); i++ ){
-    if( _excludedNetworks[i].contains(address) ) {
-      return true;
+  return _contains(_excludeBlocks, address);
+}
+
+CIDRList::~CIDRList(){
+
+}
+
+CIDRPart::CIDRPart() :
+  _cursor(SIZE_MAX),
+  _cursorKey{0, 0, 0}
+{
+}
+
+bool CIDRPart::next(CIDRAddress& address) {
+  return CIDRList::_walk(_ranges, _cursor, _cursorKey, address);
+}
+
+uint64_t CIDRPart::size() const {
+  return CIDRList::_size(_ranges, 0);
+}
+
+CIDRAddress CIDRPart::firstAddress() const {
+  CIDRAddress result;
+  if( ! _ranges.empty() ) CIDRList::_setAddress(result, _ranges.front().first);
+  return result;
+}
+
+CIDRAddress CIDRPart::lastAddress() const {
+  CIDRAddress result;
+  if( ! _ranges.empty() ) CIDRList::_setAddress(result, _ranges.back().last);
+  return result;
+}
+
+CIDRWalker::CIDRWalker(const CIDRList& list, size_t workers) {
+  std::vector<CIDRPart> parts = list.split(workers);
+  for(size_t i = 0; i < workers; i++ ) {
+    std::unique_ptr<Slot> slot(new Slot());
+    slot->begin = 0;
+    slot->left = 0;
+    if( i < parts.size() ) {
+      slot->left = parts[i].size();
+      slot->ranges.swap(parts[i]._ranges);
     }
+    _slots.push_back(std::move(slot));
   }
-  return false;
 }
 
-CIDRList::~CIDRList(){
+bool CIDRWalker::next(size_t worker, CIDRAddress& address) {
+  if( worker >= _slots.size() ) {
+    address.invalidate();
+    return false;
+  }
+  Slot& own = *_slots[worker];
+  for(;;) {
+    {
+      std::lock_guard<std::mutex> lock(own.mux);
+      if( own.begin < own.ranges.size() ) {
+        CIDRList::Range& range = own.ranges[own.begin];
+        CIDRList::_setAddress(address, range.first);
+        if( range.first == range.last ) {
+          own.begin++;
+        } else {
+          range.first = range.first.succ();
+        }
+        if( own.left != UINT64_MAX ) own.left--;
+        return true;
+      }
+    }
 
+    // steal from the one with most addresses left
+    Slot *victim = NULL;
+    uint64_t most = 0;
+    for(auto& slot : _slots ) {
+      if( slot.get() == &own ) continue;
+      std::lock_guard<std::mutex> lock(slot->mux);
+      if( slot->left > most ) {
+        most = slot->left;
+        victim = slot.get();
+      }
+    }
+    if( ! victim ) {
+      address.invalidate();
+      return false;
+    }
+    std::unique_lock<std::mutex> lock1(own.mux, std::defer_lock);
+    std::unique_lock<std::mutex> lock2(victim->mux, std::defer_lock);
+    std::lock(lock1, lock2);
+    if( victim->left == 0 ) continue;
+    // victim keeps the first half, one address goes to the thief too
+    CIDRList::_cut(victim->ranges, victim->begin, victim->left / 2, own.ranges);
+    own.begin = 0;
+    own.left = CIDRList::_size(own.ranges, 0);
+    victim->left = victim->left != UINT64_MAX ?
+        victim->left - own.left : CIDRList::_size(victim->ranges, victim->begin);
+  }
 }
 
 } // namespace shared
-
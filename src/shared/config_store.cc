@@ -0,0 +1,297 @@
+/*
+ *
+ * Copyright (C) 2015 Eaton
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*!
+ * \file config_store.cc
+ * \brief ZPL configuration files kept in memory for /config
+ */
+#include "config_store.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "utils_web.h"
+
+namespace utils {
+namespace config {
+
+ConfigStore config_store;
+
+// anything which may replace a file in the directory
+#define CONFIG_STORE_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE \
+                             | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF)
+
+static std::string
+s_dirname (const std::string& path)
+{
+    std::size_t last_slash = path.find_last_of ("/");
+    return last_slash == std::string::npos ? "." : path.substr (0, last_slash);
+}
+
+ConfigStore::ConfigStore (const std::string& root):
+    _root {root},
+    _inotify {-1},
+    _inotify_failed {false},
+    _loads {0}
+{}
+
+ConfigStore::~ConfigStore ()
+{
+    for (auto &it : _files)
+        zconfig_destroy (&it.second.root);
+    if (_inotify != -1)
+        close (_inotify);
+}
+
+bool
+ConfigStore::get (const std::string& key, std::string& value, std::vector <std::string>& array)
+{
+    std::lock_guard<std::mutex> lock (_mux);
+
+    zconfig_t *root = load (_root + get_path (key));
+    if (!root)
+        return false;
+    zconfig_t *item = zconfig_locate (root, get_mapping (key));
+    if (!item)
+        return false;
+
+    value = zconfig_value (item);
+    array.clear ();
+    for (zconfig_t *child = zconfig_child (item); child; child = zconfig_next (child)) {
+        if (!streq (zconfig_value (child), ""))
+            array.push_back (zconfig_value (child));
+    }
+    return true;
+}
+
+void
+ConfigStore::put (const cxxtools::SerializationInfo& si)
+{
+    std::lock_guard<std::mutex> lock (_mux);
+
+    // hand the cached trees of the touched files over to json2zpl, it would
+    // load them from disk otherwise
+    std::map <std::string, zconfig_t*> roots;
+    for (const auto& it : si) {
+        std::string key = it.name ();
+        if (key == "config" && it.category () == cxxtools::SerializationInfo::Object) {
+            const cxxtools::SerializationInfo *legacy_key = it.findMember ("key");
+            if (!legacy_key)
+                continue;
+            legacy_key->getValue (key);
+        }
+        std::string path = get_path (key);
+        if (roots.count (path))
+            continue;
+        zconfig_t *root = load (_root + path);
+        if (!root) {
+            root = zconfig_new ("root", NULL);
+            if (!root)
+                bios_throw ("internal-error", "zconfig_new () failed.");
+            _files [_root + path].root = root;
+        }
+        roots [path] = root;
+    }
+
+    try {
+        json2zpl (roots, si, lock);
+    }
+    catch (...) {
+        // the cached trees may be half way changed, forget them
+        for (auto &it : roots) {
+            auto file = _files.find (_root + it.first);
+            if (file != _files.end () && file->second.root == it.second)
+                _files.erase (file);
+            zconfig_destroy (&it.second);
+        }
+        throw;
+    }
+
+    for (const auto &it : roots) {
+        file_t &file = _files [_root + it.first];
+        if (file.root != it.second) {
+            // json2zpl loaded the file itself
+            zconfig_destroy (&file.root);
+            file.root = it.second;
+        }
+    }
+    try {
+        for (const auto &it : roots)
+            save (_root + it.first, it.second);
+    }
+    catch (...) {
+        // trees of files not saved yet hold changes which are not on disk,
+        // forget all of them, the next lookup loads what was really written
+        for (const auto &it : roots)
+            drop (_root + it.first);
+        throw;
+    }
+
+    // do not load our own writes again
+    read_events ();
+    for (const auto &it : roots)
+        _files [_root + it.first].stale = !watch (_root + it.first);
+}
+
+size_t
+ConfigStore::loads () const
+{
+    std::lock_guard<std::mutex> lock (_mux);
+    return _loads;
+}
+
+zconfig_t *
+ConfigStore::load (const std::string& path)
+{
+    if (_inotify == -1 && !_inotify_failed) {
+        _inotify = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+        if (_inotify == -1) {
+            log_warning ("inotify_init1 () failed: %s, configuration files will be read on every request",
+                         strerror (errno));
+            _inotify_failed = true;
+        }
+    }
+    read_events ();
+
+    auto it = _files.find (path);
+    if (it != _files.end () && !it->second.stale)
+        return it->second.root;
+
+    // watch first, a change right after the load must not get lost
+    bool watched = watch (path);
+    zconfig_t *root = zconfig_load (path.c_str ());
+    _loads++;
+
+    file_t &file = _files [path];
+    zconfig_destroy (&file.root);
+    file.root = root;
+    file.stale = !watched;
+    return root;
+}
+
+void
+ConfigStore::save (const std::string& path, zconfig_t *root)
+{
+    std::string dir = s_dirname (path);
+    if (zsys_dir_create ("%s", dir.c_str ()) != 0) {
+        drop (path);
+        std::string msg = "Cannot create directory " + dir;
+        bios_throw ("internal-error", msg.c_str ());
+    }
+
+    std::string tmp = path + ".tmp";
+    int fd = -1;
+    bool ok = zconfig_save (root, tmp.c_str ()) == 0
+        && (fd = open (tmp.c_str (), O_RDONLY)) != -1
+        && fsync (fd) == 0;
+    if (fd != -1)
+        close (fd);
+
+    struct stat st;
+    if (ok && stat (path.c_str (), &st) == 0)
+        chmod (tmp.c_str (), st.st_mode & 07777);
+
+    if (!ok || rename (tmp.c_str (), path.c_str ()) != 0) {
+        log_error ("saving %s failed: %s", path.c_str (), strerror (errno));
+        unlink (tmp.c_str ());
+        drop (path);
+        std::string msg = "Cannot save config file " + path;
+        bios_throw ("internal-error", msg.c_str ());
+    }
+}
+
+bool
+ConfigStore::watch (const std::string& path)
+{
+    if (_inotify == -1)
+        return false;
+    std::string dir = s_dirname (path);
+    for (const auto &it : _watches) {
+        if (it.second == dir)
+            return true;
+    }
+    int wd = inotify_add_watch (_inotify, dir.c_str (), CONFIG_STORE_EVENTS);
+    if (wd == -1)
+        return false;
+    _watches [wd] = dir;
+    return true;
+}
+
+void
+ConfigStore::read_events ()
+{
+    if (_inotify == -1)
+        return;
+
+    char buffer [4096] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+    for (;;) {
+        ssize_t n = read (_inotify, buffer, sizeof (buffer));
+        if (n <= 0)
+            return;
+
+        for (char *p = buffer; p < buffer + n; ) {
+            const struct inotify_event *event = (const struct inotify_event *) p;
+            p += sizeof (struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                for (auto &it : _files)
+                    it.second.stale = true;
+                continue;
+            }
+            auto watch = _watches.find (event->wd);
+            if (watch == _watches.end ())
+                continue;
+            if (event->len > 0) {
+                auto it = _files.find (watch->second + "/" + event->name);
+                if (it != _files.end ())
+                    it->second.stale = true;
+                continue;
+            }
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                // the directory is gone, files in it are watched again on load
+                std::string dir = watch->second;
+                inotify_rm_watch (_inotify, event->wd);
+                _watches.erase (watch);
+                for (auto &it : _files) {
+                    if (s_dirname (it.first) == dir)
+                        it.second.stale = true;
+                }
+            }
+        }
+    }
+}
+
+void
+ConfigStore::drop (const std::string& path)
+{
+    auto it = _files.find (path);
+    if (it == _files.end ())
+        return;
+    zconfig_destroy (&it->second.root);
+    _files.erase (it);
+}
+
+} // namespace utils::config
+} // namespace utils
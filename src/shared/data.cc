@@ -40,53 +40,6 @@
 
 #include "asset_general.h"
 
-static std::vector<std::tuple <a_elmnt_id_t, std::string, std::string, std::string>>
-s_get_parents (tntdb::Connection &conn, a_elmnt_id_t id)
-{
-
-    std::vector<std::tuple <a_elmnt_id_t, std::string, std::string, std::string>> ret {};
-
-    std::function<void(const tntdb::Row&)> cb = \
-        [&ret](const tntdb::Row &row) {
-
-            // C++ is c r a z y!! Having static initializer in lambda function made
-            // my life easier here, but I did not expected this will work!!
-            static const std::vector <std::tuple <std::string, std::string, std::string, std::string>> NAMES = {\
-                std::make_tuple ("id_parent1", "parent_name1", "id_type_parent1", "id_subtype_parent1"),
-                std::make_tuple ("id_parent2", "parent_name2", "id_type_parent2", "id_subtype_parent2"),
-                std::make_tuple ("id_parent3", "parent_name3", "id_type_parent3", "id_subtype_parent3"),
-                std::make_tuple ("id_parent4", "parent_name4", "id_type_parent4", "id_subtype_parent4"),
-                std::make_tuple ("id_parent5", "parent_name5", "id_type_parent5", "id_subtype_parent5"),
-            };
-
-            for (const auto& it: NAMES) {
-                a_elmnt_id_t id = 0;
-                row [std::get<0> (it)].get (id);
-                std::string name;
-                row [std::get<1> (it)].get (name);
-                a_elmnt_tp_id_t id_type = 0;
-                row [std::get<2> (it)].get (id_type);
-                a_elmnt_stp_id_t id_subtype = 0;
-                row [std::get<3> (it)].get (id_subtype);
-                if (!name.empty ())
-                    ret.push_back (std::make_tuple (
-                        id,
-                        name,
-                        persist::typeid_to_type (id_type),
-                        persist::subtypeid_to_subtype (id_subtype)
-                    ));
-            }
-    };
-
-    int r = persist::select_asset_element_super_parent (conn, id, cb);
-    if (r == -1) {
-        log_error ("select_asset_element_super_parent failed");
-        throw std::runtime_error ("persist::select_asset_element_super_parent () failed.");
-    }
-
-    return ret;
-}
-
 db_reply <db_web_element_t>
     asset_manager::get_item1
         (uint32_t id)
@@ -97,73 +50,32 @@ db_reply <db_web_element_t>
         tntdb::Connection conn = tntdb::connectCached(url);
         log_debug ("connection was successful");
 
-        auto basic_ret = persist::select_asset_element_web_byId(conn, id);
-        log_debug ("1/5 basic select is done");
-
-        if ( basic_ret.status == 0 )
-        {
-            ret.status        = basic_ret.status;
-            ret.errtype       = basic_ret.errtype;
-            ret.errsubtype    = basic_ret.errsubtype;
-            ret.msg           = basic_ret.msg;
-            log_warning ("%s", ret.msg.c_str());
-            return ret;
-        }
-        log_debug ("    1/5 no errors");
-        ret.item.basic = basic_ret.item;
-
-        auto ext_ret = persist::select_ext_attributes(conn, id);
-        log_debug ("2/5 ext select is done");
-
-        if ( ext_ret.status == 0 )
+        // basic info, ext attributes, groups, powers and parents in two queries
+        bool found = false;
+        int r = persist::select_asset_details (conn, {id},
+            [&ret, &found](const db_web_element_t &item)
+            {
+                ret.item = item;
+                found = true;
+            });
+        if ( r != 0 )
         {
-            ret.status        = ext_ret.status;
-            ret.errtype       = ext_ret.errtype;
-            ret.errsubtype    = ext_ret.errsubtype;
-            ret.msg           = ext_ret.msg;
+            ret.status        = 0;
+            ret.errtype       = DB_ERR;
+            ret.errsubtype    = DB_ERROR_INTERNAL;
+            ret.msg           = "select_asset_details failed";
             log_warning ("%s", ret.msg.c_str());
             return ret;
         }
-        log_debug ("    2/5 no errors");
-        ret.item.ext = ext_ret.item;
-
-        auto group_ret = persist::select_asset_element_groups(conn, id);
-        log_debug ("3/5 groups select is done, but next one is only for devices");
-
-        if ( group_ret.status == 0 )
+        if ( !found )
         {
-            ret.status        = group_ret.status;
-            ret.errtype       = group_ret.errtype;
-            ret.errsubtype    = group_ret.errsubtype;
-            ret.msg           = group_ret.msg;
+            ret.status        = 0;
+            ret.errtype       = DB_ERR;
+            ret.errsubtype    = DB_ERROR_NOTFOUND;
+            ret.msg           = "element with specified id was not found";
             log_warning ("%s", ret.msg.c_str());
             return ret;
         }
-        log_debug ("    3/5 no errors");
-        ret.item.groups = group_ret.item;
-
-        if ( ret.item.basic.type_id == persist::asset_type::DEVICE )
-        {
-            auto powers = persist::select_asset_device_links_to (conn, id, INPUT_POWER_CHAIN);
-            log_debug ("4/5 powers select is done");
-
-            if ( powers.status == 0 )
-            {
-                ret.status        = powers.status;
-                ret.errtype       = powers.errtype;
-                ret.errsubtype    = powers.errsubtype;
-                ret.msg           = powers.msg;
-                log_warning ("%s", ret.msg.c_str());
-                return ret;
-            }
-            log_debug ("    4/5 no errors");
-            ret.item.powers = powers.item;
-        }
-
-        // parents select
-        log_debug ("5/5 parents select");
-        ret.item.parents = s_get_parents (conn, id);
-        log_debug ("     5/5 no errors");
 
         ret.status = 1;
         return ret;
@@ -27,6 +27,7 @@
 */
 #include "dbpath.h"
 #include "dbhelpers.h"
+#include "db/assets.h"
 #include "defs.h"
 #include <tntdb/connect.h>
 #include <tntdb/result.h>
@@ -119,53 +120,30 @@ int
 {
     zsys_debug ("container element_id = %" PRIu32, element_id);
 
-    try {
-        std::string select =
-            " SELECT "
-            "   v.name, "
-            "   v.id_asset_element as asset_id, "
-            "   v.id_asset_device_type as subtype_id, "
-            "   v.type_name as subtype_name, "
-            "   v.id_type as type_id "
-            " FROM "
-            "   v_bios_asset_element_super_parent v "
-            " WHERE "
-            "   :containerid in (v.id_parent1, v.id_parent2, v.id_parent3, v.id_parent4, v.id_parent5)";
-        if (!subtypes.empty()) {
-            std::string list;
-            for( auto &id: subtypes) list += std::to_string(id) + ",";
-            select += " and v.id_asset_device_type in (" + list.substr(0,list.size()-1) + ")";
-        }
-        if (!types.empty()) {
-            std::string list;
-            for( auto &id: types) list += std::to_string(id) + ",";
-            select += " and v.id_type in (" + list.substr(0,list.size()-1) + ")";
-        }
-        // Can return more than one row.
-        tntdb::Statement st = conn.prepareCached (select);
-
-        tntdb::Result result = st.set("containerid", element_id).
-                                  select();
-        zsys_debug("[v_bios_asset_element_super_parent]: were selected %" PRIu32 " rows",
-                                                            result.size());
-        for ( auto &row: result ) {
+    std::vector <tntdb::Row> rows;
+    bool found = false;
+    int rv = persist::select_assets_by_container (conn, element_id,
+        std::vector <a_elmnt_tp_id_t> (types.begin (), types.end ()),
+        std::vector <a_elmnt_stp_id_t> (subtypes.begin (), subtypes.end ()),
+        [&rows, &found, &asset_name](const tntdb::Row& row)
+        {
             std::string _asset_name;
             row["name"].get (_asset_name);
-            if (streq (_asset_name.c_str(), asset_name.c_str ()))
-            {
-                for ( auto &row: result ) {
-                    cb(row);
-                }
-                return 0;
-            }
-        }
-
-        return 1;
-    }
-    catch (const std::exception& e) {
-        zsys_error ("Exception caught: select_assets_by_container %s", e.what());
+            if (_asset_name == asset_name)
+                found = true;
+            rows.push_back (row);
+        });
+    if (rv != 0) {
+        zsys_error ("select_assets_by_container failed");
         return -1;
     }
+    if (!found)
+        return 1;
+
+    for ( auto &row: rows ) {
+        cb(row);
+    }
+    return 0;
 }
 
 int
@@ -0,0 +1,188 @@
+/*
+ *
+ * Copyright (C) 2015 Eaton
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*!
+ * \file json_writer.cc
+ * \brief JSON written directly to a stream
+ */
+#include "json_writer.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "utils_web.h"
+
+namespace utils {
+namespace json {
+
+void
+escape (std::ostream& out, const char *string, size_t length)
+{
+    while (length != 0) {
+        // the longest run of bytes copied as is goes out in one write
+        size_t span = escape_span (string, length);
+        if (span != 0)
+            out.write (string, span);
+        string += span;
+        length -= span;
+        if (length != 0) {
+            size_t replacement_length;
+            const char *replacement = escape_replacement (*string, replacement_length);
+            out.write (replacement, replacement_length);
+            ++string;
+            --length;
+        }
+    }
+}
+
+JsonWriter::JsonWriter (std::ostream& out):
+    _out (out),
+    _first {},
+    _after_key {false}
+{}
+
+void
+JsonWriter::separate ()
+{
+    if (_after_key) {
+        _after_key = false;
+        return;
+    }
+    if (_first.empty ())
+        return;
+    if (_first.back ())
+        _first.back () = false;
+    else
+        _out.put (',');
+}
+
+JsonWriter&
+JsonWriter::begin_object ()
+{
+    separate ();
+    _out.put ('{');
+    _first.push_back (true);
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::end_object ()
+{
+    _out.put ('}');
+    _first.pop_back ();
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::begin_array ()
+{
+    separate ();
+    _out.put ('[');
+    _first.push_back (true);
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::end_array ()
+{
+    _out.put (']');
+    _first.pop_back ();
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::key (const char *name, size_t length)
+{
+    separate ();
+    _out.put ('"');
+    escape (_out, name, length);
+    _out.write ("\":", 2);
+    _after_key = true;
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::key (const char *name)
+{
+    return key (name, strlen (name));
+}
+
+JsonWriter&
+JsonWriter::value (const char *string, size_t length)
+{
+    separate ();
+    _out.put ('"');
+    escape (_out, string, length);
+    _out.put ('"');
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::value (const char *string)
+{
+    if (!string)
+        return null ();
+    return value (string, strlen (string));
+}
+
+JsonWriter&
+JsonWriter::value (double number)
+{
+    // inf and nan are not json
+    if (!std::isfinite (number))
+        return null ();
+    separate ();
+    // the same as std::to_string (), DBL_MAX takes 316 characters
+    char buffer [320];
+    int length = snprintf (buffer, sizeof (buffer), "%f", number);
+    _out.write (buffer, length);
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::value (bool boolean)
+{
+    separate ();
+    if (boolean)
+        _out.write ("true", 4);
+    else
+        _out.write ("false", 5);
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::null ()
+{
+    separate ();
+    _out.write ("null", 4);
+    return *this;
+}
+
+JsonWriter&
+JsonWriter::raw (const std::string& json)
+{
+    separate ();
+    _out.write (json.data (), json.size ());
+    return *this;
+}
+
+} // namespace utils::json
+} // namespace utils
@@ -20,11 +20,30 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
 
 #include "log.h"
 #include "utils.h"
 
+/* Maximum number of modules with their own log level */
+#define LOG_MODULES_MAX 32
+/* Maximum length of a module name */
+#define LOG_MODULE_NAME_SIZE 64
+/* Size of per-thread buffer a message is formatted into */
+#define LOG_LINE_SIZE 1024
+/* Number of slots of asynchronous ring buffer, must be a power of two */
+#define LOG_RING_SIZE 4096
+/* Size of a ring slot; longer messages are copied to the heap */
+#define LOG_SLOT_SIZE 256
+/* Size of a block the writer thread flushes at once */
+#define LOG_BATCH_SIZE 65536
+/* How many times the idle writer thread yields before it starts to sleep */
+#define LOG_WRITER_SPIN 64
+
 #define ASSERT_LEVEL \
     assert(level == LOG_DEBUG   || \
            level == LOG_INFO    || \
@@ -39,6 +58,48 @@ static int log_stderr_level = LOG_DEBUG;
 static int log_stderr_level = LOG_WARNING;
 #endif
 static FILE* log_file = NULL;
+int log_max_level = LOG_DEBUG;
+
+/* Per-module levels. Entries are only appended and never removed, so readers
+ * can walk the first log_modules_count entries without locking. */
+typedef struct {
+    char name[LOG_MODULE_NAME_SIZE];
+    int level;
+} log_module_t;
+
+static log_module_t log_modules[LOG_MODULES_MAX];
+static int log_modules_count = 0;
+static pthread_mutex_t log_modules_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Asynchronous logging - a bounded lock-free multi-producer single-consumer
+ * ring (Vyukov's queue). Producers claim a slot by moving log_enqueue_pos,
+ * format the message directly into it and publish it by bumping slot's seq.
+ * The only consumer is the writer thread. An idle writer sleeps on
+ * log_writer_cond, a producer signals it only if log_writer_sleeping is set.
+ * log_async_producers counts producers between the check of
+ * log_async_running and the publication, log_async_stop() waits for them. */
+typedef struct {
+    size_t seq;
+    int len;
+    char *heap;                 /* message which did not fit into data */
+    char data[LOG_SLOT_SIZE];
+} log_slot_t;
+
+static log_slot_t *log_ring = NULL;
+static size_t log_enqueue_pos = 0;
+static size_t log_dequeue_pos = 0;
+static uint64_t log_dropped = 0;
+static uint64_t log_dropped_reported = 0;
+static int log_async_running = 0;
+static int log_async_stopping = 0;
+static int log_async_producers = 0;
+static pthread_t log_writer;
+static pthread_mutex_t log_async_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int log_writer_sleeping = 0;
+static pthread_mutex_t log_writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_writer_cond = PTHREAD_COND_INITIALIZER;
+
+static __thread char log_line[LOG_LINE_SIZE];
 
 extern int errno;
 
@@ -46,6 +107,35 @@ extern int errno;
 static void init_log_file(void) __attribute__((constructor));
 static void init_log_file(void) {
     log_file = stderr;
+    log_max_level = log_stderr_level;
+}
+
+static void s_update_max_level(void) {
+    int max = __atomic_load_n(&log_stderr_level, __ATOMIC_RELAXED);
+    int count = __atomic_load_n(&log_modules_count, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < count; i++) {
+        int level = __atomic_load_n(&log_modules[i].level, __ATOMIC_RELAXED);
+        if (level > max)
+            max = level;
+    }
+    __atomic_store_n(&log_max_level, max, __ATOMIC_RELAXED);
+}
+
+/* Returns non-zero if file (path to a source file) belongs to module */
+static int s_module_match(const char *file, const char *module) {
+    const char *base = strrchr(file, '/');
+    base = base ? base + 1 : file;
+    size_t len = strcspn(base, ".");
+    return strlen(module) == len && strncmp(base, module, len) == 0;
+}
+
+static log_module_t* s_find_module(const char *file) {
+    int count = __atomic_load_n(&log_modules_count, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < count; i++) {
+        if (s_module_match(file, log_modules[i].name))
+            return &log_modules[i];
+    }
+    return NULL;
 }
 
 void log_set_level(int level) {
@@ -53,6 +143,55 @@ void log_set_level(int level) {
     ASSERT_LEVEL;
 
     log_stderr_level = level;
+    pthread_mutex_lock(&log_modules_mutex);
+    s_update_max_level();
+    pthread_mutex_unlock(&log_modules_mutex);
+}
+
+int log_set_module_level(const char *module, int level) {
+
+    ASSERT_LEVEL;
+
+    int r = 0;
+    pthread_mutex_lock(&log_modules_mutex);
+    log_module_t *m = NULL;
+    for (int i = 0; i < log_modules_count; i++) {
+        if (strcmp(log_modules[i].name, module) == 0) {
+            m = &log_modules[i];
+            break;
+        }
+    }
+    if (m) {
+        __atomic_store_n(&m->level, level, __ATOMIC_RELAXED);
+    }
+    else if (log_modules_count < LOG_MODULES_MAX && strlen(module) < LOG_MODULE_NAME_SIZE) {
+        m = &log_modules[log_modules_count];
+        strcpy(m->name, module);
+        m->level = level;
+        __atomic_store_n(&log_modules_count, log_modules_count + 1, __ATOMIC_RELEASE);
+    }
+    else {
+        r = -1;
+    }
+    s_update_max_level();
+    pthread_mutex_unlock(&log_modules_mutex);
+    return r;
+}
+
+int log_get_module_level(const char *module) {
+    int count = __atomic_load_n(&log_modules_count, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < count; i++) {
+        if (strcmp(log_modules[i].name, module) == 0)
+            return __atomic_load_n(&log_modules[i].level, __ATOMIC_RELAXED);
+    }
+    return log_get_level();
+}
+
+int log_module_enabled(int level, const char *file) {
+    log_module_t *m = s_find_module(file);
+    if (m)
+        return level <= __atomic_load_n(&m->level, __ATOMIC_RELAXED);
+    return level <= log_get_level();
 }
 
 int log_get_level() {
@@ -67,31 +206,277 @@ void log_set_file(FILE* file) {
     log_file = file;
 }
 
+/* Converts level name like LOG_DEBUG to its value, returns -1 if unknown */
+static int s_parse_level(const char *name, size_t len) {
+    static const struct { const char *name; int level; } levels[] = {
+        { STR(LOG_DEBUG), LOG_DEBUG },
+        { STR(LOG_INFO), LOG_INFO },
+        { STR(LOG_WARNING), LOG_WARNING },
+        { STR(LOG_ERR), LOG_ERR },
+        { STR(LOG_CRIT), LOG_CRIT },
+    };
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+        if (strlen(levels[i].name) == len && strncmp(name, levels[i].name, len) == 0)
+            return levels[i].level;
+    }
+    return -1;
+}
+
+/* Parses "module:LEVEL,module:LEVEL" and sets module levels */
+static void s_parse_modules(const char *spec) {
+    while (*spec) {
+        size_t len = strcspn(spec, ",");
+        const char *colon = memchr(spec, ':', len);
+        if (colon && colon != spec && (size_t) (colon - spec) < LOG_MODULE_NAME_SIZE) {
+            char module[LOG_MODULE_NAME_SIZE];
+            memcpy(module, spec, colon - spec);
+            module[colon - spec] = '\0';
+            int level = s_parse_level(colon + 1, spec + len - colon - 1);
+            if (level != -1)
+                log_set_module_level(module, level);
+        }
+        spec += len;
+        if (*spec == ',')
+            spec++;
+    }
+}
+
 void log_open() {
 
     char *ev_log_level = getenv("BIOS_LOG_LEVEL");
+    char *ev_log_modules = getenv("BIOS_LOG_MODULES");
+    char *ev_log_async = getenv("BIOS_LOG_ASYNC");
+
+    if (ev_log_async && (strcmp(ev_log_async, "yes") == 0 || strcmp(ev_log_async, "1") == 0)) {
+        log_async_start();
+    }
+
+    if (ev_log_modules) {
+        s_parse_modules(ev_log_modules);
+    }
 
     if (ev_log_level) {
-        int log_level;
-        if (strcmp(ev_log_level, STR(LOG_DEBUG)) == 0) {
-            log_level = LOG_DEBUG;
+        int log_level = s_parse_level(ev_log_level, strlen(ev_log_level));
+        if (log_level != -1)
+            log_set_level(log_level);
+    }
+}
+
+/* Formats the whole log line including the trailing newline into buffer.
+ * When it does not fit, the line is formatted into *heap instead, which must
+ * be freed by the caller. Returns the length of the line or -1 on error. */
+static int s_format(
+        char *buffer,
+        size_t size,
+        char **heap,
+        const char *prefix,
+        const char* file,
+        int line,
+        const char* func,
+        const char* format,
+        va_list args) {
+
+    va_list args2;
+    int n, m;
+
+    *heap = NULL;
+    n = snprintf(buffer, size, "[%s]: %s:%d (%s) ", prefix, file, line, func);
+    if (n < 0)
+        return -1;
+
+    va_copy(args2, args);
+    if ((size_t) n < size)
+        m = vsnprintf(buffer + n, size - n, format, args2);
+    else
+        m = vsnprintf(NULL, 0, format, args2);
+    va_end(args2);
+    if (m < 0)
+        return -1;
+
+    // one byte for newline, one for terminating zero
+    if ((size_t) (n + m + 2) <= size) {
+        buffer[n + m] = '\n';
+        buffer[n + m + 1] = '\0';
+        return n + m + 1;
+    }
+
+    *heap = (char*) malloc(n + m + 2);
+    if (!*heap)
+        return -1;
+    snprintf(*heap, n + 1, "[%s]: %s:%d (%s) ", prefix, file, line, func);
+    vsnprintf(*heap + n, m + 1, format, args);
+    (*heap)[n + m] = '\n';
+    (*heap)[n + m + 1] = '\0';
+    return n + m + 1;
+}
+
+/* Claims a free slot of the ring, returns NULL if the ring is full */
+static log_slot_t* s_ring_claim(size_t *pos_p) {
+    size_t pos = __atomic_load_n(&log_enqueue_pos, __ATOMIC_RELAXED);
+
+    for (;;) {
+        log_slot_t *slot = &log_ring[pos & (LOG_RING_SIZE - 1)];
+        size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        intptr_t dif = (intptr_t) seq - (intptr_t) pos;
+
+        if (dif == 0) {
+            if (__atomic_compare_exchange_n(&log_enqueue_pos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                *pos_p = pos;
+                return slot;
+            }
         }
-        else if (strcmp(ev_log_level, STR(LOG_INFO)) == 0) {
-            log_level = LOG_INFO;
+        else if (dif < 0) {
+            return NULL;
         }
-        else if (strcmp(ev_log_level, STR(LOG_WARNING)) == 0) {
-            log_level = LOG_WARNING;
+        else {
+            pos = __atomic_load_n(&log_enqueue_pos, __ATOMIC_RELAXED);
         }
-        else if (strcmp(ev_log_level, STR(LOG_ERR)) == 0) {
-            log_level = LOG_ERR;
+    }
+}
+
+/* Returns non-zero if the next message of the ring is published */
+static int s_ring_ready(void) {
+    log_slot_t *slot = &log_ring[log_dequeue_pos & (LOG_RING_SIZE - 1)];
+    return __atomic_load_n(&slot->seq, __ATOMIC_SEQ_CST) == log_dequeue_pos + 1;
+}
+
+/* Wakes the writer thread up if it sleeps. The message must be published
+ * with __ATOMIC_SEQ_CST: s_log_writer sets log_writer_sleeping and then
+ * checks the ring, so either the writer sees the message or we see it sleep. */
+static void s_writer_wake(void) {
+    if (!__atomic_load_n(&log_writer_sleeping, __ATOMIC_SEQ_CST))
+        return;
+    pthread_mutex_lock(&log_writer_mutex);
+    pthread_cond_signal(&log_writer_cond);
+    pthread_mutex_unlock(&log_writer_mutex);
+}
+
+/* Writes out everything published in the ring so far, in LOG_BATCH_SIZE
+ * blocks. Only one thread may call it at a time. Returns number of lines. */
+static size_t s_ring_drain(void) {
+    static char batch[LOG_BATCH_SIZE];
+    size_t used = 0;
+    size_t count = 0;
+    FILE *file = log_file;
+
+    uint64_t dropped = __atomic_load_n(&log_dropped, __ATOMIC_RELAXED);
+    if (dropped != log_dropped_reported) {
+        fprintf(file, "[WARNING]: %s:%d (%s) log ring buffer full, %" PRIu64 " messages dropped\n",
+                __FILE__, __LINE__, __func__, dropped - log_dropped_reported);
+        log_dropped_reported = dropped;
+    }
+
+    for (;;) {
+        log_slot_t *slot = &log_ring[log_dequeue_pos & (LOG_RING_SIZE - 1)];
+        size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq != log_dequeue_pos + 1)
+            break;
+
+        const char *line = slot->heap ? slot->heap : slot->data;
+        size_t len = (size_t) slot->len;
+        if (used + len > LOG_BATCH_SIZE) {
+            fwrite(batch, 1, used, file);
+            used = 0;
         }
-        else if (strcmp(ev_log_level, STR(LOG_CRIT)) == 0) {
-            log_level = LOG_CRIT;
-        } else {
-            return;
+        if (len > LOG_BATCH_SIZE)
+            fwrite(line, 1, len, file);
+        else {
+            memcpy(batch + used, line, len);
+            used += len;
         }
-        log_set_level(log_level);
+        free(slot->heap);
+        slot->heap = NULL;
+
+        __atomic_store_n(&slot->seq, log_dequeue_pos + LOG_RING_SIZE, __ATOMIC_RELEASE);
+        log_dequeue_pos++;
+        count++;
     }
+
+    if (used > 0)
+        fwrite(batch, 1, used, file);
+    if (count > 0)
+        fflush(file);
+    return count;
+}
+
+static void* s_log_writer(void *arg) {
+    int idle = 0;
+    (void) arg;
+    for (;;) {
+        int stopping = __atomic_load_n(&log_async_stopping, __ATOMIC_ACQUIRE);
+        if (s_ring_drain() > 0) {
+            idle = 0;
+            continue;
+        }
+        if (stopping)
+            break;
+        // stay responsive during bursts, but do not burn CPU when quiet
+        if (idle++ < LOG_WRITER_SPIN) {
+            sched_yield();
+            continue;
+        }
+        pthread_mutex_lock(&log_writer_mutex);
+        __atomic_store_n(&log_writer_sleeping, 1, __ATOMIC_SEQ_CST);
+        while (!s_ring_ready() && !__atomic_load_n(&log_async_stopping, __ATOMIC_SEQ_CST))
+            pthread_cond_wait(&log_writer_cond, &log_writer_mutex);
+        __atomic_store_n(&log_writer_sleeping, 0, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&log_writer_mutex);
+        idle = 0;
+    }
+    return NULL;
+}
+
+int log_async_start() {
+    int r = 0;
+
+    pthread_mutex_lock(&log_async_mutex);
+    if (log_async_running)
+        goto end;
+
+    if (!log_ring) {
+        log_ring = (log_slot_t*) calloc(LOG_RING_SIZE, sizeof(log_slot_t));
+        if (!log_ring) {
+            r = -1;
+            goto end;
+        }
+        for (size_t i = 0; i < LOG_RING_SIZE; i++)
+            log_ring[i].seq = i;
+        atexit(log_async_stop);
+    }
+
+    __atomic_store_n(&log_async_stopping, 0, __ATOMIC_RELEASE);
+    if (pthread_create(&log_writer, NULL, s_log_writer, NULL) != 0) {
+        r = -1;
+        goto end;
+    }
+    __atomic_store_n(&log_async_running, 1, __ATOMIC_RELEASE);
+
+end:
+    pthread_mutex_unlock(&log_async_mutex);
+    return r;
+}
+
+void log_async_stop() {
+    pthread_mutex_lock(&log_async_mutex);
+    if (log_async_running) {
+        // new messages go the synchronous way, the ones being put into the
+        // ring are waited for, so the writer sees all of them before it ends
+        __atomic_store_n(&log_async_running, 0, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&log_async_producers, __ATOMIC_SEQ_CST) != 0)
+            sched_yield();
+
+        pthread_mutex_lock(&log_writer_mutex);
+        __atomic_store_n(&log_async_stopping, 1, __ATOMIC_SEQ_CST);
+        pthread_cond_signal(&log_writer_cond);
+        pthread_mutex_unlock(&log_writer_mutex);
+        pthread_join(log_writer, NULL);
+    }
+    pthread_mutex_unlock(&log_async_mutex);
+}
+
+uint64_t log_get_dropped() {
+    return __atomic_load_n(&log_dropped, __ATOMIC_RELAXED);
 }
 
 static int do_logv(
@@ -102,13 +487,11 @@ static int do_logv(
         const char* format,
         va_list args) {
 
-    char *prefix;
-    char *fmt;
-    char *buffer;
-
+    const char *prefix;
+    char *heap;
     int r;
 
-    if (level > log_get_level()) {
+    if (!log_is_enabled(level, file)) {
         //no-op if logging disabled
         return 0;
     }
@@ -129,24 +512,40 @@ static int do_logv(
             return -1;
     };
 
-    r = asprintf(&fmt, "[%s]: %s:%d (%s) %s", prefix, file, line, func, format);
-    if (r == -1) {
-        fprintf(log_file, "[ERROR]: %s:%d (%s) can't allocate enough memory for format string: %m", __FILE__, __LINE__, __func__);
-        return r;
+    if (__atomic_load_n(&log_async_running, __ATOMIC_RELAXED)) {
+        __atomic_add_fetch(&log_async_producers, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&log_async_running, __ATOMIC_SEQ_CST)) {
+            size_t pos;
+            log_slot_t *slot = s_ring_claim(&pos);
+            if (!slot) {
+                __atomic_sub_fetch(&log_async_producers, 1, __ATOMIC_RELEASE);
+                __atomic_add_fetch(&log_dropped, 1, __ATOMIC_RELAXED);
+                return 0;
+            }
+            r = s_format(slot->data, LOG_SLOT_SIZE, &slot->heap, prefix, file, line, func, format, args);
+            // a claimed slot must be published in any case, so write empty line
+            slot->len = r < 0 ? 0 : r;
+            __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_SEQ_CST);
+            __atomic_sub_fetch(&log_async_producers, 1, __ATOMIC_RELEASE);
+            s_writer_wake();
+            if (r == -1) {
+                fprintf(log_file, "[ERROR]: %s:%d (%s) can't format message: %m\n", __FILE__, __LINE__, __func__);
+                return r;
+            }
+            return 0;
+        }
+        // log_async_stop () is in progress
+        __atomic_sub_fetch(&log_async_producers, 1, __ATOMIC_RELEASE);
     }
 
-    r = vasprintf(&buffer, fmt, args);
-    free(fmt);   // we don't need it in any case
+    r = s_format(log_line, LOG_LINE_SIZE, &heap, prefix, file, line, func, format, args);
     if (r == -1) {
         fprintf(log_file, "[ERROR]: %s:%d (%s) can't allocate enough memory for message string: %m", __FILE__, __LINE__, __func__);
         return r;
     }
 
-    if (level <= log_stderr_level) {
-        fputs(buffer, log_file);
-        fputc('\n', log_file);
-    }
-    free(buffer);
+    fwrite(heap ? heap : log_line, 1, r, log_file);
+    free(heap);
 
     return 0;
 
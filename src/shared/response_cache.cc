@@ -0,0 +1,218 @@
+/*
+ *
+ * Copyright (C) 2015 Eaton
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*!
+ * \file response_cache.cc
+ * \brief Bounded LRU cache of rendered REST responses
+ */
+#include "response_cache.h"
+
+#include "log.h"
+
+ResponseCache topology_cache;
+
+ResponseCache::Ticket::Ticket (ResponseCache *cache, const std::string& key, uint64_t generation, Value value):
+    _cache {cache},
+    _key {key},
+    _generation {generation},
+    _value {value}
+{}
+
+ResponseCache::Ticket::Ticket (Ticket&& other):
+    _cache {other._cache},
+    _key {std::move (other._key)},
+    _generation {other._generation},
+    _value {std::move (other._value)}
+{
+    other._cache = nullptr;
+}
+
+ResponseCache::Ticket::~Ticket ()
+{
+    if (_cache)
+        _cache->release (_key, _generation);
+}
+
+const std::string&
+ResponseCache::Ticket::fill (std::string&& response)
+{
+    _value = std::make_shared<const std::string> (std::move (response));
+    if (_cache) {
+        _cache->store (_key, _generation, _value);
+        _cache = nullptr;
+    }
+    return *_value;
+}
+
+ResponseCache::ResponseCache (size_t max_entries, size_t max_bytes, std::chrono::steady_clock::duration max_age):
+    _max_entries {max_entries},
+    _max_bytes {max_bytes},
+    _max_age {max_age},
+    _generation {0},
+    _stats {0, 0, 0, 0, 0, 0, 0}
+{}
+
+ResponseCache::Ticket
+ResponseCache::acquire (const std::string& key, uint64_t generation)
+{
+    std::unique_lock<std::mutex> lock (_mux);
+
+    if (generation > _generation) {
+        // renders of the old generation will not be stored, do not wait for them
+        _entries.clear ();
+        _lru.clear ();
+        _pending.clear ();
+        _stats.bytes = 0;
+        _generation = generation;
+        _cond.notify_all ();
+    }
+    else
+    if (generation < _generation) {
+        // the model changed while the caller was on its way, do not cache
+        ++_stats.misses;
+        return Ticket {nullptr, key, generation, nullptr};
+    }
+
+    bool waited = false;
+    while (true) {
+        auto it = _entries.find (key);
+        if (it != _entries.end ()
+            && std::chrono::steady_clock::now ().time_since_epoch () / _max_age
+               != it->second.stored.time_since_epoch () / _max_age) {
+            // may be changed by somebody else meanwhile
+            _stats.bytes -= it->second.value->size ();
+            _lru.erase (it->second.lru);
+            _entries.erase (it);
+            ++_stats.expirations;
+            it = _entries.end ();
+        }
+        if (it != _entries.end () && _generation == generation) {
+            _lru.splice (_lru.begin (), _lru, it->second.lru);
+            ++_stats.hits;
+            return Ticket {nullptr, key, generation, it->second.value};
+        }
+        if (_generation != generation || _pending.count (key) == 0)
+            break;
+        if (!waited) {
+            ++_stats.waits;
+            waited = true;
+        }
+        _cond.wait (lock);
+    }
+
+    ++_stats.misses;
+    if (_generation != generation)
+        return Ticket {nullptr, key, generation, nullptr};
+    _pending.insert (key);
+    return Ticket {this, key, generation, nullptr};
+}
+
+void
+ResponseCache::store (const std::string& key, uint64_t generation, Value value)
+{
+    std::lock_guard<std::mutex> lock (_mux);
+
+    if (generation != _generation)
+        return;
+    _pending.erase (key);
+    _cond.notify_all ();
+
+    if (value->size () > _max_bytes)
+        return;
+
+    auto it = _entries.find (key);
+    if (it != _entries.end ()) {
+        _stats.bytes -= it->second.value->size ();
+        _lru.erase (it->second.lru);
+        _entries.erase (it);
+    }
+    _lru.push_front (key);
+    _entries [key] = entry_t {value, _lru.begin (), std::chrono::steady_clock::now ()};
+    _stats.bytes += value->size ();
+    evict ();
+
+    log_debug ("response cache: stored '%s' (%zu B), %zu entries, %zu B, hit rate %.2f",
+            key.c_str (), value->size (), _entries.size (), _stats.bytes, _stats.hit_rate ());
+}
+
+void
+ResponseCache::release (const std::string& key, uint64_t generation)
+{
+    std::lock_guard<std::mutex> lock (_mux);
+    if (generation != _generation)
+        return;
+    _pending.erase (key);
+    _cond.notify_all ();
+}
+
+void
+ResponseCache::evict ()
+{
+    while (!_lru.empty () && (_entries.size () > _max_entries || _stats.bytes > _max_bytes)) {
+        auto it = _entries.find (_lru.back ());
+        _stats.bytes -= it->second.value->size ();
+        _entries.erase (it);
+        _lru.pop_back ();
+        ++_stats.evictions;
+    }
+}
+
+ResponseCache::Stats
+ResponseCache::stats () const
+{
+    std::lock_guard<std::mutex> lock (_mux);
+    Stats ret = _stats;
+    ret.entries = _entries.size ();
+    return ret;
+}
+
+void
+ResponseCache::clear ()
+{
+    std::lock_guard<std::mutex> lock (_mux);
+    _entries.clear ();
+    _lru.clear ();
+    _stats.bytes = 0;
+}
+
+std::string
+response_cache_key (const std::string& endpoint, const std::map<std::string, std::string>& params)
+{
+    std::string key = endpoint;
+    char separator = '?';
+    for (const auto& it : params) {
+        key += separator;
+        key += it.first;
+        key += '=';
+        // values come from the user, keep them from forging other parameters
+        for (const char c : it.second) {
+            if (c == '%' || c == '&' || c == '=') {
+                static const char hex[] = "0123456789ABCDEF";
+                key += '%';
+                key += hex [(unsigned char) c >> 4];
+                key += hex [(unsigned char) c & 0x0f];
+            }
+            else
+                key += c;
+        }
+        separator = '&';
+    }
+    return key;
+}
@@ -27,28 +27,30 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <algorithm>
 
 #include <sys/types.h>
+#include <sys/syscall.h>
 #include <signal.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <unistd.h>
-#include <czmq.h>
+#include <poll.h>
+#include <time.h>
+
+// pidfd_open(2) is in Linux 5.3+, older kernels and libc make us fall back
+// to periodic waitpid
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open 434
+#endif
 
 namespace shared {
 
 // forward declaration of helper functions
 // TODO: move somewhere else
 
-// small internal structure to be passed to callbacks
-struct sbp_info_t {
-    uint64_t timeout;
-    uint64_t now;
-    SubProcess *proc_p;
-    std::stringstream &buff;
-};
+//! how long a process has to exit after SIGTERM before it gets SIGKILL [ms]
+static const int KILL_GRACE_MS = 2000;
 
 char * const * _mk_argv(const Argv& vec);
-static int s_output(SubProcess& p, std::string& o, std::string& e, uint64_t timeout, size_t timestep);
-static int s_output2(SubProcess& p, std::string& o, uint64_t timeout, size_t timestep);
+static int s_output(SubProcess& p, const OutputCallback& out_cb, const OutputCallback& err_cb, uint64_t timeout, size_t timestep);
 
 
 SubProcess::SubProcess(Argv cxx_argv, int flags) :
@@ -266,14 +268,20 @@ int call(const Argv& args) {
     return p.wait();
 }
 
+// string outputs are C-strings as they always were, so the chunk ends at NUL
+static OutputCallback s_append_to(std::string& s) {
+    s.clear();
+    return [&s](const char* data, size_t size) { s.append(data, strnlen(data, size)); };
+}
+
 int output(const Argv& args, std::string& o, std::string& e, uint64_t timeout, size_t timestep) {
     SubProcess p(args, SubProcess::STDOUT_PIPE | SubProcess::STDERR_PIPE);
-    return s_output (p, o, e, timeout, timestep);
+    return s_output (p, s_append_to (o), s_append_to (e), timeout, timestep);
 }
 
 int output2(const Argv& args, std::string& o, uint64_t timeout, size_t timestep) {
     SubProcess p(args, SubProcess::STDOUT_PIPE);
-    return s_output2 (p, o, timeout, timestep);
+    return s_output (p, s_append_to (o), nullptr, timeout, timestep);
 }
 
 int output(const Argv& args, std::string& o, std::string& e, const std::string& i, uint64_t timeout, size_t timestep) {
@@ -282,7 +290,12 @@ int output(const Argv& args, std::string& o, std::string& e, const std::string&
     ::write(p.getStdin(), i.c_str(), i.size());
     ::fsync(p.getStdin());
     ::close(p.getStdin());
-    return s_output (p, o, e, timeout, timestep);
+    return s_output (p, s_append_to (o), s_append_to (e), timeout, timestep);
+}
+
+int output_stream(const Argv& args, const OutputCallback& out_cb, std::string& e, uint64_t timeout) {
+    SubProcess p(args, SubProcess::STDOUT_PIPE | SubProcess::STDERR_PIPE);
+    return s_output (p, out_cb, s_append_to (e), timeout, 500);
 }
 
 std::string wait_read_all(int fd) {
@@ -345,138 +358,138 @@ char * const * _mk_argv(const Argv& vec) {
     return (char * const*)argv;
 }
 
-/*  ZLOOP AND PROPER TIMEOUT SUPPORT */
+/*  EVENT DRIVEN OUTPUT COLLECTION AND PROPER TIMEOUT SUPPORT */
 
-// add file descriptor to zloop
-static int
-xzloop_add_fd (zloop_t *self, int fd, zloop_fn handler, void *arg)
+static int64_t
+s_now_ms ()
 {
-    assert (self);
-    zmq_pollitem_t *fditem = (zmq_pollitem_t*) zmalloc (sizeof (zmq_pollitem_t));
-    assert (fditem);
-    fditem->fd = fd;
-    fditem->events = ZMQ_POLLIN;
-
-    int r = zloop_poller (self, fditem, handler, arg);
-    free (fditem);
-    return r;
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
-// handle incoming data on fd
+// file descriptor which becomes readable once the process exits, or -1
 static int
-s_handler (zloop_t *loop, zmq_pollitem_t *item, void *arg)
+s_pidfd_open (pid_t pid)
 {
-    assert (loop); //remove compiler warning
-    struct sbp_info_t *i = (struct sbp_info_t*) arg;
-
-    //XXX: read_all is not a good idea for write intensive processes (like ping)
-    //     because s_handler won't return - so lets read only PIPE_BUF and exit
-    char buf[PIPE_BUF+1];
-    memset(buf, '\0', PIPE_BUF+1);
-    ::read(item->fd, buf, PIPE_BUF);
-    i->buff << buf;
-
-    return 0;
+    return (int) ::syscall (__NR_pidfd_open, pid, 0);
 }
 
-// ping the process
-static int
-s_ping_process (UNUSED_PARAM zloop_t *loop, UNUSED_PARAM int timer_id, void *args)
+// read what is available on fd, but at most PIPE_BUF unless all is true, so
+// write intensive processes (like ping) won't starve the other descriptors
+// and the timeout check; returns false on EOF or error
+static bool
+s_read_available (int fd, const OutputCallback& cb, bool all = false)
 {
-    assert (loop); //remove compiler warning
-    struct sbp_info_t *i = (struct sbp_info_t*) args;
-
-    if (zsys_interrupted)   // end the loop when signal is delivered
-        return -1;
-
-    i->proc_p->poll ();
-    if (!i->proc_p->isRunning ())
-        return -1;
-    return 0;
+    char buf[PIPE_BUF];
+    while (true) {
+        ssize_t r = ::read (fd, buf, sizeof (buf));
+        if (r > 0) {
+            if (cb)
+                cb (buf, r);
+            if (!all || (size_t) r < sizeof (buf))
+                return true;
+            continue;
+        }
+        if (r == -1 && errno == EINTR)
+            continue;
+        return r == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
 }
 
-// stop the loop
-static int
-s_end_loop (UNUSED_PARAM zloop_t *loop, UNUSED_PARAM int timer_id, UNUSED_PARAM void *args)
+// wait till process exits, but at most timeout_ms; returns true if it did
+static bool
+s_wait_exit (SubProcess& p, int pidfd, int timeout_ms)
 {
-    return -1;
+    int64_t deadline = s_now_ms () + timeout_ms;
+    while (p.isRunning ()) {
+        int64_t left = deadline - s_now_ms ();
+        if (left <= 0)
+            return false;
+        if (pidfd != -1) {
+            struct pollfd pfd {pidfd, POLLIN, 0};
+            ::poll (&pfd, 1, (int) left);
+        }
+        else
+            // no pidfd, the best we can do is to check often
+            ::poll (NULL, 0, (int) std::min <int64_t> (left, 10));
+    }
+    return true;
 }
 
-static int s_output(SubProcess& p, std::string& o, std::string& e, uint64_t timeout, size_t timestep)
+// Runs the process and passes its stdout/stderr to callbacks as they come,
+// sleeping in poll(2) until there is output, process exits or timeout [s]
+// expires. Exit is detected via pidfd, only if that is not supported by the
+// kernel the process is checked every timestep [ms].
+static int s_output(SubProcess& p, const OutputCallback& out_cb, const OutputCallback& err_cb, uint64_t timeout, size_t timestep)
 {
-    std::stringstream out;
-    std::stringstream err;
-
-    sbp_info_t out_info {timeout * 1000, (uint64_t) zclock_mono (), &p, out};
-    sbp_info_t err_info {timeout * 1000, (uint64_t) zclock_mono (), &p, err};
-
     p.run();
 
-    zloop_t *loop = zloop_new ();
-    assert (loop);
+    int fds[2] = { p.getStdout (), p.getStderr () };
+    const OutputCallback* cbs[2] = { &out_cb, &err_cb };
+    for (auto fd : fds) {
+        if (fd >= 0)
+            fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+    }
 
-    if (timeout != 0)
-        zloop_timer (loop, timeout * 1000, 1, s_end_loop, NULL);
-    zloop_timer (loop, timestep, 0, s_ping_process, &out_info);
-    xzloop_add_fd (loop, p.getStdout (), s_handler, &out_info);
-    xzloop_add_fd (loop, p.getStderr (), s_handler, &err_info);
-    zloop_start (loop);
+    int pidfd = s_pidfd_open (p.getPid ());
+    int64_t deadline = timeout != 0 ? s_now_ms () + (int64_t) timeout * 1000 : -1;
+
+    while (p.isRunning ()) {
+        struct pollfd pfds[3];
+        int idx[3];
+        nfds_t n = 0;
+        for (int i = 0; i != 2; i++) {
+            if (fds[i] < 0)
+                continue;
+            pfds[n] = {fds[i], POLLIN, 0};
+            idx[n++] = i;
+        }
+        if (pidfd != -1) {
+            pfds[n] = {pidfd, POLLIN, 0};
+            idx[n++] = -1;
+        }
 
-    zloop_destroy (&loop);
+        int wait_ms = -1;
+        if (deadline != -1) {
+            int64_t left = deadline - s_now_ms ();
+            if (left <= 0)
+                break;
+            wait_ms = (int) left;
+        }
+        if (pidfd == -1 && (wait_ms == -1 || (size_t) wait_ms > timestep))
+            wait_ms = (int) timestep;
 
-    int r = p.poll ();
-    if (p.isRunning ()) {
-        p.kill ();
-        r = p.poll ();
-        if (p.isRunning ()) {
-            zclock_sleep (2000);
-            p.terminate ();
-            r = p.poll ();
+        int r = ::poll (pfds, n, wait_ms);
+        if (r == -1 && errno != EINTR)
+            break;
+        for (nfds_t i = 0; r > 0 && i != n; i++) {
+            if (idx[i] == -1 || pfds[i].revents == 0)
+                continue;
+            if (!s_read_available (fds[idx[i]], *cbs[idx[i]]))
+                // EOF, the process closed the pipe
+                fds[idx[i]] = -1;
         }
     }
 
-    out << read_all (p.getStdin ());
-    err << read_all (p.getStderr ());
-
-    o.assign(out.str ());
-    e.assign(err.str ());
-    return r;
-}
-
-static int s_output2(SubProcess& p, std::string& o, uint64_t timeout, size_t timestep)
-{
-    std::stringstream out;
-
-    sbp_info_t out_info {timeout * 1000, (uint64_t) zclock_mono (), &p, out};
-
-    p.run();
-
-    zloop_t *loop = zloop_new ();
-    assert (loop);
-
-    if (timeout != 0)
-        zloop_timer (loop, timeout * 1000, 1, s_end_loop, NULL);
-    zloop_timer (loop, timestep, 0, s_ping_process, &out_info);
-    xzloop_add_fd (loop, p.getStdout (), s_handler, &out_info);
-    zloop_start (loop);
-
-    zloop_destroy (&loop);
-
-    int r = p.poll ();
+    int ret = p.poll ();
     if (p.isRunning ()) {
         p.kill ();
-        r = p.poll ();
-        if (p.isRunning ()) {
-            zclock_sleep (2000);
+        if (!s_wait_exit (p, pidfd, KILL_GRACE_MS))
             p.terminate ();
-            r = p.poll ();
-        }
+        ret = p.poll ();
     }
+    if (pidfd != -1)
+        ::close (pidfd);
 
-    out << read_all (p.getStdin ());
+    // the rest of output which came after the last poll
+    for (int i = 0; i != 2; i++) {
+        if (fds[i] >= 0)
+            s_read_available (fds[i], *cbs[i], true);
+    }
 
-    o.assign(out.str ());
-    return r;
+    return ret;
 }
+
 } //namespace shared
 
@@ -17,6 +17,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  *
  */
+#include <cstdio>
 #include <cstring>
 #include <ostream>
 #include <limits>
@@ -26,10 +27,64 @@
 #include <cxxtools/regex.h>
 #include <cxxtools/serializationinfo.h>
 #include <cxxtools/split.h>
+#if defined (__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "subprocess.h"
 
 #include "utils_web.h"
 
+// .message of every _errors entry split at %s
+struct die_template_t {
+    std::vector <std::pair <const char*, size_t>> pieces;   // literal text around the %s
+    size_t length;                                          // of all pieces
+};
+
+static const std::array <die_template_t, _WSErrorsCOUNT>&
+s_die_templates ()
+{
+    static const std::array <die_template_t, _WSErrorsCOUNT> templates = [] {
+        std::array <die_template_t, _WSErrorsCOUNT> result;
+        for (size_t idx = 0; idx != _WSErrorsCOUNT; ++idx) {
+            die_template_t &t = result [idx];
+            t.length = 0;
+            // unused slots at the end of _errors have no message
+            const char *piece = _errors.at (idx).message ? _errors.at (idx).message : "";
+            const char *next;
+            while ((next = strstr (piece, "%s"))) {
+                t.pieces.emplace_back (piece, next - piece);
+                t.length += next - piece;
+                piece = next + 2;
+            }
+            t.pieces.emplace_back (piece, strlen (piece));
+            t.length += strlen (piece);
+        }
+        return result;
+    } ();
+    return templates;
+}
+
+std::string
+_die_format_args (size_t idx, const _WSErrorArg *args, size_t count)
+{
+    const die_template_t &t = s_die_templates ().at (idx);
+    size_t placeholders = t.pieces.size () - 1;
+
+    size_t length = t.length;
+    for (size_t i = 0; i < placeholders && i < count; ++i)
+        length += args [i].size;
+
+    std::string message;
+    message.reserve (length);
+    message.append (t.pieces [0].first, t.pieces [0].second);
+    for (size_t i = 0; i != placeholders; ++i) {
+        if (i < count)
+            message.append (args [i].text (), args [i].size);
+        message.append (t.pieces [i + 1].first, t.pieces [i + 1].second);
+    }
+    return message;
+}
+
 namespace utils {
 
 uint32_t
@@ -49,14 +104,6 @@ string_to_element_id (const std::string& string) {
 
 namespace json {    
 
-std::string escape (const char *string) {
-    if (!string)
-        return "(null_ptr)";
-
-    std::string after;
-    std::string::size_type length = strlen (string);
-    after.reserve (length * 2);
-
 /*
     Quote from http://www.json.org/
     -------------------------------
@@ -72,35 +119,122 @@ std::string escape (const char *string) {
         \t
         \u four-hex-digits 
     ------------------------------
+
+    Note that \b, \f, \n, \r and \t are written with the backslash escaped,
+    that is what the pages and their clients expect. Other control
+    characters are written as \u00XX.
 */
 
-    for (std::string::size_type i = 0; i < length; ++i) {
-        char c = string[i];
-        if (c == '"') {
-            after.append ("\\\"");
-        }
-        else if (c =='\b') {
-            after.append ("\\\\b");
-        }
-        else if (c =='\f') {
-            after.append ("\\\\f");
-        }
-        else if (c == '\n') {
-            after.append ("\\\\n");
-        }
-        else if (c == '\r') {
-            after.append ("\\\\r");
-        }
-        else if (c == '\t') {
-            after.append ("\\\\t");
-        }
-        else if (c == '\\') {
-            after.append ("\\\\");
-        }
-        else {
-            after += c;
-        }
+namespace {
+
+struct escape_table_t {
+    char replacement [128][7];          // "\u00XX" at most
+    unsigned char length [256];         // 0 if the byte is copied as is
+
+    escape_table_t () : replacement {}, length {} {
+        for (unsigned c = 0; c < 0x20; ++c)
+            set (c, "\\u00%02x", c);
+        set ('"', "\\\"");
+        set ('\\', "\\\\");
+        set ('\b', "\\\\b");
+        set ('\f', "\\\\f");
+        set ('\n', "\\\\n");
+        set ('\r', "\\\\r");
+        set ('\t', "\\\\t");
+    }
+
+    void set (unsigned char c, const char *format, unsigned arg = 0) {
+        length [c] = snprintf (replacement [c], sizeof (replacement [c]), format, arg);
     }
+};
+
+// initialized on first use, escape () may be called from constructors of globals
+const escape_table_t&
+s_escape ()
+{
+    static const escape_table_t table;
+    return table;
+}
+
+} // namespace
+
+size_t
+escape_span (const char *string, size_t length)
+{
+    const escape_table_t& table = s_escape ();
+    size_t i = 0;
+#if defined (__SSE2__)
+    // 16 bytes at once, the rare bytes needing escape are found by mask
+    const __m128i quote = _mm_set1_epi8 ('"');
+    const __m128i backslash = _mm_set1_epi8 ('\\');
+    const __m128i control = _mm_set1_epi8 (0x1f);
+    for (; i + 16 <= length; i += 16) {
+        __m128i chunk = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (string + i));
+        __m128i found = _mm_or_si128 (
+            _mm_or_si128 (_mm_cmpeq_epi8 (chunk, quote), _mm_cmpeq_epi8 (chunk, backslash)),
+            // unsigned chunk <= 0x1f
+            _mm_cmpeq_epi8 (_mm_max_epu8 (chunk, control), control));
+        int mask = _mm_movemask_epi8 (found);
+        if (mask != 0)
+            return i + __builtin_ctz (mask);
+    }
+#endif
+    for (; i < length; ++i) {
+        if (table.length [(unsigned char) string [i]])
+            break;
+    }
+    return i;
+}
+
+const char *
+escape_replacement (unsigned char c, size_t& length)
+{
+    const escape_table_t& table = s_escape ();
+    length = table.length [c];
+    return length ? table.replacement [c] : nullptr;
+}
+
+// escape () appended to after
+static void
+s_append_escaped (std::string& after, const char *string, size_t length)
+{
+    while (true) {
+        size_t span = escape_span (string, length);
+        after.append (string, span);
+        string += span;
+        length -= span;
+        if (length == 0)
+            break;
+
+        size_t replacement_length;
+        const char *replacement = escape_replacement (*string, replacement_length);
+        after.append (replacement, replacement_length);
+        ++string;
+        --length;
+    }
+}
+
+// jsonify () of a string appended to result
+static void
+s_append_jsonified (std::string& result, const std::string& string)
+{
+    result += '"';
+    // escape () stops at nul too
+    s_append_escaped (result, string.c_str (), strlen (string.c_str ()));
+    result += '"';
+}
+
+std::string escape (const char *string) {
+    if (!string)
+        return "(null_ptr)";
+
+    std::string::size_type length = strlen (string);
+    if (escape_span (string, length) == length)
+        return std::string (string, length);
+
+    std::string after;
+    after.reserve (length + length / 2);
+    s_append_escaped (after, string, length);
     return after;
 }
 
@@ -116,71 +250,69 @@ std::string escape (const std::string& before) {
 // ready at the following link:
 // http://stash.mbt.lab.etn.com/projects/BIOS/repos/core/pull-requests/1094/diff#src/web/src/error.cc
 
+// sizes of the fixed parts, escaped strings may grow over the reservation
+static const size_t ERROR_JSON_HEAD = sizeof ("{\n\t\"errors\": [\n") - 1;
+static const size_t ERROR_JSON_ITEM = sizeof ("\t\t{\n\t\t\t\"message\": \"\",\n\t\t\t\"code\": 4294967295\n\t\t},\n") - 1;
+static const size_t ERROR_JSON_DEBUG = sizeof ("\t\t\t\"debug\": \"\",\n") - 1;
+static const size_t ERROR_JSON_TAIL = sizeof ("\n\t]\n}\n") - 1;
+
+static void
+s_append_error (std::string& result, const std::string& message, uint32_t code, const std::string& debug, bool with_debug)
+{
+    result.append ("\t\t{\n\t\t\t\"message\": ");
+    s_append_jsonified (result, message);
+    result.append (",\n");
+    if (with_debug) {
+        result.append ("\t\t\t\"debug\": ");
+        s_append_jsonified (result, debug);
+        result.append (",\n");
+    }
+    result.append ("\t\t\t\"code\": ").append (std::to_string (code)).append ("\n\t\t}");
+}
+
 std::string
 create_error_json (const std::string& message, uint32_t code) {
-    return std::string (
-"{\n"
-"\t\"errors\": [\n"
-"\t\t{\n"
-"\t\t\t\"message\": ").append (jsonify (message)).append (",\n"
-"\t\t\t\"code\": ").append (jsonify (code)).append ("\n"
-"\t\t}\n"
-"\t]\n"
-"}\n"
-);
+    std::string result;
+    result.reserve (ERROR_JSON_HEAD + ERROR_JSON_ITEM + message.size () + ERROR_JSON_TAIL);
+    result.append ("{\n\t\"errors\": [\n");
+    s_append_error (result, message, code, "", false);
+    result.append ("\n\t]\n}\n");
+    return result;
 }
 
 std::string
 create_error_json (const std::string& message, uint32_t code, const std::string& debug) {
-    return std::string (
-"{\n"
-"\t\"errors\": [\n"
-"\t\t{\n"
-"\t\t\t\"message\": ").append (jsonify (message)).append (",\n"
-"\t\t\t\"debug\": ").append (jsonify (debug)).append (",\n"
-"\t\t\t\"code\": ").append (jsonify (code)).append ("\n"
-"\t\t}\n"
-"\t]\n"
-"}\n"
-);
+    std::string result;
+    result.reserve (ERROR_JSON_HEAD + ERROR_JSON_ITEM + message.size () +
+        ERROR_JSON_DEBUG + debug.size () + ERROR_JSON_TAIL);
+    result.append ("{\n\t\"errors\": [\n");
+    s_append_error (result, message, code, debug, true);
+    result.append ("\n\t]\n}\n");
+    return result;
 }
 
 std::string
 create_error_json (std::vector <std::tuple<uint32_t, std::string, std::string>> messages) {
-    std::string result =
-"{\n"
-"\t\"errors\": [\n";
+    size_t size = ERROR_JSON_HEAD + ERROR_JSON_TAIL;
+    for (const auto &it : messages) {
+        size += ERROR_JSON_ITEM + std::get<1>(it).size ();
+        if (!std::get<2>(it).empty ())
+            size += ERROR_JSON_DEBUG + std::get<2>(it).size ();
+    }
 
+    std::string result;
+    result.reserve (size);
+    result.append ("{\n\t\"errors\": [\n");
+    bool first = true;
     for (const auto &it : messages) {
-        result.append (
-"\t\t{\n"
-"\t\t\t\"message\": "
-        );
-        result.append (jsonify (std::get<1>(it))).append (
-",\n");
-        if (std::get<2>(it) != "") {
-        result.append (
-"\t\t\t\"debug\": "
-        );
-        result.append (jsonify (std::get<2>(it))).append (
-",\n");
-        }
-        result.append (
-"\t\t\t\"code\": "
-        );
-        result.append (jsonify (std::get<0>(it))).append (
-"\n"
-"\t\t},\n"
-        );
+        if (!first)
+            result.append (",\n");
+        first = false;
+        s_append_error (result, std::get<1>(it), std::get<0>(it), std::get<2>(it), !std::get<2>(it).empty ());
     }
-    // remove ,\n
-    result.pop_back ();
-    result.pop_back ();
-
-    result.append (
-"\n\t]\n"
-"}\n"
-);
+    if (messages.empty ())
+        result.pop_back ();     // no empty line in []
+    result.append ("\n\t]\n}\n");
     return result;
 }
 
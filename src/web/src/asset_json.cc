@@ -0,0 +1,218 @@
+/*
+ *
+ * Copyright (C) 2015 Eaton
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*!
+ * \file  asset_json.cc
+ * \brief Details of an asset in the format of GET /api/v1/asset/<id>
+ */
+#include <functional>
+#include <tuple>
+#include <vector>
+
+#include <cxxtools/regex.h>
+#include <tntdb/row.h>
+
+#include "asset_json.h"
+#include "asset_types.h"
+#include "utils++.h"
+
+static std::string
+s_ext_name (const std::map <a_elmnt_id_t, std::string> &ext_names, a_elmnt_id_t id)
+{
+    auto it = ext_names.find (id);
+    return it != ext_names.end () ? it->second : "";
+}
+
+static void
+s_strings (utils::json::JsonWriter &json, const char *key, const std::vector <std::string> &values)
+{
+    if (values.empty ())
+        return;
+    json.key (key).begin_array ();
+    for (const auto &value : values)
+        json.value (value);
+    json.end_array ();
+}
+
+void
+asset_json_referred (
+        const db_web_element_t &item,
+        std::set <a_elmnt_id_t> &ids)
+{
+    ids.insert (item.basic.id);
+    if (item.basic.parent_id != 0)
+        ids.insert (item.basic.parent_id);
+    for (const auto &group : item.groups)
+        ids.insert (group.first);
+    for (const auto &link : item.powers)
+        ids.insert (link.src_id);
+    for (const auto &parent : item.parents)
+        ids.insert (std::get<0> (parent));
+}
+
+int
+asset_json_ext_names (
+        tntdb::Connection &conn,
+        const std::set <a_elmnt_id_t> &ids,
+        std::map <a_elmnt_id_t, std::string> &ext_names)
+{
+    // an empty set would select names of all assets
+    if (ids.empty ())
+        return 0;
+    std::function <void (const tntdb::Row&)> cb = [&ext_names](const tntdb::Row &row) {
+        a_elmnt_id_t id = 0;
+        row ["id_asset_element"].get (id);
+        row ["value"].get (ext_names [id]);
+    };
+    return persist::select_asset_ext_attribute_by_keytag (conn, "name", ids, cb);
+}
+
+void
+asset_json (
+        utils::json::JsonWriter &json,
+        const db_web_element_t &item,
+        const std::map <a_elmnt_id_t, std::string> &ext_names)
+{
+    json.member ("id", item.basic.name)
+        .member ("power_devices_in_uri", "/api/v1/assets?in=" + item.basic.name + "&sub_type=epdu,pdu,feed,genset,ups,sts")
+        .member ("name", s_ext_name (ext_names, item.basic.id))
+        .member ("status", item.basic.status)
+        .member ("priority", "P" + std::to_string (item.basic.priority))
+        .member ("type", item.basic.type_name);
+
+    // if element is located, then show the location
+    if (item.basic.parent_id != 0)
+        json.member ("location_uri", "/api/v1/asset/" + item.basic.parent_name)
+            .member ("location_id", item.basic.parent_name)
+            .member ("location", s_ext_name (ext_names, item.basic.parent_id));
+    else
+        json.member ("location", "");
+
+    // every element (except groups) can be placed in some group
+    json.key ("groups").begin_array ();
+    for (const auto &group : item.groups)
+        json.begin_object ()
+            .member ("id", group.second)
+            .member ("name", s_ext_name (ext_names, group.first))
+            .end_object ();
+    json.end_array ();
+
+    // device is special element with more attributes
+    if (item.basic.type_id == persist::asset_type::DEVICE) {
+        json.key ("powers").begin_array ();
+        for (const auto &link : item.powers) {
+            json.begin_object ()
+                .member ("src_name", s_ext_name (ext_names, link.src_id))
+                .member ("src_id", link.src_name);
+            if (!link.src_socket.empty ())
+                json.member ("src_socket", link.src_socket);
+            if (!link.dest_socket.empty ())
+                json.member ("dest_socket", link.dest_socket);
+            json.end_object ();
+        }
+        json.end_array ();
+    }
+
+    // ACE: to be consistent with RFC-11 type of a group is its sub_type
+    std::string group_type;
+    if (item.basic.type_id == persist::asset_type::GROUP) {
+        auto it = item.ext.find ("type");
+        if (it != item.ext.end ()) {
+            group_type = it->first;
+            json.member ("sub_type", utils::strip (it->second.first));
+        }
+    }
+    else {
+        json.member ("sub_type", utils::strip (item.basic.subtype_name));
+        json.key ("parents").begin_array ();
+        for (const auto &parent : item.parents)
+            json.begin_object ()
+                .member ("id", std::get<1> (parent))
+                .member ("name", s_ext_name (ext_names, std::get<0> (parent)))
+                .member ("type", std::get<2> (parent))
+                .member ("sub_type", utils::strip (std::get<3> (parent)))
+                .end_object ();
+        json.end_array ();
+    }
+
+    static cxxtools::Regex r_outlet ("^outlet\\.[0-9][0-9]*\\.(label|group|type)$");
+    static cxxtools::Regex r_ip ("^ip\\.[0-9][0-9]*$");
+    static cxxtools::Regex r_mac ("^mac\\.[0-9][0-9]*$");
+    static cxxtools::Regex r_hostname ("^hostname\\.[0-9][0-9]*$");
+    static cxxtools::Regex r_fqdn ("^fqdn\\.[0-9][0-9]*$");
+
+    // outlet number -> (label|group|type) -> (value, read_only)
+    std::map <std::string, std::map <std::string, std::pair <std::string, bool>>> outlets;
+    std::vector <std::string> ips, macs, fqdns, hostnames;
+
+    json.key ("ext").begin_array ();
+    if (!item.basic.asset_tag.empty ())
+        json.begin_object ()
+            .member ("asset_tag", item.basic.asset_tag)
+            .member ("read_only", true)
+            .end_object ();
+    for (const auto &ext : item.ext) {
+        const std::string &key = ext.first;
+        if (key == "name" || key == group_type)
+            continue;
+        // read_only property of ips, macs, fqdns and hostnames is ignored
+        cxxtools::RegexSMatch m;
+        if (r_outlet.match (key, m)) {
+            auto dot = key.find ('.', 7);
+            outlets [key.substr (7, dot - 7)][m.get (1)] = ext.second;
+            continue;
+        }
+        if (r_ip.match (key)) { ips.push_back (ext.second.first); continue; }
+        if (r_mac.match (key)) { macs.push_back (ext.second.first); continue; }
+        if (r_fqdn.match (key)) { fqdns.push_back (ext.second.first); continue; }
+        if (r_hostname.match (key)) { hostnames.push_back (ext.second.first); continue; }
+
+        // not special, returned as "ext"
+        json.begin_object ()
+            .member (key, ext.second.first)
+            .member ("read_only", ext.second.second)
+            .end_object ();
+    }
+    json.end_array ();
+
+    s_strings (json, "ips", ips);
+    s_strings (json, "macs", macs);
+    s_strings (json, "fqdns", fqdns);
+    s_strings (json, "hostnames", hostnames);
+
+    if (!outlets.empty ()) {
+        json.key ("outlets").begin_object ();
+        for (const auto &outlet : outlets) {
+            json.key (outlet.first).begin_array ();
+            for (const char *property : {"label", "group", "type"}) {
+                auto it = outlet.second.find (property);
+                if (it == outlet.second.end () || it->second.first.empty ())
+                    continue;
+                json.begin_object ()
+                    .member ("name", property)
+                    .member ("value", it->second.first)
+                    .member ("read_only", it->second.second)
+                    .end_object ();
+            }
+            json.end_array ();
+        }
+        json.end_object ();
+    }
+}
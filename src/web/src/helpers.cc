@@ -19,6 +19,8 @@
  */
 
 #include <cassert>
+#include <limits>
+#include <set>
 #include <cxxtools/regex.h>
 #include <unistd.h> // make "readlink" available on ARM
 #include <tntdb.h>
@@ -28,6 +30,7 @@
 
 #include "log.h"
 #include "dbpath.h"
+#include "db/assets.h"
 
 const char* UserInfo::toString() {
     switch (_profile) {
@@ -223,6 +226,93 @@ bool check_asset_name (const std::string& param_name, const std::string& name, h
     return true;
 }
 
+bool
+check_asset_filter (const tnt::QueryParams& qparam, asset_filter_t& filter, http_errors_t& errors)
+{
+    std::string status = qparam.param ("status");
+    if (!status.empty ()) {
+        static const std::set <std::string> STATUSES = {"active", "nonactive", "spare", "retired"};
+        if (STATUSES.count (status) == 0) {
+            http_add_error ("", errors, "request-param-bad", "status", status.c_str (), "active/nonactive/spare/retired");
+            return false;
+        }
+        filter.status = status;
+    }
+
+    std::string priority = qparam.param ("priority");
+    if (!priority.empty ()) {
+        if (!check_regex_text ("priority", priority, "^p?[1-5]$", errors))
+            return false;
+        filter.priority = priority.back () - '0';
+    }
+
+    std::string ext_key = qparam.param ("ext_key");
+    std::string ext_value = qparam.param ("ext_value");
+    if (!ext_value.empty () && ext_key.empty ()) {
+        http_add_error ("", errors, "request-param-required", "ext_key");
+        return false;
+    }
+    if (!ext_key.empty ()) {
+        if (!check_regex_text ("ext_key", ext_key, "^[-_.a-z0-9]{1,255}$", errors))
+            return false;
+        filter.ext_key = ext_key;
+        filter.ext_value = ext_value;
+    }
+
+    std::string after = qparam.param ("after");
+    if (!after.empty ()) {
+        // X-Next-After of the previous page, no lookup, the asset may be gone
+        if (after.find_first_not_of ("0123456789") == std::string::npos) {
+            if (after.size () > 10 || std::stoull (after) > std::numeric_limits <a_elmnt_id_t>::max ()) {
+                http_add_error ("", errors, "request-param-bad", "after", after.c_str (), "asset id");
+                return false;
+            }
+            filter.after = std::stoul (after);
+        }
+        else
+        if (!check_element_identifier ("after", after, filter.after, errors))
+            return false;
+    }
+
+    std::string limit = qparam.param ("limit");
+    if (!limit.empty ()) {
+        if (!check_regex_text ("limit", limit, "^[1-9][0-9]{0,8}$", errors))
+            return false;
+        filter.limit = std::stoul (limit);
+    }
+    return true;
+}
+
+bool
+check_etag (const tnt::HttpRequest& request, tnt::HttpReply& reply, const std::string& etag)
+{
+    std::string if_none_match = request.getHeader ("If-None-Match:");
+    if (if_none_match.empty ())
+        return false;
+
+    // comma separated list of (possibly weak) tags or "*"
+    std::string::size_type pos = 0;
+    while (pos < if_none_match.size ()) {
+        std::string::size_type end = if_none_match.find (',', pos);
+        if (end == std::string::npos)
+            end = if_none_match.size ();
+        std::string tag = if_none_match.substr (pos, end - pos);
+        pos = end + 1;
+
+        tag.erase (0, tag.find_first_not_of (" \t"));
+        tag.erase (tag.find_last_not_of (" \t") + 1);
+        if (tag.compare (0, 2, "W/") == 0)
+            tag.erase (0, 2);
+        if (tag == "*" || tag == etag) {
+            log_debug ("If-None-Match: %s matches %s", if_none_match.c_str (), etag.c_str ());
+            // 304 carries the tag as the 200 would
+            reply.setHeader ("ETag:", etag);
+            return true;
+        }
+    }
+    return false;
+}
+
 bool
 check_alert_rule_name (const std::string& param_name, const std::string& rule_name, http_errors_t& errors)
 {
@@ -27,125 +27,67 @@
  */
 #include "location_helpers.h"
 
-#include <list>
 #include <tnt/http.h>
 
 #include "asset_types.h"
-#include "cleanup.h"
 #include "utils++.h"
 #include "utils_web.h"
-#include "assets.h"
 
-int asset_location_r(asset_msg_t** asset_msg, std::string& json) {
-    int element_id = asset_msg_element_id(*asset_msg);
-    int type_id = asset_msg_type(*asset_msg);
-    std::string name = asset_msg_name(*asset_msg);
-    std::string type_name = asset_msg_type_name(*asset_msg);
+static const char*
+s_contains_name (a_elmnt_tp_id_t type_id)
+{
+    switch (type_id) {
+        case persist::asset_type::DATACENTER: return "datacenters";
+        case persist::asset_type::ROOM:       return "rooms";
+        case persist::asset_type::ROW:        return "rows";
+        case persist::asset_type::RACK:       return "racks";
+        case persist::asset_type::DEVICE:     return "devices";
+        default:                              return "groups";
+    }
+}
 
+int asset_location_r(const location_topology_t& topology, std::string& json, size_t index) {
+    const location_node_t &node = topology[index];
 
     json += "{";
-    json += "\"name\" : \"" + utils::json::escape (persist::id_to_name_ext_name (element_id).second) + "\", ";
-    json += "\"id\" : \"" + utils::json::escape (name) + "\",";
-    json += "\"type\" : \"" + persist::typeid_to_type(type_id) + "\",";
-    if ( (type_id == persist::asset_type::DEVICE ) ||
-         (type_id == persist::asset_type::GROUP) ) {
-        json += "\"sub_type\" : \"" + utils::strip (type_name) + "\"";
+    json += "\"name\" : \"" + utils::json::escape (node.ext_name) + "\", ";
+    json += "\"id\" : \"" + utils::json::escape (node.name) + "\",";
+    json += "\"type\" : \"" + persist::typeid_to_type(node.type_id) + "\",";
+    if ( (node.type_id == persist::asset_type::DEVICE ) ||
+         (node.type_id == persist::asset_type::GROUP) ) {
+        json += "\"sub_type\" : \"" + utils::strip (node.dtype_name) + "\"";
     }
     else {
         json += "\"sub_type\" : \"N_A\"";
     }
 
-    std::list<zframe_t *> frames;
-    std::list<std::string> names;
-
-    frames.push_back(asset_msg_get_dcs(*asset_msg));
-    names.push_back("datacenters");
-    frames.push_back(asset_msg_get_rooms(*asset_msg));
-    names.push_back("rooms");
-    frames.push_back(asset_msg_get_rows(*asset_msg));
-    names.push_back("rows");
-    frames.push_back(asset_msg_get_racks(*asset_msg));
-    names.push_back("racks");
-    frames.push_back(asset_msg_get_devices(*asset_msg));
-    names.push_back("devices");
-    frames.push_back(asset_msg_get_grps(*asset_msg));
-    names.push_back("groups");
-
-    asset_msg_destroy(asset_msg);
-
-    bool first_contains = true;
-    _scoped_zframe_t *it_f = NULL;
-    _scoped_zmsg_t *zmsg = NULL;
-    _scoped_asset_msg_t *item = NULL;
-    while(!(frames.empty() || names.empty())) {
-        it_f = frames.front();
-        frames.pop_front();
-        std::string name_it = names.front();
-        names.pop_front();
-        if(it_f == NULL)
-            continue;
-#if CZMQ_VERSION_MAJOR == 3
-        byte *buffer = zframe_data(it_f);
-        if(buffer == NULL)
-            goto err_cleanup;
-        zmsg = zmsg_decode(buffer, zframe_size(it_f));
-#else
-        zmsg = zmsg_decode (it_f);
-#endif
-        if(zmsg == NULL || !zmsg_is (zmsg))
-            goto err_cleanup;
-        zframe_destroy(&it_f);
-
-        _scoped_zmsg_t *pop = NULL;
-        bool first = true;
-        while((pop = zmsg_popmsg(zmsg)) != NULL) { // caller owns zmgs_t
-            if(!is_asset_msg (pop))
-                goto err_cleanup;
-            item = asset_msg_decode(&pop); // zmsg_t is freed
-            if(item == NULL)
-                goto err_cleanup;
-            if(first == false) {
-                json += ", ";
-            } else {
-                if(first_contains == false) {
-                    json += ", ";
-                } else {
-                    first_contains = false;
-                    json += ", \"contains\" : { ";
-                }
-                json += "\"" + utils::json::escape (name_it)+ "\" : [";
-                first = false;
-            }
-            if(asset_location_r(&item, json) != HTTP_OK)
-                goto err_cleanup;
-            asset_msg_destroy(&item);
+    // children of the same type are adjacent, each type is one list
+    a_elmnt_tp_id_t contains_type = 0;
+    for (size_t child = index + 1; child < node.end; child = topology[child].end) {
+        if (contains_type == 0)
+            json += ", \"contains\" : { ";
+        else if (topology[child].type_id == contains_type) {
+            json += ", ";
         }
-        zmsg_destroy(&zmsg);
-
-        if(first == false)
-            json += "]";
+        else
+            json += "], ";
+        if (topology[child].type_id != contains_type) {
+            contains_type = topology[child].type_id;
+            json += "\"";
+            json += s_contains_name (contains_type);
+            json += "\" : [";
+        }
+        asset_location_r(topology, json, child);
     }
-    if(!first_contains)
+    if (contains_type != 0)
     {
-        json += "}"; // level-1 "contains"
+        json += "]}"; // level-1 "contains"
     }
     else
     {
-        if (type_id != persist::asset_type::DEVICE )
+        if (node.type_id != persist::asset_type::DEVICE )
             json += ", \"contains\":[]";
     }
     json += "}"; // json closing curly bracket
     return HTTP_OK;
-
-err_cleanup:
-    zmsg_destroy (&zmsg);
-    asset_msg_destroy (&item);
-    zframe_destroy(&it_f);
-    while(!(frames.empty())) {
-        it_f = frames.front();
-        frames.pop_front();
-        zframe_destroy(&it_f);
-    }
-    json = "";
-    return HTTP_INTERNAL_SERVER_ERROR;
 }
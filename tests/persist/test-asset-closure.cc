@@ -0,0 +1,179 @@
+/*
+ *
+ * Copyright (C) 2015 Eaton
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*!
+ * \file test-asset-closure.cc
+ * \brief Tests of the in-memory asset closure and its comparison
+ *        with v_bios_asset_element_super_parent
+ */
+#include <catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <tntdb/transaction.h>
+#include <tntdb/result.h>
+
+#include "dbpath.h"
+#include "log.h"
+
+#include "asset_types.h"
+#include "db/assets.h"
+#include "db/asset_closure.h"
+#include "db/asset_generation.h"
+
+TEST_CASE("asset closure", "[closure]")
+{
+    //  1 - 2 - 4
+    //    |   - 5 - 7
+    //    - 3
+    //  6 (parent 99 does not exist)
+    //  8 <-> 9 cycle
+    persist::AssetClosure closure ({
+        {1, 0}, {2, 1}, {3, 1}, {4, 2}, {5, 2}, {7, 5},
+        {6, 99}, {8, 9}, {9, 8}},
+        {{1, persist::asset_type::DATACENTER}, {5, persist::asset_type::RACK}});
+
+    CHECK (closure.size () == 9);
+    CHECK (closure.type (1) == persist::asset_type::DATACENTER);
+    CHECK (closure.type (5) == persist::asset_type::RACK);
+    CHECK (closure.type (7) == 0);
+    CHECK (closure.type (42) == 0);
+
+    CHECK (closure.is_under (7, 1));
+    CHECK (closure.is_under (7, 2));
+    CHECK (closure.is_under (7, 5));
+    CHECK (closure.is_under (3, 1));
+    CHECK (!closure.is_under (3, 2));
+    CHECK (!closure.is_under (1, 1));
+    CHECK (!closure.is_under (1, 7));
+    CHECK (!closure.is_under (6, 1));
+    CHECK (!closure.is_under (42, 1));
+    CHECK (!closure.is_under (1, 42));
+
+    auto d = closure.descendants (2);
+    std::sort (d.begin (), d.end ());
+    CHECK (d == std::vector<a_elmnt_id_t>({4, 5, 7}));
+    CHECK (closure.descendants (1).size () == 5);
+    CHECK (closure.descendants (3).empty ());
+    CHECK (closure.descendants (42).empty ());
+
+    CHECK (closure.ancestors (7) == std::vector<a_elmnt_id_t>({5, 2, 1}));
+    CHECK (closure.ancestors (1).empty ());
+    CHECK (closure.ancestors (6).empty ());
+
+    // the cycle is broken, but every element is still indexed once
+    bool nine_under_eight = closure.is_under (9, 8);
+    CHECK (nine_under_eight != closure.is_under (8, 9));
+    size_t cycle_ancestors = closure.ancestors (9).size () + closure.ancestors (8).size ();
+    CHECK (cycle_ancestors == 1);
+}
+
+TEST_CASE("asset generation", "[closure]")
+{
+    uint64_t generation = persist::asset_generation ();
+    std::string etag = persist::asset_etag ();
+    CHECK (etag == persist::asset_etag ());
+    CHECK (etag.front () == '"');
+    CHECK (etag.back () == '"');
+
+    persist::invalidate_asset_closure ();
+    CHECK (persist::asset_generation () == generation + 1);
+    CHECK (persist::bump_asset_generation () == generation + 2);
+    std::string etag2 = persist::asset_etag ();
+    CHECK (etag2 != etag);
+
+    // tags of the model expire with the period, every minute
+    auto now = std::chrono::steady_clock::now ();
+    uint64_t period = persist::asset_period (now);
+    CHECK (persist::asset_period (now + std::chrono::seconds (60)) == period + 1);
+    CHECK (persist::asset_period (now - std::chrono::seconds (60)) == period - 1);
+    std::string suffix = "-" + std::to_string (period) + "\"";
+    CHECK (etag2.compare (etag2.size () - suffix.size (), suffix.size (), suffix) == 0);
+}
+
+// 1 DC, 10 rooms, 10 rows per room, 10 racks per row, 47 devices per rack
+TEST_CASE("asset closure 50k", "[db][closure][.][benchmark]")
+{
+    static const int N = 10;
+    static const int DEVICES = 47;
+
+    log_open ();
+    tntdb::Connection conn = tntdb::connectCached (url);
+    tntdb::Transaction trans (conn);
+
+    auto insert = [&conn](const std::string &name, a_elmnt_tp_id_t type, a_elmnt_id_t parent, a_dvc_tp_id_t subtype) {
+        auto ret = persist::insert_into_asset_element (conn, name.c_str (), type, parent, "active", 1, subtype, name.c_str (), true);
+        REQUIRE (ret.status == 1);
+        return (a_elmnt_id_t) ret.rowid;
+    };
+
+    a_elmnt_id_t dc = insert ("bench-dc", persist::asset_type::DATACENTER, 0, 0);
+    a_elmnt_id_t room0 = 0;
+    size_t total = 0;
+    for (int i = 0; i != N; ++i) {
+        a_elmnt_id_t room = insert ("bench-room-" + std::to_string (i), persist::asset_type::ROOM, dc, 0);
+        if (i == 0)
+            room0 = room;
+        for (int j = 0; j != N; ++j) {
+            std::string row_name = "bench-row-" + std::to_string (i) + "-" + std::to_string (j);
+            a_elmnt_id_t row = insert (row_name, persist::asset_type::ROW, room, 0);
+            for (int k = 0; k != N; ++k) {
+                std::string rack_name = "bench-rack-" + std::to_string (i) + "-" + std::to_string (j) + "-" + std::to_string (k);
+                a_elmnt_id_t rack = insert (rack_name, persist::asset_type::RACK, row, 0);
+                for (int l = 0; l != DEVICES; ++l)
+                    insert (rack_name + "-srv-" + std::to_string (l), persist::asset_type::DEVICE, rack, persist::asset_subtype::SERVER);
+                total += DEVICES + 1;
+            }
+            total += 1;
+        }
+        total += 1;
+    }
+    persist::invalidate_asset_closure ();
+
+    for (a_elmnt_id_t container : {dc, room0}) {
+        auto start = std::chrono::steady_clock::now ();
+        tntdb::Result result = conn.prepare (
+            " SELECT v.id_asset_element FROM v_bios_asset_element_super_parent v "
+            " WHERE :containerid in (v.id_parent1, v.id_parent2, v.id_parent3, v.id_parent4, v.id_parent5)"
+        ).set ("containerid", container).select ();
+        std::chrono::duration<double> view = std::chrono::steady_clock::now () - start;
+
+        start = std::chrono::steady_clock::now ();
+        persist::asset_closure (conn);
+        std::chrono::duration<double> load = std::chrono::steady_clock::now () - start;
+
+        start = std::chrono::steady_clock::now ();
+        size_t rows = 0;
+        REQUIRE (persist::select_assets_by_container (conn, container, [&rows](const tntdb::Row&) { ++rows; }) == 0);
+        std::chrono::duration<double> closure = std::chrono::steady_clock::now () - start;
+
+        CHECK (rows == result.size ());
+        if (container == dc)
+            CHECK (rows == total);
+
+        printf ("assets under %" PRIu32 " (%zu rows):\n", container, rows);
+        printf ("  super_parent view: %8.3f s\n", view.count ());
+        printf ("  closure load:      %8.3f s\n", load.count ());
+        printf ("  closure:           %8.3f s\n", closure.count ());
+    }
+
+    trans.rollback ();
+    persist::invalidate_asset_closure ();
+}
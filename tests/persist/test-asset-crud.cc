@@ -828,3 +828,84 @@ TEST_CASE("device unlockated INSERT/DELETE #12","[db][CRUD][insert][delete][unlo
     REQUIRE ( reply_delete.affected_rows == 0 );
     REQUIRE ( reply_delete.status == 1 );
 }
+
+TEST_CASE("bulk asset DELETE","[db][CRUD][delete][bulk]")
+{
+    log_open ();
+
+    log_info ("=============== BULK ASSET DELETE ==================");
+
+    tntdb::Connection conn;
+    REQUIRE_NOTHROW ( conn = tntdb::connectCached(url) );
+
+    auto insert = [&conn](const char *name, a_elmnt_tp_id_t type, a_elmnt_id_t parent, a_dvc_tp_id_t subtype) {
+        auto ret = persist::insert_into_asset_element (conn, name, type, parent, "active", 1, subtype, name, false);
+        REQUIRE ( ret.status == 1 );
+        return (a_elmnt_id_t) ret.rowid;
+    };
+
+    //  dc - room - rack - ups -> srv, load
+    //                   - srv
+    //  outside -> ups, load, group (srv)
+    a_elmnt_id_t dc      = insert ("bulk-dc", persist::asset_type::DATACENTER, 0, 0);
+    a_elmnt_id_t room    = insert ("bulk-room", persist::asset_type::ROOM, dc, 0);
+    a_elmnt_id_t rack    = insert ("bulk-rack", persist::asset_type::RACK, room, 0);
+    a_elmnt_id_t ups     = insert ("bulk-ups", persist::asset_type::DEVICE, rack, persist::asset_subtype::UPS);
+    a_elmnt_id_t srv     = insert ("bulk-srv", persist::asset_type::DEVICE, rack, persist::asset_subtype::SERVER);
+    a_elmnt_id_t outside = insert ("bulk-outside", persist::asset_type::DEVICE, 0, persist::asset_subtype::UPS);
+    a_elmnt_id_t load    = insert ("bulk-load", persist::asset_type::DEVICE, 0, persist::asset_subtype::SERVER);
+    a_elmnt_id_t group   = insert ("bulk-group", persist::asset_type::GROUP, 0, 0);
+
+    REQUIRE ( persist::insert_into_asset_link (conn, outside, ups, INPUT_POWER_CHAIN, SRCOUT_DESTIN_IS_NULL, SRCOUT_DESTIN_IS_NULL).status == 1 );
+    REQUIRE ( persist::insert_into_asset_link (conn, ups, srv, INPUT_POWER_CHAIN, SRCOUT_DESTIN_IS_NULL, SRCOUT_DESTIN_IS_NULL).status == 1 );
+    REQUIRE ( persist::insert_into_asset_link (conn, ups, load, INPUT_POWER_CHAIN, SRCOUT_DESTIN_IS_NULL, SRCOUT_DESTIN_IS_NULL).status == 1 );
+    REQUIRE ( persist::insert_asset_element_into_asset_group (conn, group, srv).status == 1 );
+    REQUIRE ( persist::insert_into_asset_ext_attribute (conn, "Rack 1", "name", rack, false).status == 1 );
+
+    std::vector<db_a_elmnt_t> deleted;
+    std::map<a_elmnt_id_t, std::string> blocked;
+
+    // children outside of the set
+    auto reply = persist::delete_assets (conn, {room, rack}, deleted, blocked);
+    CHECK ( reply.status == 0 );
+    CHECK ( reply.errsubtype == DB_ERROR_DELETEFAIL );
+    CHECK ( blocked.size () == 1 );
+    CHECK ( blocked.count (rack) == 1 );
+    CHECK ( deleted.empty () );
+    CHECK ( persist::name_to_asset_id ("bulk-room") == room );
+
+    // device of the set is powered from outside of it
+    reply = persist::delete_assets (conn, {room, rack, ups, srv}, deleted, blocked);
+    CHECK ( reply.status == 0 );
+    CHECK ( blocked.size () == 1 );
+    CHECK ( blocked.count (ups) == 1 );
+    CHECK ( persist::name_to_asset_id ("bulk-ups") == ups );
+
+    // links out of the set don't block
+    reply = persist::delete_assets (conn, {outside}, deleted, blocked);
+    CHECK ( reply.status == 1 );
+    CHECK ( reply.affected_rows == 1 );
+
+    // ups still powers load, which stays
+    reply = persist::delete_assets (conn, {room, rack, ups, srv}, deleted, blocked);
+    CHECK ( reply.status == 1 );
+    CHECK ( reply.affected_rows == 4 );
+    CHECK ( blocked.empty () );
+    REQUIRE ( deleted.size () == 4 );
+    // deepest first
+    CHECK ( deleted.front ().type_id == persist::asset_type::DEVICE );
+    CHECK ( deleted.back ().id == room );
+    CHECK ( deleted.back ().name == "bulk-room" );
+    CHECK ( persist::name_to_asset_id ("bulk-srv") == -1 );
+    CHECK ( persist::name_to_asset_id ("bulk-load") == load );
+
+    // already gone
+    reply = persist::delete_assets (conn, {room}, deleted, blocked);
+    CHECK ( reply.status == 0 );
+    CHECK ( reply.errsubtype == DB_ERROR_NOTFOUND );
+    CHECK ( reply.rowid == room );
+
+    reply = persist::delete_assets (conn, {dc, group, load}, deleted, blocked);
+    CHECK ( reply.status == 1 );
+    CHECK ( reply.affected_rows == 3 );
+}
@@ -0,0 +1,341 @@
+/*
+ *
+ * Copyright (C) 2015 Eaton
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*!
+ * \file test-asset-list.cc
+ * \brief Queries behind /asset_list, /assets_in and asset details: latency
+ *        of one query per listing against a name lookup per asset, paging
+ *        and batched details against the per asset selects
+ */
+#include <catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <tntdb/transaction.h>
+#include <tntdb/result.h>
+#include <tntdb/error.h>
+
+#include "dbpath.h"
+#include "log.h"
+
+#include "asset_types.h"
+#include "db/assets.h"
+#include "db/asset_closure.h"
+
+// ext name lookup done per asset by the endpoints before
+static std::string
+s_ext_name (tntdb::Connection &conn, a_elmnt_id_t id)
+{
+    try {
+        tntdb::Row row = conn.prepareCached (
+            " SELECT asset.name, ext.value "
+            " FROM "
+            "   t_bios_asset_element AS asset "
+            " LEFT JOIN "
+            "   t_bios_asset_ext_attributes AS ext "
+            " ON "
+            "   ext.id_asset_element = asset.id_asset_element "
+            " WHERE "
+            "   ext.keytag = \"name\" AND asset.id_asset_element = :asset_id ")
+            .set ("asset_id", id).selectRow ();
+        std::string ext_name;
+        row[1].get (ext_name);
+        return ext_name;
+    }
+    catch (const tntdb::NotFound &) {
+        return "";
+    }
+}
+
+// 1 DC, 20 racks, 400 devices per rack
+TEST_CASE("asset list latency", "[db][asset_list][.][benchmark]")
+{
+    static const int RACKS = 20;
+    static const int DEVICES = 400;
+
+    log_open ();
+    tntdb::Connection conn = tntdb::connectCached (url);
+    tntdb::Transaction trans (conn);
+
+    auto insert = [&conn](const std::string &name, a_elmnt_tp_id_t type, a_elmnt_id_t parent, a_dvc_tp_id_t subtype) {
+        auto ret = persist::insert_into_asset_element (conn, name.c_str (), type, parent, "active", 1, subtype, name.c_str (), true);
+        REQUIRE (ret.status == 1);
+        std::string ext_name = "ext " + name;
+        auto ret2 = persist::insert_into_asset_ext_attribute (conn, ext_name.c_str (), "name", ret.rowid, false);
+        REQUIRE (ret2.status == 1);
+        return (a_elmnt_id_t) ret.rowid;
+    };
+
+    a_elmnt_id_t dc = insert ("list-bench-dc", persist::asset_type::DATACENTER, 0, 0);
+    for (int i = 0; i != RACKS; ++i) {
+        std::string rack_name = "list-bench-rack-" + std::to_string (i);
+        a_elmnt_id_t rack = insert (rack_name, persist::asset_type::RACK, dc, 0);
+        for (int j = 0; j != DEVICES; ++j)
+            insert (rack_name + "-srv-" + std::to_string (j), persist::asset_type::DEVICE, rack, persist::asset_subtype::SERVER);
+    }
+    persist::invalidate_asset_closure ();
+
+    // /asset_list?type=device&subtype=server
+    auto start = std::chrono::steady_clock::now ();
+    std::map <a_elmnt_id_t, std::string> before;
+    auto shortlist = persist::select_short_elements (conn, persist::asset_type::DEVICE, persist::asset_subtype::SERVER);
+    REQUIRE (shortlist.status == 1);
+    for (const auto &it : shortlist.item)
+        before [it.first] = s_ext_name (conn, it.first);
+    std::chrono::duration<double> list_before = std::chrono::steady_clock::now () - start;
+
+    start = std::chrono::steady_clock::now ();
+    std::map <a_elmnt_id_t, std::string> after;
+    REQUIRE (persist::select_assets_by_type (conn, persist::asset_type::DEVICE, persist::asset_subtype::SERVER,
+        [&after](const tntdb::Row &row) {
+            std::string ext_name;
+            row["ext_name"].get (ext_name);
+            after [row["asset_id"].getUnsigned32 ()] = ext_name;
+        }) == 0);
+    std::chrono::duration<double> list_after = std::chrono::steady_clock::now () - start;
+    CHECK (before == after);
+
+    // /assets_in?in=<dc>&type=device
+    start = std::chrono::steady_clock::now ();
+    before.clear ();
+    REQUIRE (persist::select_assets_by_container (conn, dc, {persist::asset_type::DEVICE}, {},
+        [&before, &conn](const tntdb::Row &row) {
+            a_elmnt_id_t id = row["asset_id"].getUnsigned32 ();
+            before [id] = s_ext_name (conn, id);
+        }) == 0);
+    std::chrono::duration<double> in_before = std::chrono::steady_clock::now () - start;
+
+    start = std::chrono::steady_clock::now ();
+    after.clear ();
+    REQUIRE (persist::select_assets_by_container (conn, dc, {persist::asset_type::DEVICE}, {},
+        [&after](const tntdb::Row &row) {
+            std::string ext_name;
+            row["ext_name"].get (ext_name);
+            after [row["asset_id"].getUnsigned32 ()] = ext_name;
+        }) == 0);
+    std::chrono::duration<double> in_after = std::chrono::steady_clock::now () - start;
+    CHECK (before == after);
+    CHECK (after.size () == (size_t) (RACKS * DEVICES));
+
+    printf ("%d devices:\n", RACKS * DEVICES);
+    printf ("  asset_list, name lookup per asset: %8.3f s\n", list_before.count ());
+    printf ("  asset_list, single query:          %8.3f s\n", list_after.count ());
+    printf ("  assets_in, name lookup per asset:  %8.3f s\n", in_before.count ());
+    printf ("  assets_in, single query:           %8.3f s\n", in_after.count ());
+
+    trans.rollback ();
+    persist::invalidate_asset_closure ();
+}
+
+TEST_CASE("asset list paging", "[db][asset_list][paging]")
+{
+    static const int DEVICES = 25;
+
+    log_open ();
+    tntdb::Connection conn = tntdb::connectCached (url);
+    tntdb::Transaction trans (conn);
+
+    auto insert = [&conn](const std::string &name, a_elmnt_tp_id_t type, a_elmnt_id_t parent, const char *status, a_elmnt_pr_t priority) {
+        auto ret = persist::insert_into_asset_element (conn, name.c_str (), type, parent, status, priority,
+                type == persist::asset_type::DEVICE ? persist::asset_subtype::SERVER : 0, name.c_str (), true);
+        REQUIRE (ret.status == 1);
+        return (a_elmnt_id_t) ret.rowid;
+    };
+
+    a_elmnt_id_t dc = insert ("page-test-dc", persist::asset_type::DATACENTER, 0, "active", 1);
+    a_elmnt_id_t rack = insert ("page-test-rack", persist::asset_type::RACK, dc, "active", 1);
+    std::vector <a_elmnt_id_t> devices;
+    for (int i = 0; i != DEVICES; ++i) {
+        std::string name = "page-test-srv-" + std::to_string (i);
+        a_elmnt_id_t id = insert (name, persist::asset_type::DEVICE, rack, i % 5 == 0 ? "spare" : "active", 1 + i % 2);
+        devices.push_back (id);
+        if (i % 3 == 0)
+            REQUIRE (persist::insert_into_asset_ext_attribute (conn, (i % 2 ? "odd" : "even"), "page_test", id, false).status == 1);
+    }
+    persist::invalidate_asset_closure ();
+
+    // pages of 10 concatenated give the whole ordered list
+    asset_filter_t filter;
+    filter.limit = 10;
+    std::vector <a_elmnt_id_t> paged;
+    uint32_t total = 0;
+    for (int page = 0; page != 4; ++page) {
+        std::vector <a_elmnt_id_t> ids;
+        REQUIRE (persist::select_assets_by_container (conn, dc, {persist::asset_type::DEVICE}, {}, filter, &total,
+            [&ids](const tntdb::Row &row) { ids.push_back (row["asset_id"].getUnsigned32 ()); }) == 0);
+        CHECK (total == DEVICES);
+        CHECK (ids.size () <= 10);
+        if (ids.empty ())
+            break;
+        paged.insert (paged.end (), ids.begin (), ids.end ());
+        filter.after = ids.back ();
+    }
+    CHECK (paged == devices);
+
+    // server side filters
+    auto count = [&conn, dc](const asset_filter_t &filter) {
+        uint32_t total = 0;
+        size_t rows = 0;
+        REQUIRE (persist::select_assets_by_container (conn, dc, {}, {}, filter, &total,
+            [&rows](const tntdb::Row &) { ++rows; }) == 0);
+        CHECK (rows == total);
+        return total;
+    };
+    asset_filter_t status;
+    status.status = "spare";
+    CHECK (count (status) == 5);
+    asset_filter_t priority;
+    priority.priority = 2;
+    CHECK (count (priority) == 12);
+    asset_filter_t ext;
+    ext.ext_key = "page_test";
+    CHECK (count (ext) == 9);
+    ext.ext_value = "odd";
+    CHECK (count (ext) == 4);
+
+    // the same through the type listing
+    asset_filter_t by_type;
+    by_type.status = "spare";
+    by_type.after = devices [5];
+    std::vector <a_elmnt_id_t> spare;
+    REQUIRE (persist::select_assets_by_type (conn, persist::asset_type::DEVICE, {persist::asset_subtype::SERVER}, by_type, &total,
+        [&spare](const tntdb::Row &row) { spare.push_back (row["asset_id"].getUnsigned32 ()); }) == 0);
+    CHECK (total >= 5);
+    CHECK (std::find (spare.begin (), spare.end (), devices [10]) != spare.end ());
+    CHECK (std::find (spare.begin (), spare.end (), devices [5]) == spare.end ());
+
+    // the cursor is a position, paging goes on when the last asset of the
+    // previous page is deleted
+    asset_filter_t first;
+    first.limit = 11;     // devices [10] has no ext attribute
+    std::vector <a_elmnt_id_t> page;
+    auto collect = [&page](const tntdb::Row &row) { page.push_back (row["asset_id"].getUnsigned32 ()); };
+    REQUIRE (persist::select_assets_by_container (conn, dc, {persist::asset_type::DEVICE}, {}, first, &total, collect) == 0);
+    REQUIRE (page.size () == 11);
+    REQUIRE (persist::delete_asset_element (conn, page.back ()).status == 1);
+    persist::invalidate_asset_closure ();
+    first.after = page.back ();
+    page.clear ();
+    REQUIRE (persist::select_assets_by_container (conn, dc, {persist::asset_type::DEVICE}, {}, first, &total, collect) == 0);
+    CHECK (page == std::vector <a_elmnt_id_t> (devices.begin () + 11, devices.begin () + 22));
+    page.clear ();
+    REQUIRE (persist::select_assets_by_type (conn, persist::asset_type::DEVICE, {persist::asset_subtype::SERVER}, first, &total, collect) == 0);
+    CHECK (std::find (page.begin (), page.end (), devices [11]) != page.end ());
+    CHECK (std::find (page.begin (), page.end (), devices [10]) == page.end ());
+
+    trans.rollback ();
+    persist::invalidate_asset_closure ();
+}
+
+TEST_CASE("asset details", "[db][asset_list][asset_details]")
+{
+    log_open ();
+    tntdb::Connection conn = tntdb::connectCached (url);
+    tntdb::Transaction trans (conn);
+
+    auto insert = [&conn](const std::string &name, a_elmnt_tp_id_t type, a_elmnt_id_t parent, a_dvc_tp_id_t subtype) {
+        auto ret = persist::insert_into_asset_element (conn, name.c_str (), type, parent, "active", 1, subtype, name.c_str (), true);
+        REQUIRE (ret.status == 1);
+        std::string ext_name = "ext " + name;
+        REQUIRE (persist::insert_into_asset_ext_attribute (conn, ext_name.c_str (), "name", ret.rowid, false).status == 1);
+        return (a_elmnt_id_t) ret.rowid;
+    };
+
+    a_elmnt_id_t dc = insert ("details-test-dc", persist::asset_type::DATACENTER, 0, 0);
+    a_elmnt_id_t rack = insert ("details-test-rack", persist::asset_type::RACK, dc, 0);
+    a_elmnt_id_t group = insert ("details-test-group", persist::asset_type::GROUP, 0, 0);
+    a_elmnt_id_t ups = insert ("details-test-ups", persist::asset_type::DEVICE, rack, persist::asset_subtype::UPS);
+    a_elmnt_id_t srv = insert ("details-test-srv", persist::asset_type::DEVICE, rack, persist::asset_subtype::SERVER);
+    REQUIRE (persist::insert_into_asset_ext_attribute (conn, "2", "u_size", srv, true).status == 1);
+    REQUIRE (persist::insert_asset_element_into_asset_group (conn, group, srv).status == 1);
+    char src_out[] = "1";
+    char dest_in[] = "2";
+    REQUIRE (persist::insert_into_asset_link (conn, ups, srv, INPUT_POWER_CHAIN, src_out, dest_in).status == 1);
+
+    // one asset at a time, the way get_item1 used to read it
+    auto single = [&conn](a_elmnt_id_t id) {
+        db_web_element_t item;
+        auto basic = persist::select_asset_element_web_byId (conn, id);
+        REQUIRE (basic.status == 1);
+        item.basic = basic.item;
+        auto ext = persist::select_ext_attributes (conn, id);
+        REQUIRE (ext.status == 1);
+        item.ext = ext.item;
+        auto groups = persist::select_asset_element_groups (conn, id);
+        REQUIRE (groups.status == 1);
+        item.groups = groups.item;
+        if (item.basic.type_id == persist::asset_type::DEVICE) {
+            auto powers = persist::select_asset_device_links_to (conn, id, INPUT_POWER_CHAIN);
+            REQUIRE (powers.status == 1);
+            item.powers = powers.item;
+        }
+        return item;
+    };
+
+    std::vector <db_web_element_t> details;
+    REQUIRE (persist::select_asset_details (conn, {srv, dc, 0xffffff, ups, rack, srv},
+        [&details](const db_web_element_t &item) { details.push_back (item); }) == 0);
+
+    // ordered by id, unknown ids skipped, duplicates once
+    REQUIRE (details.size () == 4);
+    std::vector <a_elmnt_id_t> expected {dc, rack, ups, srv};
+    for (size_t i = 0; i != details.size (); ++i) {
+        const auto &item = details [i];
+        CHECK (item.basic.id == expected [i]);
+
+        auto old = single (item.basic.id);
+        CHECK (item.basic.name == old.basic.name);
+        CHECK (item.basic.type_id == old.basic.type_id);
+        CHECK (item.basic.subtype_id == old.basic.subtype_id);
+        CHECK (item.basic.subtype_name == old.basic.subtype_name);
+        CHECK (item.basic.parent_id == old.basic.parent_id);
+        CHECK (item.basic.parent_name == old.basic.parent_name);
+        CHECK (item.basic.status == old.basic.status);
+        CHECK (item.basic.priority == old.basic.priority);
+        CHECK (item.basic.asset_tag == old.basic.asset_tag);
+        CHECK (item.ext == old.ext);
+        CHECK (item.groups == old.groups);
+        CHECK (item.powers.size () == old.powers.size ());
+    }
+
+    const auto &server = details [3];
+    CHECK (server.ext.at ("u_size") == std::make_pair (std::string ("2"), true));
+    CHECK (server.groups.at (group) == "details-test-group");
+    REQUIRE (server.powers.size () == 1);
+    CHECK (server.powers [0].src_id == ups);
+    CHECK (server.powers [0].src_name == "details-test-ups");
+    CHECK (server.powers [0].src_socket == "1");
+    CHECK (server.powers [0].dest_socket == "2");
+    REQUIRE (server.parents.size () == 2);
+    CHECK (std::get<0> (server.parents [0]) == rack);
+    CHECK (std::get<0> (server.parents [1]) == dc);
+    CHECK (details [0].parents.empty ());
+
+    // names given to the bulk endpoint are resolved at once
+    std::map <std::string, a_elmnt_id_t> ids;
+    REQUIRE (persist::names_to_asset_ids (conn, {"details-test-srv", "details-test-dc", "details-test-none"}, ids) == 0);
+    CHECK (ids.size () == 2);
+    CHECK (ids ["details-test-srv"] == srv);
+    CHECK (ids ["details-test-dc"] == dc);
+
+    trans.rollback ();
+    persist::invalidate_asset_closure ();
+}
@@ -0,0 +1,229 @@
+/*
+ *
+ * Copyright (C) 2015 Eaton
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*!
+ * \file test-power-topology.cc
+ * \brief Tests of the in-memory power accounting and its comparison
+ *        with select_links_by_container
+ */
+#include <catch.hpp>
+
+#include <chrono>
+#include <set>
+#include <tntdb/transaction.h>
+#include <tntdb/row.h>
+
+#include "dbpath.h"
+#include "log.h"
+
+#include "asset_types.h"
+#include "assetcrud.h"
+#include "db/assets.h"
+#include "db/asset_closure.h"
+#include "db/power_topology.h"
+
+typedef std::vector<a_elmnt_id_t> ids_t;
+
+TEST_CASE("power topology", "[power_topology]")
+{
+    using namespace persist;
+
+    //  DC 1 - ROOM 2 - ROW 3 - RACK 4 - ups 11 (fed by feed 10)
+    //                                 - epdu 12 (fed by ups 11)
+    //                        - RACK 5 - epdu 13 (fed by ups 11)
+    //                                 - server 14 (fed by epdu 13)
+    //                                 - epdu 15
+    //       - feed 10
+    std::vector<PowerTopology::asset_t> assets {
+        {1, 0, 0}, {2, 1, 0}, {3, 2, 0}, {4, 3, 0}, {5, 3, 0},
+        {10, 1, asset_subtype::FEED},
+        {11, 4, asset_subtype::UPS},
+        {12, 4, asset_subtype::EPDU},
+        {13, 5, asset_subtype::EPDU},
+        {14, 5, asset_subtype::SERVER},
+        {15, 5, asset_subtype::EPDU}};
+    PowerTopology::Links links {{10, 11}, {11, 12}, {11, 13}, {13, 14}, {13, 14}};
+
+    PowerTopology topology (assets, links);
+    CHECK (topology.size () == 11);
+    CHECK (topology.contributors (1) == ids_t ({10, 15}));
+    CHECK (topology.contributors (2) == ids_t ({11, 15}));
+    CHECK (topology.contributors (3) == ids_t ({11, 15}));
+    CHECK (topology.contributors (4) == ids_t ({11}));
+    CHECK (topology.contributors (5) == ids_t ({13, 15}));
+    CHECK (topology.contributors (14).empty ());
+    CHECK (topology.contributors (42).empty ());
+
+    // incremental changes end up where a reload would
+    topology.add_link (10, 15);
+    CHECK (topology.contributors (1) == ids_t ({10}));
+    CHECK (topology.contributors (2) == ids_t ({11, 15}));
+    topology.remove_link (10, 11);
+    CHECK (topology.contributors (1) == ids_t ({10, 11}));
+
+    CHECK (!topology.remove_asset (4));
+    CHECK (topology.remove_asset (11));
+    // unknown ids are ignored
+    CHECK (topology.remove_asset (11));
+    CHECK (topology.contributors (1) == ids_t ({10, 12, 13}));
+    CHECK (topology.contributors (4) == ids_t ({12}));
+
+    CHECK (topology.add_asset ({16, 4, asset_subtype::UPS}));
+    CHECK (!topology.add_asset ({16, 4, asset_subtype::UPS}));
+    topology.add_link (16, 12);
+    CHECK (topology.contributors (4) == ids_t ({16}));
+
+    // epdu 13 moves next to ups 16 which feeds it, server 14 stays on it
+    CHECK (topology.update ({13, 4, asset_subtype::EPDU}, {16}));
+    CHECK (topology.contributors (4) == ids_t ({16}));
+    CHECK (topology.contributors (5) == ids_t ({15}));
+    // nothing moved
+    CHECK (topology.update ({5, 3, 0}, {}));
+    // the racks of devices in a moved rack are not known
+    CHECK (!topology.update ({4, 2, 0}, {}));
+
+    PowerTopology reloaded (
+        {{1, 0, 0}, {2, 1, 0}, {3, 2, 0}, {4, 3, 0}, {5, 3, 0},
+         {10, 1, asset_subtype::FEED},
+         {12, 4, asset_subtype::EPDU},
+         {13, 4, asset_subtype::EPDU},
+         {14, 5, asset_subtype::SERVER},
+         {15, 5, asset_subtype::EPDU},
+         {16, 4, asset_subtype::UPS}},
+        {{10, 15}, {16, 12}, {16, 13}, {13, 14}});
+    CHECK (reloaded.size () == topology.size ());
+    for (a_elmnt_id_t id : {1, 2, 3, 4, 5})
+        CHECK (reloaded.contributors (id) == topology.contributors (id));
+    CHECK (topology.contributors (1) == ids_t ({10, 16}));
+    CHECK (topology.contributors (2) == ids_t ({15, 16}));
+
+    // a copy is changed on its own
+    PowerTopology copy (topology);
+    copy.remove_link (16, 13);
+    CHECK (copy.contributors (4) == ids_t ({13, 16}));
+    CHECK (topology.contributors (4) == ids_t ({16}));
+
+    // a parent cycle does not hang
+    PowerTopology cycle ({{1, 2, 0}, {2, 1, 0}, {3, 2, asset_subtype::UPS}}, {});
+    CHECK (cycle.contributors (2) == ids_t ({3}));
+}
+
+// contributors of container computed the old way, from the links touching it
+static ids_t
+s_sql_contributors (tntdb::Connection &conn, a_elmnt_id_t container)
+{
+    std::set<a_elmnt_id_t> inside, power;
+    persist::select_assets_by_container (conn, container, [&inside, &power](const tntdb::Row &row) {
+        a_elmnt_id_t id = 0;
+        a_elmnt_stp_id_t subtype = 0;
+        row["asset_id"].get (id);
+        row["subtype_id"].get (subtype);
+        inside.insert (id);
+        if (persist::PowerTopology::is_power_device (subtype))
+            power.insert (id);
+    });
+    auto links = select_links_by_container (conn, container);
+    REQUIRE (links.status == 1);
+    for (const auto &link : links.item) {
+        if (inside.count (link.first))
+            power.erase (link.second);
+    }
+    return ids_t (power.begin (), power.end ());
+}
+
+// 1 DC, 10 rooms, 10 rows per room, 10 racks per row, a feed per room,
+// an ups per row, 2 epdus and 10 servers per rack
+TEST_CASE("power topology 1k racks", "[db][power_topology][.][benchmark]")
+{
+    static const int N = 10;
+    static const int SERVERS = 10;
+
+    log_open ();
+    tntdb::Connection conn = tntdb::connectCached (url);
+    tntdb::Transaction trans (conn);
+
+    auto insert = [&conn](const std::string &name, a_elmnt_tp_id_t type, a_elmnt_id_t parent, a_dvc_tp_id_t subtype) {
+        auto ret = persist::insert_into_asset_element (conn, name.c_str (), type, parent, "active", 1, subtype, name.c_str (), true);
+        REQUIRE (ret.status == 1);
+        return (a_elmnt_id_t) ret.rowid;
+    };
+    auto link = [&conn](a_elmnt_id_t src, a_elmnt_id_t dest) {
+        auto ret = persist::insert_into_asset_link (conn, src, dest, INPUT_POWER_CHAIN, SRCOUT_DESTIN_IS_NULL, SRCOUT_DESTIN_IS_NULL);
+        REQUIRE (ret.status == 1);
+    };
+
+    ids_t racks;
+    a_elmnt_id_t dc = insert ("bench-dc", persist::asset_type::DATACENTER, 0, 0);
+    for (int i = 0; i != N; ++i) {
+        std::string room_name = "bench-room-" + std::to_string (i);
+        a_elmnt_id_t room = insert (room_name, persist::asset_type::ROOM, dc, 0);
+        a_elmnt_id_t feed = insert (room_name + "-feed", persist::asset_type::DEVICE, room, persist::asset_subtype::FEED);
+        for (int j = 0; j != N; ++j) {
+            std::string row_name = "bench-row-" + std::to_string (i) + "-" + std::to_string (j);
+            a_elmnt_id_t row = insert (row_name, persist::asset_type::ROW, room, 0);
+            a_elmnt_id_t ups = insert (row_name + "-ups", persist::asset_type::DEVICE, row, persist::asset_subtype::UPS);
+            link (feed, ups);
+            for (int k = 0; k != N; ++k) {
+                std::string rack_name = row_name + "-rack-" + std::to_string (k);
+                a_elmnt_id_t rack = insert (rack_name, persist::asset_type::RACK, row, 0);
+                racks.push_back (rack);
+                a_elmnt_id_t epdu[2];
+                for (int e = 0; e != 2; ++e) {
+                    epdu[e] = insert (rack_name + "-epdu-" + std::to_string (e), persist::asset_type::DEVICE, rack, persist::asset_subtype::EPDU);
+                    link (ups, epdu[e]);
+                }
+                for (int s = 0; s != SERVERS; ++s) {
+                    a_elmnt_id_t server = insert (rack_name + "-srv-" + std::to_string (s), persist::asset_type::DEVICE, rack, persist::asset_subtype::SERVER);
+                    link (epdu[0], server);
+                    link (epdu[1], server);
+                }
+            }
+        }
+    }
+    persist::invalidate_asset_closure ();
+
+    auto start = std::chrono::steady_clock::now ();
+    std::vector<ids_t> expected;
+    for (const auto rack : racks)
+        expected.push_back (s_sql_contributors (conn, rack));
+    std::chrono::duration<double> sql = std::chrono::steady_clock::now () - start;
+
+    start = std::chrono::steady_clock::now ();
+    persist::PowerTopologyPtr topology = persist::power_topology (conn);
+    std::chrono::duration<double> load = std::chrono::steady_clock::now () - start;
+
+    start = std::chrono::steady_clock::now ();
+    std::vector<ids_t> computed;
+    for (const auto rack : racks)
+        computed.push_back (topology->contributors (rack));
+    std::chrono::duration<double> engine = std::chrono::steady_clock::now () - start;
+
+    CHECK (computed == expected);
+    CHECK (computed.front ().size () == 2);
+    CHECK (topology->contributors (dc).size () == N);
+
+    printf ("power contributors of %zu racks:\n", racks.size ());
+    printf ("  links by container: %8.3f s\n", sql.count ());
+    printf ("  topology load:      %8.3f s\n", load.count ());
+    printf ("  topology:           %8.3f s\n", engine.count ());
+
+    trans.rollback ();
+    persist::invalidate_asset_closure ();
+}
@@ -0,0 +1,111 @@
+/*
+ *
+ * Copyright (C) 2015 Eaton
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*!
+ * \file test-rack-capacity.cc
+ * \brief Tests of the rack capacity index
+ */
+#include <catch.hpp>
+
+#include "asset_types.h"
+#include "db/rack_capacity.h"
+
+TEST_CASE("rack capacity", "[rack_capacity]")
+{
+    using namespace persist;
+    typedef RackCapacity::asset_t asset_t;
+
+    //  ROW 1 - RACK 2 (42U) - epdu 10 (24 outlets, 1U)
+    //                       - server 11 (2U, fed by 10 twice)
+    //                       - chassis 12 (10U) - blade 13 (fed by 10)
+    //        - RACK 3       - pdu 20 (outlet.count unknown)
+    asset_t row     {1, 0, asset_type::ROW, 0, 0, -1, {}};
+    asset_t rack2   {2, 1, asset_type::RACK, 0, 42, -1, {}};
+    asset_t rack3   {3, 1, asset_type::RACK, 0, 0, -1, {}};
+    asset_t epdu    {10, 2, asset_type::DEVICE, asset_subtype::EPDU, 1, 24, {}};
+    asset_t server  {11, 2, asset_type::DEVICE, asset_subtype::SERVER, 2, -1, {10, 10}};
+    asset_t chassis {12, 2, asset_type::DEVICE, asset_subtype::CHASSIS, 10, -1, {}};
+    asset_t blade   {13, 12, asset_type::DEVICE, asset_subtype::SERVER, 0, -1, {10}};
+    asset_t pdu     {20, 3, asset_type::DEVICE, asset_subtype::PDU, 0, -1, {}};
+
+    RackCapacity index ({row, rack2, rack3, epdu, server, chassis, blade, pdu});
+    CHECK (index.size () == 8);
+
+    rack_capacity_t capacity;
+    REQUIRE (index.get (2, capacity));
+    CHECK (capacity.size_u == 42);
+    CHECK (capacity.used_u == 13);
+    CHECK (capacity.free_u == 29);
+    CHECK (capacity.outlets_free == 21);
+    CHECK (capacity.outlets.size () == 1);
+    CHECK (capacity.outlets.at (10) == 21);
+
+    REQUIRE (index.get (3, capacity));
+    CHECK (capacity.free_u == -1);
+    CHECK (capacity.outlets_free == -1);
+    CHECK (capacity.outlets.at (20) == -1);
+
+    CHECK (!index.get (1, capacity));
+    CHECK (!index.get (11, capacity));
+
+    // the server moves to rack 3 and gets one power source less
+    server.parent = 3;
+    server.sources = {10};
+    CHECK (index.update (server));
+    REQUIRE (index.get (2, capacity));
+    CHECK (capacity.used_u == 11);
+    CHECK (capacity.outlets_free == 22);
+    REQUIRE (index.get (3, capacity));
+    CHECK (capacity.used_u == 2);
+
+    // u_size and outlet.count change
+    chassis.u_size = 8;
+    CHECK (index.update (chassis));
+    epdu.outlet_count = 48;
+    CHECK (index.update (epdu));
+    REQUIRE (index.get (2, capacity));
+    CHECK (capacity.used_u == 9);
+    CHECK (capacity.outlets_free == 46);
+
+    // a device with children can't move, one without can go away
+    chassis.parent = 3;
+    CHECK (!index.update (chassis));
+    CHECK (!index.remove (12));
+    CHECK (index.remove (13));
+    CHECK (index.remove (42));
+    REQUIRE (index.get (2, capacity));
+    CHECK (capacity.outlets_free == 47);
+
+    // a rack moves with everything inside, a new one starts empty
+    rack2.parent = 0;
+    CHECK (index.update (rack2));
+    CHECK (index.update ({4, 1, asset_type::RACK, 0, 47, -1, {}}));
+    REQUIRE (index.get (4, capacity));
+    CHECK (capacity.free_u == 47);
+    CHECK (capacity.outlets.empty ());
+    CHECK (capacity.outlets_free == 0);
+    REQUIRE (index.get (2, capacity));
+    CHECK (capacity.used_u == 9);
+
+    CHECK (index.remove (10));
+    REQUIRE (index.get (2, capacity));
+    CHECK (capacity.outlets.empty ());
+    CHECK (capacity.used_u == 8);
+}
@@ -2495,3 +2495,59 @@ TEST_CASE("Location topology from #27","[db][topology][location][location_topolo
     asset_msg_destroy (&getmsg);
     asset_msg_destroy (&cretTopology);
 }
+
+TEST_CASE("Location topology from flat","[db][topology][location][location_topology.sql][from][lfflat]")
+{
+    log_open();
+
+    location_topology_t topology;
+    REQUIRE ( select_location_topology_from (url.c_str(), 5019, 7, true, 0, topology) == DB_ERROR_NOTFOUND );
+    REQUIRE ( topology.empty () );
+
+    // DC_LOC_01, recursive, without the filter
+    REQUIRE ( select_location_topology_from (url.c_str(), 7000, 7, true, 0, topology) == 0 );
+    REQUIRE ( !topology.empty () );
+    CHECK ( topology[0].id == 7000 );
+    CHECK ( topology[0].name == "DC_LOC_01" );
+    CHECK ( topology[0].end == topology.size () );
+
+    // preorder: every subtree lies inside its parent, children of one
+    // type are adjacent and types go datacenters .. devices, groups last
+    for ( size_t i = 0; i != topology.size (); ++i )
+    {
+        INFO ( topology[i].name );
+        REQUIRE ( topology[i].end > i );
+        REQUIRE ( topology[i].end <= topology.size () );
+        int last_order = 0;
+        for ( size_t child = i + 1; child < topology[i].end; child = topology[child].end )
+        {
+            REQUIRE ( topology[child].end <= topology[i].end );
+            int order = topology[child].type_id == persist::asset_type::GROUP ? 7 : topology[child].type_id;
+            REQUIRE ( order >= last_order );
+            last_order = order;
+        }
+    }
+
+    // the same elements as the message interface
+    _scoped_asset_msg_t* getmsg = asset_msg_new (ASSET_MSG_GET_LOCATION_FROM);
+    asset_msg_set_element_id  (getmsg, 7000);
+    asset_msg_set_filter_type (getmsg, 7);
+    asset_msg_set_recursive   (getmsg, true);
+    _scoped_zmsg_t* retTopology = get_return_topology_from (url.c_str(), getmsg);
+    REQUIRE ( is_asset_msg (retTopology) );
+    _scoped_asset_msg_t* cretTopology = asset_msg_decode (&retTopology);
+    REQUIRE ( cretTopology );
+
+    edge_lf edges;
+    for ( zframe_t *frame : { asset_msg_dcs (cretTopology), asset_msg_rooms (cretTopology),
+                              asset_msg_rows (cretTopology), asset_msg_racks (cretTopology),
+                              asset_msg_devices (cretTopology), asset_msg_grps (cretTopology) } )
+    {
+        auto r = print_frame_to_edges (frame, 7000, persist::asset_type::DATACENTER, "DC_LOC_01", "N_A");
+        edges.insert (r.begin (), r.end ());
+    }
+    CHECK ( edges.size () == topology.size () - 1 );
+
+    asset_msg_destroy (&getmsg);
+    asset_msg_destroy (&cretTopology);
+}
@@ -0,0 +1,134 @@
+/*
+ *
+ * Copyright (C) 2015 Eaton
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*!
+ * \file test-asset-types.cc
+ * \brief Tests of the element and device type registry
+ */
+#include <catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "asset_types.h"
+
+// the if/else cascade the registry replaced
+static a_elmnt_stp_id_t
+s_cascade_subtype_to_subtypeid (const std::string &subtype)
+{
+    std::string st (subtype);
+    std::transform (st.begin (), st.end (), st.begin (), ::tolower);
+    if (st == "ups") return persist::asset_subtype::UPS;
+    else if (st == "genset") return persist::asset_subtype::GENSET;
+    else if (st == "epdu") return persist::asset_subtype::EPDU;
+    else if (st == "server") return persist::asset_subtype::SERVER;
+    else if (st == "pdu") return persist::asset_subtype::PDU;
+    else if (st == "feed") return persist::asset_subtype::FEED;
+    else if (st == "sts") return persist::asset_subtype::STS;
+    else if (st == "switch") return persist::asset_subtype::SWITCH;
+    else if (st == "storage") return persist::asset_subtype::STORAGE;
+    else if (st == "vm") return persist::asset_subtype::VIRTUAL;
+    else if (st == "router") return persist::asset_subtype::ROUTER;
+    else if (st == "rack controller") return persist::asset_subtype::RACKCONTROLLER;
+    else if (st == "sensor") return persist::asset_subtype::SENSOR;
+    else if (st == "appliance") return persist::asset_subtype::APPLIANCE;
+    else if (st == "chassis") return persist::asset_subtype::CHASSIS;
+    else if (st == "patch panel") return persist::asset_subtype::PATCHPANEL;
+    else if (st == "other") return persist::asset_subtype::OTHER;
+    else if (st == "n_a") return persist::asset_subtype::N_A;
+    else if (st == "") return persist::asset_subtype::N_A;
+    else return persist::asset_subtype::SUNKNOWN;
+}
+
+TEST_CASE ("asset types", "[asset_types]")
+{
+    using namespace persist;
+
+    CHECK (type_to_typeid ("datacenter") == asset_type::DATACENTER);
+    CHECK (type_to_typeid ("Rack") == asset_type::RACK);
+    CHECK (type_to_typeid ("GROUP") == asset_type::GROUP);
+    CHECK (type_to_typeid ("racks") == asset_type::TUNKNOWN);
+    CHECK (type_to_typeid ("") == asset_type::TUNKNOWN);
+    CHECK (typeid_to_type (asset_type::DEVICE) == "device");
+    CHECK (typeid_to_type (asset_type::TUNKNOWN) == "unknown");
+    CHECK (typeid_to_type (42) == "unknown");
+
+    CHECK (subtype_to_subtypeid ("Patch Panel") == asset_subtype::PATCHPANEL);
+    CHECK (subtype_to_subtypeid ("vm") == asset_subtype::VIRTUAL);
+    CHECK (subtype_to_subtypeid ("N_A") == asset_subtype::N_A);
+    CHECK (subtype_to_subtypeid ("") == asset_subtype::N_A);
+    CHECK (subtype_to_subtypeid ("rc") == asset_subtype::SUNKNOWN);
+    CHECK (subtypeid_to_subtype (asset_subtype::RACKCONTROLLER) == "rack controller");
+    CHECK (subtypeid_to_subtype (asset_subtype::N_A) == "N_A");
+    CHECK (subtypeid_to_subtype (asset_subtype::SUNKNOWN) == "unknown");
+    CHECK (subtypeid_to_subtype (1000) == "unknown");
+
+    // every id survives the round trip and agrees with the old cascade
+    for (a_elmnt_tp_id_t id = asset_type::GROUP; id <= asset_type::DEVICE; ++id)
+        CHECK (type_to_typeid (typeid_to_type (id)) == id);
+    for (a_elmnt_stp_id_t id = asset_subtype::UPS; id <= asset_subtype::OTHER; ++id) {
+        CHECK (subtype_to_subtypeid (subtypeid_to_subtype (id)) == id);
+        CHECK (s_cascade_subtype_to_subtypeid (subtypeid_to_subtype (id)) == id);
+    }
+
+    // dictionaries for the csv import
+    CHECK (element_types ().size () == 6);
+    CHECK (element_types ().at ("room") == asset_type::ROOM);
+    CHECK (device_types ().size () == asset_subtype::OTHER);
+    CHECK (device_types ().at ("patch panel") == asset_subtype::PATCHPANEL);
+    CHECK (device_types ().count ("") == 0);
+}
+
+TEST_CASE ("asset types conversions", "[asset_types][.][benchmark]")
+{
+    using namespace persist;
+    static const int N = 1000000;
+
+    std::vector <std::string> names;
+    for (a_elmnt_stp_id_t id = asset_subtype::UPS; id <= asset_subtype::OTHER; ++id)
+        names.push_back (subtypeid_to_subtype (id));
+
+    size_t sum = 0;
+    auto start = std::chrono::steady_clock::now ();
+    for (int i = 0; i != N; ++i)
+        sum += s_cascade_subtype_to_subtypeid (names [i % names.size ()]);
+    std::chrono::duration<double> cascade = std::chrono::steady_clock::now () - start;
+
+    size_t sum2 = 0;
+    start = std::chrono::steady_clock::now ();
+    for (int i = 0; i != N; ++i)
+        sum2 += subtype_to_subtypeid (names [i % names.size ()]);
+    std::chrono::duration<double> registry = std::chrono::steady_clock::now () - start;
+    CHECK (sum == sum2);
+
+    start = std::chrono::steady_clock::now ();
+    size_t length = 0;
+    for (int i = 0; i != N; ++i)
+        length += subtypeid_to_subtype (1 + i % asset_subtype::OTHER).size ();
+    std::chrono::duration<double> by_id = std::chrono::steady_clock::now () - start;
+    CHECK (length > 0);
+
+    printf ("%d subtype conversions:\n", N);
+    printf ("  name -> id, if/else cascade: %8.3f s\n", cascade.count ());
+    printf ("  name -> id, registry:        %8.3f s\n", registry.count ());
+    printf ("  id -> name, registry:        %8.3f s\n", by_id.count ());
+}
@@ -26,6 +26,11 @@
  */
 #include <catch.hpp>
 #include <cidr.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace shared;
 
@@ -91,3 +96,251 @@ TEST_CASE("CIDR list","[cidr][list iterating]") {
   REQUIRE( ! a.valid() );
 }
 
+
+// address by address evaluation of the rules documented in cidr.h
+static bool s_listed(const std::vector<CIDRAddress>& includes,
+                     const std::vector<CIDRAddress>& excludes,
+                     const CIDRAddress& address) {
+  CIDRAddress best;
+  int iprefix = -1, eprefix = -1;
+  for( const auto& net : includes ) {
+    if( net.contains(address) && net.prefix() > iprefix ) {
+      iprefix = net.prefix();
+      best = net;
+    }
+  }
+  for( const auto& net : excludes ) {
+    if( net.contains(address) && net.prefix() > eprefix ) eprefix = net.prefix();
+  }
+  if( iprefix == -1 || eprefix >= iprefix ) return false;
+  if( best.protocol() == 4 && iprefix < 31 ) {
+    return address != best.network().host() && address != best.broadcast().host();
+  }
+  if( best.protocol() == 6 && iprefix < 127 ) {
+    return address != best.network().host();
+  }
+  return true;
+}
+
+TEST_CASE("CIDR list against address by address evaluation","[cidr][list iterating]") {
+  // nested and overlapping networks in 10.0.0.0/22
+  const char *includes[] = { "10.0.0.0/22", "10.0.1.0/24", "10.0.1.64/26", "10.0.2.16/28",
+                             "10.0.2.17/32", "10.0.3.250/31", "10.0.0.0/30", "10.0.4.0/30" };
+  const char *excludes[] = { "10.0.1.0/25", "10.0.1.64/27", "10.0.2.0/24", "10.0.3.128/25",
+                             "10.0.0.0/30", "10.0.4.3/32", "10.0.3.250/32" };
+  CIDRList L;
+  std::vector<CIDRAddress> inc, exc;
+  for( const char *net : includes ) { REQUIRE( L.add(net) ); inc.emplace_back(net); }
+  for( const char *net : excludes ) { REQUIRE( L.exclude(net) ); exc.emplace_back(net); }
+  REQUIRE( ! L.add("10.0.1.0/24") );
+  REQUIRE( ! L.exclude("10.0.1.0/25") );
+
+  std::vector<std::string> expected, listed;
+  CIDRAddress a("9.255.255.0");
+  for( int i = 0; i < 2048; i++, ++a ) {
+    if( s_listed(inc, exc, a) ) expected.push_back(a.toString());
+  }
+  a.invalidate();
+  while( L.next(a) ) listed.push_back(a.toString());
+  REQUIRE( ! a.valid() );
+  REQUIRE( ! expected.empty() );
+  CHECK( listed == expected );
+
+  // the iteration may continue from any address
+  a = "10.0.1.100";
+  REQUIRE( L.next(a) );
+  CHECK( a.toString() == "10.0.1.101" );
+  a = "10.0.2.0";
+  REQUIRE( L.next(a) );
+  CHECK( a.toString() == "10.0.2.17" );
+  a = "10.0.4.2";
+  CHECK( ! L.next(a) );
+  CHECK( ! a.valid() );
+}
+
+TEST_CASE("CIDR list includes and excludes","[cidr][list]") {
+  CIDRList L;
+  L.add("10.0.0.0/16");
+  L.add("10.1.0.0/24");
+  L.add("10.0.5.0/24");
+  L.exclude("10.0.5.0/24");
+  L.add("::ffff:0:0/96");
+  CHECK( L.includes(CIDRAddress("10.0.0.0/16")) );
+  CHECK( L.includes(CIDRAddress("10.0.200.1")) );
+  CHECK( L.includes(CIDRAddress("10.1.0.0/25")) );
+  CHECK( ! L.includes(CIDRAddress("10.0.0.0/15")) );
+  CHECK( ! L.includes(CIDRAddress("10.1.1.1")) );
+  CHECK( ! L.includes(CIDRAddress("9.255.255.255")) );
+  CHECK( L.includes(CIDRAddress("::ffff:10.0.0.1")) );
+  CHECK( ! L.includes(CIDRAddress("::1")) );
+  CHECK( ! L.includes(CIDRAddress()) );
+  CHECK( L.excludes(CIDRAddress("10.0.5.7")) );
+  CHECK( ! L.excludes(CIDRAddress("10.0.6.7")) );
+  // exclude wins for the same prefix
+  CIDRAddress a("10.0.4.255");
+  REQUIRE( L.next(a) );
+  CHECK( a.toString() == "10.0.6.0" );
+}
+
+TEST_CASE("CIDR list IPv6","[cidr][list iterating]") {
+  CIDRList L;
+  L.add("2001:db8::/126");
+  L.add("2001:db8::ff/128");
+  L.exclude("2001:db8::2/127");
+  L.add("192.168.0.4/30");
+  CIDRAddress a;
+  std::vector<std::string> listed;
+  while( L.next(a) ) listed.push_back(a.toString());
+  // IPv4 first, no subnet-router anycast and no broadcast in IPv6
+  std::vector<std::string> expected = { "192.168.0.5", "192.168.0.6", "2001:db8::1", "2001:db8::ff" };
+  CHECK( listed == expected );
+
+  CIDRList L2;
+  L2.add("ffff:ffff:ffff:ffff:ffff:ffff:ffff:fffe/127");
+  // :: is never listed
+  L2.add("::1/127");
+  listed.clear();
+  while( L2.next(a) ) listed.push_back(a.toString());
+  expected = { "::1", "ffff:ffff:ffff:ffff:ffff:ffff:ffff:fffe", "ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff" };
+  CHECK( listed == expected );
+}
+
+static std::vector<std::string> s_walk(CIDRList& list) {
+  std::vector<std::string> result;
+  CIDRAddress a;
+  while( list.next(a) ) result.push_back(a.toString());
+  return result;
+}
+
+static void s_fill(CIDRList& list) {
+  list.add("10.0.0.0/22");
+  list.add("10.0.1.64/26");
+  list.add("10.0.9.0/31");
+  list.add("2001:db8::/120");
+  list.exclude("10.0.1.0/25");
+  list.exclude("10.0.2.0/24");
+  list.exclude("10.0.3.200/29");
+  list.exclude("2001:db8::80/121");
+}
+
+TEST_CASE("CIDR list split","[cidr][list iterating]") {
+  CIDRList L;
+  s_fill(L);
+  std::vector<std::string> sequential = s_walk(L);
+  REQUIRE( L.size() == sequential.size() );
+
+  for( size_t n = 1; n <= 9; n++ ) {
+    std::vector<CIDRPart> parts = L.split(n);
+    REQUIRE( parts.size() == n );
+    std::vector<std::string> joined;
+    uint64_t smallest = UINT64_MAX, biggest = 0;
+    for( auto& part : parts ) {
+      smallest = std::min(smallest, part.size());
+      biggest = std::max(biggest, part.size());
+      CIDRAddress a;
+      while( part.next(a) ) joined.push_back(a.toString());
+      CHECK( ! a.valid() );
+    }
+    CHECK( joined == sequential );
+    CHECK( biggest <= smallest + 1 );
+  }
+
+  std::vector<CIDRPart> parts = L.split(2);
+  CHECK( parts[0].firstAddress().toString() == sequential.front() );
+  CHECK( parts[1].lastAddress().toString() == sequential.back() );
+
+  CIDRList small;
+  small.add("10.0.0.1/32");
+  small.add("10.0.0.3/32");
+  CHECK( small.split(5).size() == 2 );
+  CHECK( small.split(0).empty() );
+  CHECK( CIDRList().split(3).empty() );
+  CHECK( CIDRPart().size() == 0 );
+  CHECK( ! CIDRPart().firstAddress().valid() );
+}
+
+TEST_CASE("CIDR list walker","[cidr][list iterating]") {
+  CIDRList L;
+  s_fill(L);
+  std::vector<std::string> sequential = s_walk(L);
+
+  SECTION("one worker walks in order") {
+    CIDRWalker walker(L, 1);
+    std::vector<std::string> walked;
+    CIDRAddress a;
+    while( walker.next(0, a) ) walked.push_back(a.toString());
+    CHECK( ! a.valid() );
+    CHECK( walked == sequential );
+  }
+
+  SECTION("idle workers take over the rest") {
+    // worker 0 never asks, 1 and 2 walk its part too
+    CIDRWalker walker(L, 3);
+    std::vector<std::string> walked;
+    CIDRAddress a;
+    while( walker.next(1, a) ) walked.push_back(a.toString());
+    CHECK( ! walker.next(2, a) );
+    CHECK( ! walker.next(0, a) );
+    CHECK( ! walker.next(3, a) );
+    std::sort(walked.begin(), walked.end());
+    std::vector<std::string> expected = sequential;
+    std::sort(expected.begin(), expected.end());
+    CHECK( walked == expected );
+  }
+
+  SECTION("threads") {
+    const size_t workers = 4;
+    CIDRWalker walker(L, workers);
+    REQUIRE( walker.workers() == workers );
+    std::vector<std::vector<std::string>> walked(workers);
+    std::vector<std::thread> threads;
+    for( size_t i = 0; i < workers; i++ ) {
+      threads.emplace_back([&walker, &walked, i]() {
+        CIDRAddress a;
+        while( walker.next(i, a) ) {
+          walked[i].push_back(a.toString());
+          // worker 0 is slow, the others steal from it
+          if( i == 0 ) std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+      });
+    }
+    for( auto& t : threads ) t.join();
+
+    std::vector<std::string> all;
+    for( const auto& w : walked ) all.insert(all.end(), w.begin(), w.end());
+    std::sort(all.begin(), all.end());
+    std::vector<std::string> expected = sequential;
+    std::sort(expected.begin(), expected.end());
+    CHECK( all == expected );
+    CHECK( walked[0].size() < sequential.size() / workers );
+  }
+}
+
+TEST_CASE("CIDR list iteration benchmark","[.][benchmark][cidr]") {
+  const char *excludes[] = { "10.10.0.0/24", "10.10.17.0/24", "10.10.128.0/18", "10.10.200.0/21",
+                             "10.10.255.0/25", "10.10.64.32/27" };
+  CIDRList L;
+  std::vector<CIDRAddress> inc, exc;
+  L.add("10.10.0.0/16");
+  inc.emplace_back("10.10.0.0/16");
+  for( const char *net : excludes ) { L.exclude(net); exc.emplace_back(net); }
+
+  auto start = std::chrono::steady_clock::now();
+  size_t reference = 0;
+  CIDRAddress a("10.10.0.0");
+  for( int i = 0; i < 65536; i++, ++a ) {
+    if( s_listed(inc, exc, a) ) reference++;
+  }
+  auto middle = std::chrono::steady_clock::now();
+  size_t listed = 0;
+  a.invalidate();
+  while( L.next(a) ) listed++;
+  auto end = std::chrono::steady_clock::now();
+
+  CHECK( listed == reference );
+  std::cout << "/16 with " << exc.size() << " excludes, " << listed << " addresses: "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(middle - start).count()
+            << " ms address by address, "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(end - middle).count()
+            << " ms CIDRList::next" << std::endl;
+}
@@ -0,0 +1,140 @@
+/*
+ *
+ * Copyright (C) 2015 Eaton
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*!
+ * \file test-config-store.cc
+ * \brief Tests of the cached /config files
+ */
+#include <catch.hpp>
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cxxtools/jsondeserializer.h>
+
+#include "config_store.h"
+#include "utils_web.h"
+
+static cxxtools::SerializationInfo
+s_document (const std::string& json)
+{
+    std::stringstream input {json};
+    cxxtools::JsonDeserializer deserializer (input);
+    cxxtools::SerializationInfo si;
+    deserializer.deserialize (si);
+    return si;
+}
+
+// what other processes do: write a new file and rename it over the old one
+static void
+s_replace (const std::string& path, const char *key, const char *value)
+{
+    zconfig_t *root = zconfig_new ("root", NULL);
+    zconfig_put (root, key, value);
+    std::string tmp = path + ".other";
+    REQUIRE (zconfig_save (root, tmp.c_str ()) == 0);
+    REQUIRE (rename (tmp.c_str (), path.c_str ()) == 0);
+    zconfig_destroy (&root);
+}
+
+TEST_CASE ("config store", "[config_store]")
+{
+    char dir_template [] = "/tmp/test-config-store-XXXXXX";
+    REQUIRE (mkdtemp (dir_template));
+    std::string dir = dir_template;
+
+    utils::config::ConfigStore store (dir);
+    const std::string general = dir + utils::config::get_path ("BIOS_SNMP_COMMUNITY_NAME");
+    const std::string smtp = dir + utils::config::get_path ("BIOS_SMTP_SERVER");
+
+    std::string value;
+    std::vector <std::string> array;
+    CHECK (!store.get ("BIOS_SMTP_SERVER", value, array));
+
+    // one write per file for several keys
+    store.put (s_document (
+        "{"
+        "\"BIOS_SMTP_SERVER\" : \"mail.example.com\","
+        "\"BIOS_SMTP_PORT\" : \"25\","
+        "\"BIOS_SNMP_COMMUNITY_NAME\" : [\"foo\", \"bar\"]"
+        "}"));
+    size_t loads = store.loads ();
+
+    REQUIRE (store.get ("BIOS_SMTP_SERVER", value, array));
+    CHECK (value == "mail.example.com");
+    CHECK (array.empty ());
+    REQUIRE (store.get ("BIOS_SNMP_COMMUNITY_NAME", value, array));
+    CHECK (array == std::vector <std::string> ({"foo", "bar"}));
+    CHECK (!store.get ("BIOS_SMTP_USER", value, array));
+    CHECK (store.loads () == loads);
+
+    zconfig_t *saved = zconfig_load (smtp.c_str ());
+    REQUIRE (saved);
+    CHECK (streq (zconfig_get (saved, "smtp/port", ""), "25"));
+    zconfig_destroy (&saved);
+    struct stat st;
+    CHECK (stat ((smtp + ".tmp").c_str (), &st) == -1);
+
+    // a change from outside is seen
+    s_replace (smtp, "smtp/server", "other.example.com");
+    REQUIRE (store.get ("BIOS_SMTP_SERVER", value, array));
+    CHECK (value == "other.example.com");
+    CHECK (store.loads () == loads + 1);
+    CHECK (!store.get ("BIOS_SMTP_PORT", value, array));
+
+    // the mode of the file is kept
+    REQUIRE (chmod (smtp.c_str (), 0640) == 0);
+    store.put (s_document ("{\"BIOS_SMTP_USER\" : \"admin\"}"));
+    REQUIRE (stat (smtp.c_str (), &st) == 0);
+    CHECK ((st.st_mode & 0777) == 0640);
+    REQUIRE (store.get ("BIOS_SMTP_SERVER", value, array));
+    CHECK (value == "other.example.com");
+
+    // bad document changes nothing
+    CHECK_THROWS_AS (store.put (s_document (
+        "{"
+        "\"BIOS_SMTP_SERVER\" : \"bad.example.com\","
+        "\"BIOS_SNMP_COMMUNITY_NAME\" : [\"ok\", \"\\u0001\"]"
+        "}")), BiosError);
+    REQUIRE (store.get ("BIOS_SMTP_SERVER", value, array));
+    CHECK (value == "other.example.com");
+    REQUIRE (store.get ("BIOS_SNMP_COMMUNITY_NAME", value, array));
+    CHECK (array == std::vector <std::string> ({"foo", "bar"}));
+
+    // failed save of one file (general is saved first) leaves the cache
+    // with what is on disk, not with the changes never written
+    REQUIRE (unlink (general.c_str ()) == 0);
+    REQUIRE (mkdir (general.c_str (), 0755) == 0);
+    CHECK_THROWS_AS (store.put (s_document (
+        "{"
+        "\"BIOS_SNMP_COMMUNITY_NAME\" : [\"baz\"],"
+        "\"BIOS_SMTP_SERVER\" : \"unsaved.example.com\""
+        "}")), BiosError);
+    REQUIRE (store.get ("BIOS_SMTP_SERVER", value, array));
+    CHECK (value == "other.example.com");
+    REQUIRE (rmdir (general.c_str ()) == 0);
+
+    unlink (smtp.c_str ());
+    for (const auto &path : {"/etc/fty-email", "/etc/default", "/etc", ""})
+        rmdir ((dir + path).c_str ());
+}
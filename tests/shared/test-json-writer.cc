@@ -0,0 +1,171 @@
+/*
+ *
+ * Copyright (C) 2015 Eaton
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*!
+ * \file test-json-writer.cc
+ * \brief Tests of the streaming JSON writer
+ */
+#include <catch.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+#include "json_writer.h"
+#include "utils_web.h"
+
+TEST_CASE ("json writer escape", "[json_writer][escape]")
+{
+    std::vector <std::string> tests {
+        "",
+        "plain ascii",
+        "dvojite \" uvozovky",
+        "\\\"\\\"\\\"",
+        "first second \n third\n\"\n \\n \\\\\"\f\\\t\\u\u0007\\\n fourth",
+        "\b\f\n\r\t",
+        "x\\ꙪꙪ\n \\nx",
+        std::string ("nul \0 inside", 12)
+    };
+    for (const auto &item : tests) {
+        std::ostringstream out;
+        utils::json::escape (out, item);
+        CAPTURE (item);
+        // escape (const char *) stops at nul
+        CHECK (out.str () == (item.find ('\0') == std::string::npos ? utils::json::escape (item) :
+                    utils::json::escape (item.substr (0, 4)) + "\\u0000" + utils::json::escape (item.substr (5))));
+    }
+}
+
+TEST_CASE ("json writer", "[json_writer]")
+{
+    std::ostringstream out;
+    utils::json::JsonWriter json (out);
+
+    json.begin_object ()
+        .member ("name", "rack \"01\"")
+        .member ("id", 42)
+        .member ("size", uint8_t (7))
+        .member ("load", 12.5)
+        .member ("unknown", NAN)
+        .member ("enabled", true)
+        .member (std::string ("none"), (const char *) nullptr)
+        .key ("empty").begin_array ().end_array ()
+        .key ("nested").begin_array ()
+            .value ("a")
+            .begin_object ().end_object ()
+            .begin_array ().value (-1).value (false).end_array ()
+            .raw ("{\"x\":1}")
+            .null ()
+        .end_array ();
+    CHECK (json.depth () == 1);
+    json.end_object ();
+    CHECK (json.depth () == 0);
+
+    CHECK (out.str () ==
+        "{\"name\":\"rack \\\"01\\\"\",\"id\":42,\"size\":7,\"load\":12.500000,\"unknown\":null,"
+        "\"enabled\":true,\"none\":null,\"empty\":[],"
+        "\"nested\":[\"a\",{},[-1,false],{\"x\":1},null]}");
+
+    // a top level array of values
+    std::ostringstream out2;
+    utils::json::JsonWriter json2 (out2);
+    json2.begin_array ().value (std::string ("line\n")).value (1u).end_array ();
+    CHECK (out2.str () == "[\"line\\\\n\",1]");
+
+    // non-finite numbers are not valid json
+    std::ostringstream out3;
+    utils::json::JsonWriter json3 (out3);
+    json3.begin_array ().value (INFINITY).value (-INFINITY).value (-NAN).value (-0.5).end_array ();
+    CHECK (out3.str () == "[null,null,null,-0.500000]");
+}
+
+// counts, drops everything
+class CountingBuf : public std::streambuf {
+    public:
+        size_t count = 0;
+    protected:
+        std::streamsize xsputn (const char *, std::streamsize n) override { count += n; return n; }
+        int_type overflow (int_type c) override { count++; return c; }
+};
+
+static long
+s_maxrss_kb ()
+{
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+TEST_CASE ("json writer benchmark", "[.][benchmark][json_writer]")
+{
+    const size_t ROWS = 500000;
+    std::vector <std::string> names;
+    for (size_t i = 0; i != 100; i++)
+        names.push_back ("Rack \"" + std::to_string (i) + "\" in the room\twith a long description");
+
+    // the writer goes first, peak RSS only grows
+    long rss_start = s_maxrss_kb ();
+    CountingBuf written_buf;
+    std::ostream written (&written_buf);
+    auto start = std::chrono::steady_clock::now ();
+    {
+        utils::json::JsonWriter json (written);
+        json.begin_array ();
+        for (size_t i = 0; i != ROWS; i++) {
+            json.begin_object ()
+                .member ("id", "rack-" + std::to_string (i))
+                .member ("name", names [i % names.size ()])
+                .member ("u_size", 42)
+                .end_object ();
+        }
+        json.end_array ();
+    }
+    auto middle = std::chrono::steady_clock::now ();
+    long rss_middle = s_maxrss_kb ();
+
+    // what pages did: concatenate the document, then write it out
+    CountingBuf concatenated_buf;
+    std::ostream concatenated (&concatenated_buf);
+    {
+        std::string document = "[";
+        for (size_t i = 0; i != ROWS; i++) {
+            document += i == 0 ? "{" : ",{";
+            document += "\"id\":\"" + utils::json::escape ("rack-" + std::to_string (i)) + "\",";
+            document += "\"name\":\"" + utils::json::escape (names [i % names.size ()]) + "\",";
+            document += "\"u_size\":" + std::to_string (42) + "}";
+        }
+        document += "]";
+        concatenated << document;
+    }
+    auto end = std::chrono::steady_clock::now ();
+    long rss_end = s_maxrss_kb ();
+
+    CHECK (written_buf.count == concatenated_buf.count);
+    std::cout << ROWS << " objects, " << written_buf.count << " bytes: JsonWriter "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(middle - start).count()
+              << " ms, peak RSS +" << rss_middle - rss_start << " kB; concatenation "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - middle).count()
+              << " ms, peak RSS +" << rss_end - rss_middle << " kB" << std::endl;
+}
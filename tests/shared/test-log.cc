@@ -29,7 +29,11 @@
 #include <czmq.h> // for streq macro
 
 #include <cstdio>
+#include <cstring>
 #include <unistd.h>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 #include <utils.h>
 #include <log.h>
@@ -119,3 +123,164 @@ TEST_CASE("log-do_log", "[log][do_log]") {
     unlink(temp_name);
 
 }
+
+TEST_CASE("log-async", "[log][async]") {
+
+    char temp_name[128];
+    sprintf(temp_name, "test-log.XXXXXX");
+    FILE *tempf = mksftemp(temp_name);
+
+    log_set_level(LOG_DEBUG);
+    log_set_file(tempf);
+    uint64_t dropped = log_get_dropped();
+    REQUIRE(log_async_start() == 0);
+
+    do_log(LOG_ERR, "test-log", 1, "test_async", "short %d", 1);
+    // longer than a ring slot
+    std::string long_message(1000, 'x');
+    do_log(LOG_ERR, "test-log", 2, "test_async", "%s", long_message.c_str());
+    do_log(LOG_ERR, "test-log", 3, "test_async", "short %d", 3);
+
+    log_async_stop();
+    CHECK(log_get_dropped() == dropped);
+
+    rewind(tempf);
+    char buf[2048];
+    REQUIRE(fgets(buf, sizeof(buf), tempf));
+    CHECK(streq(buf, "[ERROR]: test-log:1 (test_async) short 1\n"));
+    REQUIRE(fgets(buf, sizeof(buf), tempf));
+    CHECK(streq(buf, ("[ERROR]: test-log:2 (test_async) " + long_message + "\n").c_str()));
+    REQUIRE(fgets(buf, sizeof(buf), tempf));
+    CHECK(streq(buf, "[ERROR]: test-log:3 (test_async) short 3\n"));
+    CHECK(fgets(buf, sizeof(buf), tempf) == NULL);
+
+    log_set_file(stderr);
+    fclose(tempf);
+    unlink(temp_name);
+}
+
+// lines of path which contain func, reads the file on its own, the writer
+// thread may write to it meanwhile
+static size_t
+s_count_lines(const char *path, const char *func) {
+    size_t lines = 0;
+    char buf[2048];
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return 0;
+    while (fgets(buf, sizeof(buf), file)) {
+        if (strstr(buf, func))
+            lines++;
+    }
+    fclose(file);
+    return lines;
+}
+
+TEST_CASE("log-async-stop", "[log][async]") {
+    static const unsigned THREADS = 4;
+    static const unsigned MESSAGES = 20000;
+
+    char temp_name[128];
+    sprintf(temp_name, "test-log.XXXXXX");
+    FILE *tempf = mksftemp(temp_name);
+
+    log_set_level(LOG_DEBUG);
+    log_set_file(tempf);
+    REQUIRE(log_async_start() == 0);
+
+    // the idle writer sleeps, a new message wakes it up
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    do_log(LOG_ERR, "test-log", 1, "test_async_stop", "after idle");
+    for (int i = 0; i < 1000 && s_count_lines(temp_name, "(test_async_stop)") == 0; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    CHECK(s_count_lines(temp_name, "(test_async_stop)") == 1);
+
+    // messages logged while stopping are written either way
+    uint64_t dropped = log_get_dropped();
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < THREADS; t++) {
+        pool.emplace_back([t] {
+            for (unsigned i = 0; i < MESSAGES; i++)
+                do_log(LOG_ERR, "test-log", 2, "test_async_stop", "thread %u message %u", t, i);
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    log_async_stop();
+    for (auto &th : pool)
+        th.join();
+    dropped = log_get_dropped() - dropped;
+
+    fflush(tempf);
+    CHECK(s_count_lines(temp_name, "(test_async_stop)") == 1 + THREADS * MESSAGES - dropped);
+
+    log_set_file(stderr);
+    fclose(tempf);
+    unlink(temp_name);
+}
+
+static double
+s_log_threads(unsigned threads, unsigned messages) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; t++) {
+        pool.emplace_back([t, messages] {
+            for (unsigned i = 0; i < messages; i++)
+                log_debug("thread %u message %u: row id = %u, name = '%s'", t, i, i * 7, "some-asset-name");
+        });
+    }
+    for (auto &th : pool)
+        th.join();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+    return d.count();
+}
+
+TEST_CASE("log-throughput", "[log][.][benchmark]") {
+    static const unsigned THREADS = 4;
+    static const unsigned MESSAGES = 100000;
+
+    FILE *devnull = fopen("/dev/null", "w");
+    REQUIRE(devnull);
+    log_set_level(LOG_DEBUG);
+    log_set_file(devnull);
+    setvbuf(devnull, NULL, _IONBF, 0);  // behave like stderr
+
+    double sync = s_log_threads(THREADS, MESSAGES);
+
+    uint64_t dropped = log_get_dropped();
+    REQUIRE(log_async_start() == 0);
+    double async = s_log_threads(THREADS, MESSAGES);
+    log_async_stop();
+    dropped = log_get_dropped() - dropped;
+
+    log_set_file(stderr);
+    fclose(devnull);
+
+    printf("log throughput, %u threads x %u messages:\n", THREADS, MESSAGES);
+    printf("  synchronous:  %8.3f s, %10.0f msg/s\n", sync, THREADS * MESSAGES / sync);
+    printf("  asynchronous: %8.3f s, %10.0f msg/s, %" PRIu64 " dropped\n", async, THREADS * MESSAGES / async, dropped);
+}
+
+TEST_CASE("log-module-level", "[log][module]") {
+    log_set_level(LOG_ERR);
+    CHECK(log_get_module_level("importcsv") == LOG_ERR);
+    CHECK(!log_is_enabled(LOG_DEBUG, "src/db/inout/importcsv.cc"));
+
+    CHECK(log_set_module_level("importcsv", LOG_DEBUG) == 0);
+    CHECK(log_get_module_level("importcsv") == LOG_DEBUG);
+    CHECK(log_is_enabled(LOG_DEBUG, "src/db/inout/importcsv.cc"));
+    CHECK(log_is_enabled(LOG_DEBUG, "importcsv.cc"));
+    CHECK(!log_is_enabled(LOG_DEBUG, "src/db/inout/exportcsv.cc"));
+    CHECK(!log_is_enabled(LOG_DEBUG, "src/db/inout/importcsv2.cc"));
+
+    // module level overrides the global one in both directions
+    CHECK(log_set_module_level("importcsv", LOG_CRIT) == 0);
+    CHECK(!log_is_enabled(LOG_ERR, "src/db/inout/importcsv.cc"));
+    CHECK(log_is_enabled(LOG_ERR, "src/db/inout/exportcsv.cc"));
+
+    // arguments of disabled messages are not evaluated
+    int evaluated = 0;
+    log_debug("%d", ++evaluated);
+    CHECK(evaluated == 0);
+
+    log_set_module_level("importcsv", LOG_ERR);
+}
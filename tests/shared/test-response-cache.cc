@@ -0,0 +1,157 @@
+/*
+ *
+ * Copyright (C) 2015 Eaton
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+/*!
+ * \file test-response-cache.cc
+ * \brief Tests of the rendered response cache
+ */
+#include <catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "response_cache.h"
+
+TEST_CASE ("response cache key", "[response_cache]")
+{
+    CHECK (response_cache_key ("ep", {}) == "ep");
+    CHECK (response_cache_key ("ep", {{"b", "2"}, {"a", "1"}}) == "ep?a=1&b=2");
+    CHECK (response_cache_key ("ep", {{"a", "1&b=2"}}) == "ep?a=1%26b%3D2");
+    CHECK (response_cache_key ("ep", {{"a", "1&b=2"}}) != response_cache_key ("ep", {{"a", "1"}, {"b", "2"}}));
+}
+
+TEST_CASE ("response cache", "[response_cache]")
+{
+    ResponseCache cache {3, 1024};
+
+    SECTION ("miss, fill, hit") {
+        {
+            auto ticket = cache.acquire ("a", 1);
+            CHECK (!ticket.hit ());
+            CHECK (ticket.fill ("A") == "A");
+        }
+        auto ticket = cache.acquire ("a", 1);
+        REQUIRE (ticket.hit ());
+        CHECK (ticket.value () == "A");
+
+        auto stats = cache.stats ();
+        CHECK (stats.hits == 1);
+        CHECK (stats.misses == 1);
+        CHECK (stats.entries == 1);
+        CHECK (stats.bytes == 1);
+    }
+
+    SECTION ("new generation drops old entries") {
+        cache.acquire ("a", 1).fill ("A");
+        CHECK (!cache.acquire ("a", 2).hit ());
+        CHECK (cache.stats ().entries == 0);
+
+        // a render started before the change is neither served nor stored
+        auto ticket = cache.acquire ("a", 1);
+        CHECK (!ticket.hit ());
+        ticket.fill ("old");
+        CHECK (cache.stats ().entries == 0);
+    }
+
+    SECTION ("abandoned ticket") {
+        {
+            auto ticket = cache.acquire ("a", 1);
+            CHECK (!ticket.hit ());
+            // http_die, no fill
+        }
+        auto ticket = cache.acquire ("a", 1);
+        CHECK (!ticket.hit ());
+    }
+
+    SECTION ("LRU eviction by count and by size") {
+        cache.acquire ("a", 1).fill ("A");
+        cache.acquire ("b", 1).fill ("B");
+        cache.acquire ("c", 1).fill ("C");
+        CHECK (cache.acquire ("a", 1).hit ());
+        cache.acquire ("d", 1).fill ("D");
+        CHECK (cache.stats ().entries == 3);
+        CHECK (cache.stats ().evictions == 1);
+        CHECK (!cache.acquire ("b", 1).hit ());
+
+        cache.acquire ("big", 1).fill (std::string (1000, 'x'));
+        auto stats = cache.stats ();
+        CHECK (stats.bytes <= 1024);
+        CHECK (stats.entries <= 3);
+
+        cache.acquire ("huge", 1).fill (std::string (2000, 'x'));
+        CHECK (!cache.acquire ("huge", 1).hit ());
+    }
+}
+
+TEST_CASE ("response cache max age", "[response_cache]")
+{
+    // changes of other processes do not move the generation
+    ResponseCache cache {3, 1024, std::chrono::milliseconds (50)};
+
+    // entries live until the end of their period, start at its beginning
+    auto since = std::chrono::steady_clock::now ().time_since_epoch () % std::chrono::milliseconds (50);
+    std::this_thread::sleep_for (std::chrono::milliseconds (51) - since);
+    cache.acquire ("a", 1).fill ("A");
+    CHECK (cache.acquire ("a", 1).hit ());
+    std::this_thread::sleep_for (std::chrono::milliseconds (60));
+    {
+        auto ticket = cache.acquire ("a", 1);
+        CHECK (!ticket.hit ());
+        ticket.fill ("A2");
+    }
+    auto ticket = cache.acquire ("a", 1);
+    REQUIRE (ticket.hit ());
+    CHECK (ticket.value () == "A2");
+
+    auto stats = cache.stats ();
+    CHECK (stats.expirations == 1);
+    CHECK (stats.entries == 1);
+    CHECK (stats.bytes == 2);
+}
+
+TEST_CASE ("response cache single flight", "[response_cache]")
+{
+    ResponseCache cache;
+    std::atomic<int> renders {0};
+    std::vector<std::thread> threads;
+    std::vector<std::string> results (8);
+
+    for (size_t i = 0; i != results.size (); ++i) {
+        threads.emplace_back ([&cache, &renders, &results, i]() {
+            auto ticket = cache.acquire ("topology", 1);
+            if (ticket.hit ()) {
+                results [i] = ticket.value ();
+                return;
+            }
+            ++renders;
+            std::this_thread::sleep_for (std::chrono::milliseconds (50));
+            results [i] = ticket.fill ("tree");
+        });
+    }
+    for (auto &thread : threads)
+        thread.join ();
+
+    CHECK (renders == 1);
+    for (const auto &result : results)
+        CHECK (result == "tree");
+    CHECK (cache.stats ().hits == results.size () - 1);
+}
@@ -414,3 +414,34 @@ TEST_CASE ("subprocess-test-timeout3", "[subprocess][output]")
     auto delta = stop - start;
     CHECK ((delta >= 2000 && delta < 5000)); // it's hard to tell how long the delay was, but it must be between 2 and 5 secs
 }
+
+TEST_CASE ("subprocess-output-stream", "[subprocess][output]")
+{
+    Argv args {"/bin/sh", "-c", "printf 'first\\n'; sleep 1; printf 'second\\n'"};
+    std::vector <std::string> chunks;
+    std::string e;
+    int r = output_stream (args,
+            [&chunks](const char* data, size_t size) { chunks.push_back (std::string (data, size)); },
+            e);
+
+    CHECK (r == 0);
+    CHECK (e.empty ());
+    // output is delivered as it comes, not at the process exit
+    REQUIRE (chunks.size () == 2);
+    CHECK (chunks[0] == "first\n");
+    CHECK (chunks[1] == "second\n");
+}
+
+TEST_CASE ("subprocess-test-kill-escalation", "[subprocess][output]")
+{
+    // process ignoring SIGTERM must be killed after a grace period
+    Argv args {"/bin/sh", "-c", "trap '' TERM; sleep 10"};
+    auto start = zclock_mono ();
+    std::string o;
+    std::string e;
+    int r = output (args, o, e, 1);
+    auto stop = zclock_mono ();
+
+    CHECK (r == -9);    //killed by SIGKILL
+    CHECK ((stop - start) < 5000);
+}
@@ -27,6 +27,10 @@
 #include <czmq.h>
 #include <string>
 #include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
 #include <cxxtools/serializationinfo.h>
 #include <cxxtools/jsondeserializer.h>
 #include <limits.h>
@@ -82,7 +86,6 @@ TEST_CASE ("utils::json::escape","[utils::math::dtos][json][escape]")
         {"\\uA66A",                                                     R"(\\uA66A)"},
         {"\\Ꙫ",                                                         R"(\\\u00ea\u0099\u00aa)"},
         {"\u040A Њ",                                                    R"(\u00d0\u008a \u00d0\u008a)"},
-        {"\u0002\u0005\u0018\u001B",                                    R"(\u0002\u0005\u0018\u001b)"},
 
         {"\\\uA66A",                                                    R"(\\\u00ea\u0099\u00aa)"},
         {"\\\\uA66A",                                                   R"(\\\\uA66A)"},
@@ -93,9 +96,12 @@ TEST_CASE ("utils::json::escape","[utils::math::dtos][json][escape]")
         */
 
         {"first second \n third\n\n \\n \\\\\n fourth",                 R"(first second \\n third\\n\\n \\n \\\\\\n fourth)"},
-        /*
-        {"first second \n third\n\"\n \\n \\\\\"\f\\\t\\u\u0007\\\n fourth", R"(first second \\n third\\n\"\\n \\n \\\\\"\\f\\\\t\\u\u0007\\\\n fourth)"}
-        */
+        {"first second \n third\n\"\n \\n \\\\\"\f\\\t\\u\u0007\\\n fourth", R"(first second \\n third\\n\"\\n \\n \\\\\"\\f\\\\t\\u\u0007\\\\n fourth)"},
+
+        // other control characters as \u00XX
+        {"\u0002\u0005\u0018\u001B",                                    R"(\u0002\u0005\u0018\u001b)"},
+        {"bell\a",                                                      R"(bell\u0007)"},
+        {"\x7f",                                                        "\x7f"},
     };
 
     // a valid json { key : utils::json::escape (<string> } is constructed,
@@ -158,6 +164,92 @@ TEST_CASE ("utils::json::escape","[utils::math::dtos][json][escape]")
     }
 }
 
+// byte by byte, what escape () did before the vector scan
+static std::string
+s_escape_reference (const std::string& string)
+{
+    std::string after;
+    for (char c : string) {
+        if (c == '"')
+            after.append ("\\\"");
+        else if (c == '\b')
+            after.append ("\\\\b");
+        else if (c == '\f')
+            after.append ("\\\\f");
+        else if (c == '\n')
+            after.append ("\\\\n");
+        else if (c == '\r')
+            after.append ("\\\\r");
+        else if (c == '\t')
+            after.append ("\\\\t");
+        else if (c == '\\')
+            after.append ("\\\\");
+        else if ((unsigned char) c < 0x20) {
+            char buffer [7];
+            snprintf (buffer, sizeof (buffer), "\\u%04x", (unsigned char) c);
+            after.append (buffer);
+        }
+        else
+            after += c;
+    }
+    return after;
+}
+
+TEST_CASE ("utils::json::escape random strings","[json][escape]")
+{
+    // special bytes at all positions around the 16 byte blocks
+    std::srand (42);
+    for (size_t length = 0; length != 70; ++length) {
+        for (int round = 0; round != 50; ++round) {
+            std::string string;
+            for (size_t i = 0; i != length; ++i) {
+                unsigned char c;
+                switch (std::rand () % 4) {
+                    case 0:  c = 1 + std::rand () % 255; break;
+                    case 1:  c = "\"\\\n\x1f\x20\x80\xff"[std::rand () % 7]; break;
+                    default: c = 'a' + std::rand () % 26; break;
+                }
+                string += (char) c;
+            }
+            CAPTURE (string);
+            CHECK (utils::json::escape (string) == s_escape_reference (string));
+            CHECK (utils::json::escape_span (string.c_str (), string.size ()) ==
+                   std::min (string.size (), string.find_first_of (std::string ("\"\\") +
+                        "\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f"
+                        "\x10\x11\x12\x13\x14\x15\x16\x17\x18\x19\x1a\x1b\x1c\x1d\x1e\x1f")));
+        }
+    }
+}
+
+TEST_CASE ("utils::json::escape benchmark","[.][benchmark][json][escape]")
+{
+    std::vector <std::pair <std::string, std::string>> inputs {
+        {"asset names", "datacenter-3"},
+        {"descriptions", "Average humidity in the room exceeded the configured threshold of 80 percent."},
+        {"long text", std::string (4096, 'x')},
+        {"many escapes", "\"quoted\"\tand\\back\\slashes\n"}
+    };
+    const size_t BYTES = 64 * 1024 * 1024;
+    for (const auto &input : inputs) {
+        size_t rounds = BYTES / input.second.size ();
+        size_t total = 0;
+        auto start = std::chrono::steady_clock::now ();
+        for (size_t i = 0; i != rounds; ++i)
+            total += s_escape_reference (input.second).size ();
+        auto middle = std::chrono::steady_clock::now ();
+        for (size_t i = 0; i != rounds; ++i)
+            total -= utils::json::escape (input.second).size ();
+        auto end = std::chrono::steady_clock::now ();
+
+        CHECK (total == 0);
+        std::cout << input.first << " (" << input.second.size () << " bytes) x " << rounds << ": "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(middle - start).count()
+                  << " ms byte by byte, "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end - middle).count()
+                  << " ms escape ()" << std::endl;
+    }
+}
+
 TEST_CASE ("utils::json::jsonify","[utils::json::jsonify][json][escape]")
 {
     // 
@@ -319,6 +411,98 @@ TEST_CASE ("utils::json::create_error_json","[utils::json::create_error_json][js
 
 }
 
+// check_* helpers add errors to a reference
+static void
+s_add_errors (http_errors_t& errors)
+{
+    http_add_error ("", errors, "request-param-required", "in");
+    http_add_error ("test.ecpp: 42", errors, "element-not-found", std::string ("a\"b"));
+}
+
+TEST_CASE ("http_die error messages","[http_die][json]")
+{
+    int idx = 0;
+    std::string message;
+
+    // missing arguments are empty
+    bios_error_idx (idx, message, "request-param-bad", "x");
+    CHECK (idx == 6);
+    CHECK (message == "Parameter 'x' has bad value. Received . Expected ");
+
+    std::string received = "'abc'";
+    const char *expected = nullptr;
+    bios_error_idx (idx, message, "request-param-bad", "x", received, expected);
+    CHECK (message == "Parameter 'x' has bad value. Received 'abc'. Expected (null)");
+
+    // integers are written in decimal, like ids in asset_GET or assetcr
+    uint32_t id = 4000000000u;
+    int64_t parent_id = -1;
+    bios_error_idx (idx, message, "request-param-bad", "location", parent_id, id);
+    CHECK (message == "Parameter 'location' has bad value. Received -1. Expected 4000000000");
+
+    // extra arguments are ignored, the message can be the key
+    bios_error_idx (idx, message, "You are not authenticated or your rights are insufficient.", "x");
+    CHECK (idx == 2);
+    CHECK (message == "You are not authenticated or your rights are insufficient.");
+
+    try {
+        bios_throw ("internal-error", "Boom.");
+        FAIL ("bios_throw did not throw");
+    }
+    catch (const BiosError& e) {
+        CHECK (e.idx == 1);
+        CHECK (std::string (e.what ()) == "Internal Server Error. Boom.");
+    }
+
+    http_errors_t errors;
+    s_add_errors (errors);
+    CHECK (errors.http_code == HTTP_NOT_FOUND);
+    CHECK (utils::json::create_error_json (errors.errors) ==
+"{\n\t\"errors\": [\n"
+"\t\t{\n\t\t\t\"message\": \"Parameter 'in' is required.\",\n\t\t\t\"code\": 46\n\t\t},\n"
+"\t\t{\n\t\t\t\"message\": \"Element 'a\\\"b' not found.\",\n\t\t\t\"debug\": \"test.ecpp: 42\",\n\t\t\t\"code\": 44\n\t\t}\n"
+"\t]\n}\n");
+
+    CHECK (utils::json::create_error_json ("", 42, "") ==
+"{\n\t\"errors\": [\n\t\t{\n\t\t\t\"message\": \"\",\n\t\t\t\"debug\": \"\",\n\t\t\t\"code\": 42\n\t\t}\n\t]\n}\n");
+    CHECK (utils::json::create_error_json (std::vector <std::tuple<uint32_t, std::string, std::string>> ()) ==
+"{\n\t\"errors\": [\n\t]\n}\n");
+}
+
+TEST_CASE ("http_die error messages benchmark","[.][benchmark][http_die][json]")
+{
+    const size_t ROUNDS = 1000000;
+    std::string value = "some-bad-value-from-a-client";
+    size_t total = 0;
+
+    // what http_die did: asprintf with padding, then concatenation
+    auto start = std::chrono::steady_clock::now ();
+    for (size_t i = 0; i != ROUNDS; ++i) {
+        char *buffer = NULL;
+        if (asprintf (&buffer, _errors.at (6).message, "type", value.c_str (), "datacenter/room/row/rack/device") < 0)
+            FAIL ("asprintf failed");
+        std::string json = std::string ("{\n\t\"errors\": [\n\t\t{\n\t\t\t\"message\": ")
+            .append (utils::json::jsonify (std::string (buffer))).append (",\n\t\t\t\"code\": ")
+            .append (utils::json::jsonify (_errors.at (6).err_code)).append ("\n\t\t}\n\t]\n}\n");
+        free (buffer);
+        total += json.size ();
+    }
+    auto middle = std::chrono::steady_clock::now ();
+    for (size_t i = 0; i != ROUNDS; ++i) {
+        std::string json = utils::json::create_error_json (
+            _die_format (6, "type", value, "datacenter/room/row/rack/device"), _errors.at (6).err_code);
+        total -= json.size ();
+    }
+    auto end = std::chrono::steady_clock::now ();
+
+    CHECK (total == 0);
+    std::cout << ROUNDS << " request-param-bad errors: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(middle - start).count()
+              << " ms asprintf and concatenation, "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - middle).count()
+              << " ms _die_format and create_error_json" << std::endl;
+}
+
 TEST_CASE ("utils::string_to_element_id", "[utils]") {
     uint32_t r = 0;
 